@@ -0,0 +1,145 @@
+/**
+ * @file callbacks.c
+ * @brief Kernel notification callback enumeration
+ */
+
+#include <string.h>
+
+#include "callbacks.h"
+#include "symbols.h"
+
+// EX_FAST_REF keeps a reference count in the low 4 bits on x64
+#define EX_FAST_REF_MASK (~(addr_t)0xf)
+
+// EX_CALLBACK_ROUTINE_BLOCK.Function
+#define CALLBACK_BLOCK_FUNCTION 0x08
+
+// CM_CALLBACK_CONTEXT_BLOCK.Function (Vista+ x64)
+#define REGISTRY_CALLBACK_FUNCTION 0x28
+
+// Image-load notify array grew from 8 to 64 slots in Windows 8
+#define IMAGE_SLOTS_LEGACY 8
+
+typedef struct CallbackArray_t
+{
+  callback_type_t type;
+  const char *symbol;
+} CallbackArray_t;
+
+static const CallbackArray_t g_arrays[] = {
+    {CALLBACK_PROCESS, "PspCreateProcessNotifyRoutine"},
+    {CALLBACK_THREAD, "PspCreateThreadNotifyRoutine"},
+    {CALLBACK_IMAGE, "PspLoadImageNotifyRoutine"},
+};
+
+static void add_callback(KernelCallbackSet_t *set, const KernelModuleList_t *modules,
+                         callback_type_t type, unsigned slot, addr_t function)
+{
+  if (set->count == CALLBACK_MAX)
+  {
+    return;
+  }
+
+  KernelCallback_t *callback = &set->callbacks[set->count++];
+  callback->type = type;
+  callback->slot = slot;
+  callback->function = function;
+  callback->owner = kmodules_find(modules, function);
+}
+
+static void read_notify_array(vmi_instance_t vmi, const KernelModuleList_t *modules,
+                              const CallbackArray_t *array, unsigned slots,
+                              KernelCallbackSet_t *set)
+{
+  addr_t base = 0;
+  addr_t refs[CALLBACK_ARRAY_SLOTS];
+
+  if (VMI_FAILURE == symbols_ksym2v(vmi, array->symbol, &base) ||
+      VMI_FAILURE == vmi_read_va(vmi, base, 0, slots * sizeof(refs[0]), refs, NULL))
+  {
+    return;
+  }
+  set->resolved[array->type] = 1;
+
+  for (unsigned slot = 0; slot < slots; slot++)
+  {
+    addr_t block = refs[slot] & EX_FAST_REF_MASK;
+    addr_t function = 0;
+
+    if (!block || VMI_FAILURE == vmi_read_addr_va(vmi, block + CALLBACK_BLOCK_FUNCTION, 0, &function))
+    {
+      continue;
+    }
+    add_callback(set, modules, array->type, slot, function);
+  }
+}
+
+/**
+ * @brief Walk CallbackListHead (CmRegisterCallback / CmRegisterCallbackEx)
+ */
+static void read_registry_callbacks(vmi_instance_t vmi, const KernelModuleList_t *modules,
+                                    KernelCallbackSet_t *set)
+{
+  addr_t head = 0, entry = 0;
+  unsigned slot = 0;
+
+  if (VMI_FAILURE == symbols_ksym2v(vmi, "CallbackListHead", &head) ||
+      VMI_FAILURE == vmi_read_addr_va(vmi, head, 0, &entry))
+  {
+    return;
+  }
+  set->resolved[CALLBACK_REGISTRY] = 1;
+
+  while (entry && entry != head && slot < CALLBACK_MAX_REGISTRY)
+  {
+    addr_t function = 0;
+    if (VMI_SUCCESS == vmi_read_addr_va(vmi, entry + REGISTRY_CALLBACK_FUNCTION, 0, &function))
+    {
+      add_callback(set, modules, CALLBACK_REGISTRY, slot, function);
+    }
+    slot++;
+
+    if (VMI_FAILURE == vmi_read_addr_va(vmi, entry, 0, &entry))
+    {
+      break;
+    }
+  }
+}
+
+demo_error_t callbacks_enumerate(vmi_instance_t vmi, const KernelModuleList_t *modules,
+                                 KernelCallbackSet_t *set)
+{
+  memset(set->resolved, 0, sizeof(set->resolved));
+  set->count = 0;
+
+  // Reading past the 8-slot legacy array would decode unrelated data
+  unsigned image_slots = (vmi_get_winver(vmi) >= VMI_OS_WINDOWS_8) ? CALLBACK_ARRAY_SLOTS
+                                                                   : IMAGE_SLOTS_LEGACY;
+
+  for (size_t i = 0; i < sizeof(g_arrays) / sizeof(g_arrays[0]); i++)
+  {
+    unsigned slots = (g_arrays[i].type == CALLBACK_IMAGE) ? image_slots : CALLBACK_ARRAY_SLOTS;
+    read_notify_array(vmi, modules, &g_arrays[i], slots, set);
+  }
+  read_registry_callbacks(vmi, modules, set);
+
+  for (int type = 0; type < CALLBACK_TYPES; type++)
+  {
+    if (set->resolved[type])
+    {
+      return DEMO_SUCCESS;
+    }
+  }
+  return DEMO_ERROR_MODULE;
+}
+
+const char *callbacks_type_name(callback_type_t type)
+{
+  static const char *const names[] = {
+      [CALLBACK_PROCESS] = "Process creation",
+      [CALLBACK_THREAD] = "Thread creation",
+      [CALLBACK_IMAGE] = "Image load",
+      [CALLBACK_REGISTRY] = "Registry",
+  };
+  return (type < CALLBACK_TYPES) ? names[type] : "Unknown";
+}
@@ -0,0 +1,56 @@
+/**
+ * @file callbacks.h
+ * @brief Kernel notification callback enumeration
+ *
+ * Process, thread and image-load notify routines are kept in fixed-size
+ * arrays of EX_FAST_REF pointers; each array is fetched with one block
+ * read. Registry callbacks live in the CallbackListHead list on Vista+.
+ */
+
+#ifndef CALLBACKS_H
+#define CALLBACKS_H
+
+#include <stddef.h>
+#include "kmodules.h"
+
+#define CALLBACK_ARRAY_SLOTS 64
+#define CALLBACK_MAX_REGISTRY 256
+#define CALLBACK_MAX (3 * CALLBACK_ARRAY_SLOTS + CALLBACK_MAX_REGISTRY)
+
+typedef enum
+{
+  CALLBACK_PROCESS,
+  CALLBACK_THREAD,
+  CALLBACK_IMAGE,
+  CALLBACK_REGISTRY,
+  CALLBACK_TYPES
+} callback_type_t;
+
+// One registered callback routine
+typedef struct KernelCallback_t
+{
+  callback_type_t type;
+  unsigned slot;
+  addr_t function;
+  const KernelModule_t *owner; // NULL when outside every loaded driver
+} KernelCallback_t;
+
+typedef struct KernelCallbackSet_t
+{
+  KernelCallback_t callbacks[CALLBACK_MAX];
+  size_t count;
+  uint8_t resolved[CALLBACK_TYPES]; // symbol for the type was found and read
+} KernelCallbackSet_t;
+
+/**
+ * @brief Collect all registered callbacks and attribute them to drivers
+ */
+demo_error_t callbacks_enumerate(vmi_instance_t vmi, const KernelModuleList_t *modules,
+                                 KernelCallbackSet_t *set);
+
+/**
+ * @brief Human-readable name of a callback type
+ */
+const char *callbacks_type_name(callback_type_t type);
+
+#endif // CALLBACKS_H
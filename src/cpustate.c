@@ -0,0 +1,217 @@
+/**
+ * @file cpustate.c
+ * @brief Per-vCPU IDT, GDT and LSTAR integrity checks
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "cpustate.h"
+#include "metrics.h"
+
+#define GDT_TSS_SELECTOR 0x40
+#define IDT_GATE_PRESENT 0x80
+
+typedef struct ValidateJob_t
+{
+  VcpuState_t *states;
+  unsigned count;
+  unsigned first;
+  unsigned stride;
+  const KernelModuleList_t *modules;
+} ValidateJob_t;
+
+demo_error_t cpustate_capture(vmi_instance_t vmi, VcpuState_t **states, unsigned *count)
+{
+  unsigned vcpus = vmi_get_num_vcpus(vmi);
+  if (!vcpus)
+  {
+    return DEMO_ERROR_INIT;
+  }
+
+  VcpuState_t *captured = calloc(vcpus, sizeof(*captured));
+  if (!captured)
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+
+  // Keep the window short: only register fetches and raw table copies
+  struct timespec pause_start, pause_end;
+  clock_gettime(CLOCK_MONOTONIC, &pause_start);
+  status_t paused = vmi_pause_vm(vmi);
+
+  for (unsigned i = 0; i < vcpus; i++)
+  {
+    VcpuState_t *state = &captured[i];
+    state->vcpu = i;
+
+    state->regs_valid =
+        VMI_SUCCESS == vmi_get_vcpureg(vmi, &state->idtr_base, IDTR_BASE, i) &&
+        VMI_SUCCESS == vmi_get_vcpureg(vmi, &state->gdtr_base, GDTR_BASE, i) &&
+        VMI_SUCCESS == vmi_get_vcpureg(vmi, &state->lstar, MSR_LSTAR, i);
+    if (!state->regs_valid)
+    {
+      continue;
+    }
+
+    state->idt_valid = VMI_SUCCESS == vmi_read_va(vmi, state->idtr_base, 0,
+                                                  sizeof(state->idt), state->idt, NULL);
+    state->gdt_valid = VMI_SUCCESS == vmi_read_va(vmi, state->gdtr_base, 0,
+                                                  sizeof(state->gdt), state->gdt, NULL);
+  }
+
+  if (VMI_SUCCESS == paused)
+  {
+    vmi_resume_vm(vmi);
+    clock_gettime(CLOCK_MONOTONIC, &pause_end);
+
+    uint64_t ns = (uint64_t)(pause_end.tv_sec - pause_start.tv_sec) * 1000000000ull +
+                  (uint64_t)pause_end.tv_nsec - (uint64_t)pause_start.tv_nsec;
+    metrics_add(METRIC_PAUSES, 1);
+    metrics_add(METRIC_PAUSE_NS_TOTAL, ns);
+    metrics_set(METRIC_PAUSE_NS_LAST, ns);
+    metrics_max(METRIC_PAUSE_NS_MAX, ns);
+  }
+
+  *states = captured;
+  *count = vcpus;
+  return DEMO_SUCCESS;
+}
+
+static void add_finding(VcpuState_t *state, cpu_finding_t kind, unsigned index,
+                        addr_t value, const KernelModule_t *owner)
+{
+  if (state->findings_count == CPU_MAX_FINDINGS)
+  {
+    state->findings_dropped++;
+    return;
+  }
+
+  CpuFinding_t *finding = &state->findings[state->findings_count++];
+  finding->kind = kind;
+  finding->index = index;
+  finding->value = value;
+  finding->owner = owner;
+}
+
+/**
+ * @brief Interrupt handlers live in ntoskrnl, except the clock/IPI vectors HAL owns
+ */
+static int is_interrupt_owner(const KernelModuleList_t *modules, const KernelModule_t *owner)
+{
+  return owner && (owner == &modules->modules[0] || 0 == strcasecmp(owner->name, "hal.dll"));
+}
+
+static void validate_vcpu(VcpuState_t *state, const KernelModuleList_t *modules)
+{
+  const KernelModule_t *kernel = &modules->modules[0];
+
+  if (!state->regs_valid)
+  {
+    return;
+  }
+
+  if (kmodules_find(modules, state->lstar) != kernel)
+  {
+    add_finding(state, CPU_FINDING_LSTAR, 0, state->lstar, kmodules_find(modules, state->lstar));
+  }
+
+  if (state->idt_valid)
+  {
+    for (unsigned vector = 0; vector < IDT_ENTRIES; vector++)
+    {
+      const uint8_t *gate = state->idt + vector * IDT_ENTRY_SIZE;
+      uint16_t low, mid;
+      uint32_t high;
+
+      if (!(gate[5] & IDT_GATE_PRESENT))
+      {
+        continue;
+      }
+      state->idt_present++;
+
+      memcpy(&low, gate, sizeof(low));
+      memcpy(&mid, gate + 6, sizeof(mid));
+      memcpy(&high, gate + 8, sizeof(high));
+      addr_t handler = (addr_t)low | ((addr_t)mid << 16) | ((addr_t)high << 32);
+
+      const KernelModule_t *owner = kmodules_find(modules, handler);
+      if (!is_interrupt_owner(modules, owner))
+      {
+        add_finding(state, CPU_FINDING_IDT_HANDLER, vector, handler, owner);
+      }
+    }
+  }
+
+  if (state->gdtr_base < KERNEL_SPACE_START)
+  {
+    add_finding(state, CPU_FINDING_GDT_BASE, 0, state->gdtr_base, NULL);
+  }
+  else if (state->gdt_valid)
+  {
+    const uint8_t *tss = state->gdt + GDT_TSS_SELECTOR;
+    uint32_t upper;
+    memcpy(&upper, tss + 8, sizeof(upper));
+    addr_t base = (addr_t)tss[2] | ((addr_t)tss[3] << 8) | ((addr_t)tss[4] << 16) |
+                  ((addr_t)tss[7] << 24) | ((addr_t)upper << 32);
+
+    if (base < KERNEL_SPACE_START)
+    {
+      add_finding(state, CPU_FINDING_TSS_BASE, 0, base, NULL);
+    }
+  }
+}
+
+static void *validate_worker(void *arg)
+{
+  ValidateJob_t *job = arg;
+  for (unsigned i = job->first; i < job->count; i += job->stride)
+  {
+    validate_vcpu(&job->states[i], job->modules);
+  }
+  return NULL;
+}
+
+void cpustate_validate(VcpuState_t *states, unsigned count, const KernelModuleList_t *modules)
+{
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned workers = (online > 0 && (unsigned)online < count) ? (unsigned)online : count;
+  pthread_t threads[workers];
+  ValidateJob_t jobs[workers];
+  uint8_t joinable[workers];
+
+  // Workers 1..n-1 run on their own threads; a failed create runs inline
+  for (unsigned w = 0; w < workers; w++)
+  {
+    jobs[w] = (ValidateJob_t){states, count, w, workers, modules};
+    joinable[w] = w > 0 && 0 == pthread_create(&threads[w], NULL, validate_worker, &jobs[w]);
+    if (w > 0 && !joinable[w])
+    {
+      validate_worker(&jobs[w]);
+    }
+  }
+
+  validate_worker(&jobs[0]);
+
+  for (unsigned w = 1; w < workers; w++)
+  {
+    if (joinable[w])
+    {
+      pthread_join(threads[w], NULL);
+    }
+  }
+
+  // Every vCPU must enter the same system call handler
+  for (unsigned i = 1; i < count; i++)
+  {
+    if (states[i].regs_valid && states[0].regs_valid && states[i].lstar != states[0].lstar)
+    {
+      add_finding(&states[i], CPU_FINDING_LSTAR_MISMATCH, 0, states[i].lstar,
+                  kmodules_find(modules, states[i].lstar));
+    }
+  }
+}
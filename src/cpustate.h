@@ -0,0 +1,68 @@
+/**
+ * @file cpustate.h
+ * @brief Per-vCPU IDT, GDT and LSTAR integrity checks
+ *
+ * Registers and descriptor tables for every vCPU are captured inside one
+ * pause window; decoding and validation then run in parallel on the copies
+ * after the guest has been resumed.
+ */
+
+#ifndef CPUSTATE_H
+#define CPUSTATE_H
+
+#include "kmodules.h"
+
+#define IDT_ENTRIES 256
+#define IDT_ENTRY_SIZE 16
+#define GDT_READ_SIZE 0x50 // through the 16-byte TSS descriptor at selector 0x40
+#define CPU_MAX_FINDINGS 32
+
+typedef enum
+{
+  CPU_FINDING_IDT_HANDLER,
+  CPU_FINDING_LSTAR,
+  CPU_FINDING_LSTAR_MISMATCH,
+  CPU_FINDING_GDT_BASE,
+  CPU_FINDING_TSS_BASE
+} cpu_finding_t;
+
+// One suspicious value found during validation
+typedef struct CpuFinding_t
+{
+  cpu_finding_t kind;
+  unsigned index; // IDT vector for handler findings
+  addr_t value;
+  const KernelModule_t *owner;
+} CpuFinding_t;
+
+// Captured and validated state of one vCPU
+typedef struct VcpuState_t
+{
+  unsigned vcpu;
+  addr_t idtr_base;
+  addr_t gdtr_base;
+  uint64_t lstar;
+  uint8_t regs_valid;
+  uint8_t idt_valid;
+  uint8_t gdt_valid;
+  uint8_t idt[IDT_ENTRIES * IDT_ENTRY_SIZE];
+  uint8_t gdt[GDT_READ_SIZE];
+
+  unsigned idt_present;
+  unsigned findings_count;
+  unsigned findings_dropped;
+  CpuFinding_t findings[CPU_MAX_FINDINGS];
+} VcpuState_t;
+
+/**
+ * @brief Pause the guest once and capture registers and tables of all vCPUs
+ * @param states Receives a calloc'd array of @p count entries
+ */
+demo_error_t cpustate_capture(vmi_instance_t vmi, VcpuState_t **states, unsigned *count);
+
+/**
+ * @brief Decode and validate captured state, one worker thread per vCPU
+ */
+void cpustate_validate(VcpuState_t *states, unsigned count, const KernelModuleList_t *modules);
+
+#endif // CPUSTATE_H
@@ -0,0 +1,795 @@
+/**
+ * @file dump.c
+ * @brief Full guest physical memory acquisition (raw, LiME, sparse or zstd)
+ */
+
+#define _GNU_SOURCE // O_DIRECT
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "dump.h"
+#include "dumpfile.h"
+#include "uring.h"
+#include "zdump.h"
+
+#define LIME_MAGIC 0x4C694D45 // "EMiL"
+#define LIME_VERSION 1
+
+// LiME range header, written immediately before the range's bytes
+typedef struct __attribute__((packed)) LimeHeader_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t start; // first physical address
+  uint64_t end;   // last physical address (inclusive)
+  uint8_t reserved[8];
+} LimeHeader_t;
+
+#define SPARSE_TABLE_INITIAL (1u << 16)
+#define HOLE_STEP_MAX (2 * 1024 * 1024) // largest stride when skipping unreadable memory
+
+// Open-addressed set of stored pages keyed by their 128-bit XXH3 hash
+typedef struct PageSlot_t
+{
+  XXH128_hash_t hash;
+  uint32_t slot;
+  uint32_t used;
+} PageSlot_t;
+
+typedef struct SparseState_t
+{
+  uint32_t *index; // one entry per guest page, padded to a page for O_DIRECT
+  DumpFilePageHash_t *hashes;
+  uint64_t page_count;
+  PageSlot_t *table;
+  size_t table_capacity; // power of two
+  size_t table_count;
+  uint32_t next_slot;
+  XXH128_hash_t zero_hash;
+  DumpFile_t base; // incremental dumps only
+  int has_base;
+  uint64_t base_pages;
+  char base_path[DUMPFILE_BASE_PATH_MAX];
+} SparseState_t;
+
+typedef struct DumpBuffer_t
+{
+  uint8_t *mem; // one page of header room, then DUMP_CHUNK_SIZE of data
+  size_t expected;
+  int busy;
+} DumpBuffer_t;
+
+typedef struct DumpWriter_t
+{
+  int fd;
+  dump_format_t format;
+  Uring_t ring;
+  int use_uring;
+  DumpBuffer_t buffers[DUMP_QUEUE_DEPTH];
+  uint8_t *probe; // one page for probing holes; buffers may be in flight
+  unsigned in_flight;
+  off_t append_offset; // LiME and sparse page data are sequential
+  SparseState_t sparse;
+  int failed;
+  DumpStats_t *stats;
+} DumpWriter_t;
+
+int dump_parse_format(const char *name, dump_format_t *format)
+{
+  if (0 == strcmp(name, "raw"))
+  {
+    *format = DUMP_FORMAT_RAW;
+    return 0;
+  }
+  if (0 == strcmp(name, "lime"))
+  {
+    *format = DUMP_FORMAT_LIME;
+    return 0;
+  }
+  if (0 == strcmp(name, "sparse"))
+  {
+    *format = DUMP_FORMAT_SPARSE;
+    return 0;
+  }
+  if (0 == strcmp(name, "zstd"))
+  {
+    *format = DUMP_FORMAT_ZSTD;
+    return 0;
+  }
+  return -1;
+}
+
+static uint8_t *buffer_data(DumpBuffer_t *buffer)
+{
+  return buffer->mem + GUEST_PAGE_SIZE;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief AVX2 variant of page_is_zero, compiled for AVX2 regardless of -march
+ */
+__attribute__((target("avx2"))) static int page_is_zero_avx2(const uint8_t *page)
+{
+  for (size_t off = 0; off < GUEST_PAGE_SIZE; off += 256)
+  {
+    const __m256i *p = (const __m256i *)(page + off);
+    __m256i acc = _mm256_or_si256(
+        _mm256_or_si256(_mm256_or_si256(_mm256_load_si256(p + 0), _mm256_load_si256(p + 1)),
+                        _mm256_or_si256(_mm256_load_si256(p + 2), _mm256_load_si256(p + 3))),
+        _mm256_or_si256(_mm256_or_si256(_mm256_load_si256(p + 4), _mm256_load_si256(p + 5)),
+                        _mm256_or_si256(_mm256_load_si256(p + 6), _mm256_load_si256(p + 7))));
+    if (!_mm256_testz_si256(acc, acc))
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+#endif
+
+/**
+ * @brief Test a 4 KiB page for all-zero bytes
+ *
+ * ORs 256-byte blocks together and stops at the first non-zero block, so
+ * ordinary data pages are rejected after a few loads. AVX2 is picked at
+ * run time; SSE2 is the x86-64 baseline.
+ */
+static int page_is_zero(const uint8_t *page)
+{
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return page_is_zero_avx2(page);
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (size_t off = 0; off < GUEST_PAGE_SIZE; off += 256)
+  {
+    const __m128i *p = (const __m128i *)(page + off);
+    __m128i acc = zero;
+    for (unsigned i = 0; i < 16; i++)
+    {
+      acc = _mm_or_si128(acc, _mm_load_si128(p + i));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xffff)
+    {
+      return 0;
+    }
+  }
+  return 1;
+#else
+  const uint64_t *words = (const uint64_t *)page;
+  for (size_t i = 0; i < GUEST_PAGE_SIZE / sizeof(uint64_t); i += 32)
+  {
+    uint64_t acc = 0;
+    for (unsigned j = 0; j < 32; j++)
+    {
+      acc |= words[i + j];
+    }
+    if (acc)
+    {
+      return 0;
+    }
+  }
+  return 1;
+#endif
+}
+
+static int sparse_grow(SparseState_t *sparse)
+{
+  size_t capacity = sparse->table_capacity ? sparse->table_capacity * 2 : SPARSE_TABLE_INITIAL;
+  PageSlot_t *table = calloc(capacity, sizeof(*table));
+  if (!table)
+  {
+    return -1;
+  }
+
+  for (size_t i = 0; i < sparse->table_capacity; i++)
+  {
+    const PageSlot_t *entry = &sparse->table[i];
+    if (!entry->used)
+    {
+      continue;
+    }
+    size_t pos = (size_t)entry->hash.low64 & (capacity - 1);
+    while (table[pos].used)
+    {
+      pos = (pos + 1) & (capacity - 1);
+    }
+    table[pos] = *entry;
+  }
+
+  free(sparse->table);
+  sparse->table = table;
+  sparse->table_capacity = capacity;
+  return 0;
+}
+
+/**
+ * @brief Find the stored copy of a page, or claim the next data slot for it
+ * @return 1 if @p slot refers to an existing copy, 0 if it is new, -1 on allocation failure
+ */
+static int sparse_lookup(SparseState_t *sparse, XXH128_hash_t hash, uint32_t *slot)
+{
+  if (sparse->table_count * 2 >= sparse->table_capacity && sparse_grow(sparse) != 0)
+  {
+    return -1;
+  }
+
+  size_t mask = sparse->table_capacity - 1;
+  size_t pos = (size_t)hash.low64 & mask;
+  while (sparse->table[pos].used)
+  {
+    if (XXH128_isEqual(sparse->table[pos].hash, hash))
+    {
+      *slot = sparse->table[pos].slot;
+      return 1;
+    }
+    pos = (pos + 1) & mask;
+  }
+
+  PageSlot_t *entry = &sparse->table[pos];
+  entry->hash = hash;
+  entry->slot = sparse->next_slot++;
+  entry->used = 1;
+  sparse->table_count++;
+  *slot = entry->slot;
+  return 0;
+}
+
+/**
+ * @brief Whether the base dump holds exactly this page at @p pfn
+ */
+static int sparse_unchanged(const SparseState_t *sparse, uint64_t pfn, XXH128_hash_t hash)
+{
+  const DumpFile_t *base = &sparse->base;
+
+  if (!sparse->has_base || pfn >= base->page_count || base->index[pfn] == DUMPFILE_PAGE_ABSENT)
+  {
+    return 0;
+  }
+  return base->hashes[pfn].low64 == hash.low64 && base->hashes[pfn].high64 == hash.high64;
+}
+
+/**
+ * @brief Index the pages of a chunk and pack the new ones to its front
+ * @return Bytes of new page data left at the start of @p data
+ */
+static size_t sparse_pack(DumpWriter_t *writer, addr_t pa, uint8_t *data, size_t len)
+{
+  SparseState_t *sparse = &writer->sparse;
+  size_t packed = 0;
+
+  for (size_t off = 0; off < len; off += GUEST_PAGE_SIZE)
+  {
+    uint64_t pfn = (pa + off) / GUEST_PAGE_SIZE;
+    const uint8_t *page = data + off;
+    uint32_t slot;
+
+    if (page_is_zero(page))
+    {
+      sparse->index[pfn] = DUMPFILE_PAGE_ZERO;
+      sparse->hashes[pfn] = (DumpFilePageHash_t){sparse->zero_hash.low64, sparse->zero_hash.high64};
+      writer->stats->pages_zero++;
+      continue;
+    }
+
+    // 128-bit hashes make an accidental collision far less likely than a bad DIMM
+    XXH128_hash_t hash = XXH3_128bits(page, GUEST_PAGE_SIZE);
+    sparse->hashes[pfn] = (DumpFilePageHash_t){hash.low64, hash.high64};
+
+    if (sparse_unchanged(sparse, pfn, hash))
+    {
+      sparse->index[pfn] = DUMPFILE_PAGE_BASE;
+      sparse->base_pages++;
+      continue;
+    }
+
+    int found = sparse_lookup(sparse, hash, &slot);
+    if (found < 0)
+    {
+      writer->failed = 1;
+      return 0;
+    }
+    sparse->index[pfn] = slot;
+    if (found)
+    {
+      writer->stats->pages_duplicate++;
+      continue;
+    }
+
+    // Earlier pages only ever move down, so source and target never overlap
+    if (packed != off)
+    {
+      memcpy(data + packed, page, GUEST_PAGE_SIZE);
+    }
+    packed += GUEST_PAGE_SIZE;
+  }
+  return packed;
+}
+
+static int page_readable(vmi_instance_t vmi, addr_t pa, uint8_t *scratch)
+{
+  return VMI_SUCCESS == vmi_read_pa(vmi, pa, GUEST_PAGE_SIZE, scratch, NULL);
+}
+
+/**
+ * @brief First readable page after the unreadable page at @p pa, or @p max_pa
+ *
+ * Guest physical holes (MMIO, unbacked ranges) are contiguous and large,
+ * so the stride doubles up to HOLE_STEP_MAX and the boundary is then
+ * bisected: a 1 GiB hole costs about 520 failed reads instead of 262144.
+ * A readable island narrower than the current stride can be passed over.
+ */
+addr_t dump_next_readable(vmi_instance_t vmi, addr_t pa, addr_t max_pa, uint8_t *scratch)
+{
+  addr_t unreadable = pa;
+  addr_t step = GUEST_PAGE_SIZE;
+
+  for (;;)
+  {
+    addr_t probe = unreadable + step;
+    if (probe >= max_pa)
+    {
+      return max_pa;
+    }
+    if (page_readable(vmi, probe, scratch))
+    {
+      // Bisect (unreadable, probe] down to the first readable page
+      while (probe - unreadable > GUEST_PAGE_SIZE)
+      {
+        addr_t mid = unreadable + ((probe - unreadable) / 2 & (addr_t)GUEST_PAGE_MASK);
+        if (page_readable(vmi, mid, scratch))
+        {
+          probe = mid;
+        }
+        else
+        {
+          unreadable = mid;
+        }
+      }
+      return probe;
+    }
+    unreadable = probe;
+    step = (step * 2 > HOLE_STEP_MAX) ? HOLE_STEP_MAX : step * 2;
+  }
+}
+
+static void complete(DumpWriter_t *writer, uint64_t index, int32_t result)
+{
+  DumpBuffer_t *buffer = &writer->buffers[index];
+
+  if (result < 0 || (size_t)result != buffer->expected)
+  {
+    writer->failed = 1;
+  }
+  else
+  {
+    writer->stats->bytes_written += (uint64_t)result;
+  }
+  buffer->busy = 0;
+  writer->in_flight--;
+}
+
+/**
+ * @brief Wait for at least one write and retire every finished one
+ * @return 0, or -1 if the ring itself failed
+ */
+static int wait_completions(DumpWriter_t *writer)
+{
+  uint64_t index;
+  int32_t result;
+
+  if (uring_submit(&writer->ring, 1) < 0)
+  {
+    writer->failed = 1;
+    return -1;
+  }
+  while (uring_reap(&writer->ring, &index, &result))
+  {
+    complete(writer, index, result);
+  }
+  return 0;
+}
+
+static DumpBuffer_t *acquire_buffer(DumpWriter_t *writer, unsigned *index)
+{
+  for (;;)
+  {
+    for (unsigned i = 0; i < DUMP_QUEUE_DEPTH; i++)
+    {
+      if (!writer->buffers[i].busy)
+      {
+        *index = i;
+        return &writer->buffers[i];
+      }
+    }
+    wait_completions(writer);
+    if (writer->failed)
+    {
+      return NULL;
+    }
+  }
+}
+
+static void write_sync(DumpWriter_t *writer, const uint8_t *data, size_t len, off_t offset)
+{
+  if (dumpfile_pwrite(writer->fd, data, len, (uint64_t)offset) != 0)
+  {
+    writer->failed = 1;
+    return;
+  }
+  writer->stats->bytes_written += len;
+}
+
+/**
+ * @brief Open the base dump of an incremental dump and remember where it lives
+ */
+static int sparse_open_base(SparseState_t *sparse, const char *base_path)
+{
+  char resolved[PATH_MAX];
+
+  if (DEMO_SUCCESS != dumpfile_open(base_path, &sparse->base))
+  {
+    return -1;
+  }
+  sparse->has_base = 1;
+
+  // Only version 2 sparse dumps carry the page hashes a delta compares against
+  if (sparse->base.kind != DUMPFILE_SPARSE || !sparse->base.hashes)
+  {
+    return -1;
+  }
+
+  const char *recorded = realpath(base_path, resolved) ? resolved : base_path;
+  if (strlen(recorded) >= sizeof(sparse->base_path))
+  {
+    return -1;
+  }
+  strcpy(sparse->base_path, recorded);
+  return 0;
+}
+
+static int sparse_init(DumpWriter_t *writer, addr_t max_pa, const char *base_path)
+{
+  SparseState_t *sparse = &writer->sparse;
+  static const uint8_t zero_page[GUEST_PAGE_SIZE];
+
+  sparse->page_count = (max_pa + GUEST_PAGE_SIZE - 1) / GUEST_PAGE_SIZE;
+  if (sparse->page_count >= DUMPFILE_PAGE_BASE)
+  {
+    return -1;
+  }
+  if (base_path && sparse_open_base(sparse, base_path) != 0)
+  {
+    return -1;
+  }
+  sparse->zero_hash = XXH3_128bits(zero_page, sizeof(zero_page));
+
+  uint64_t index_bytes = dumpfile_index_bytes(sparse->page_count);
+  uint64_t hash_bytes = dumpfile_hash_bytes(sparse->page_count);
+  if (0 != posix_memalign((void **)&sparse->index, GUEST_PAGE_SIZE, index_bytes))
+  {
+    sparse->index = NULL;
+    return -1;
+  }
+  if (0 != posix_memalign((void **)&sparse->hashes, GUEST_PAGE_SIZE, hash_bytes))
+  {
+    sparse->hashes = NULL;
+    return -1;
+  }
+  for (uint64_t i = 0; i < index_bytes / sizeof(uint32_t); i++)
+  {
+    sparse->index[i] = DUMPFILE_PAGE_ABSENT;
+  }
+  memset(sparse->hashes, 0, hash_bytes);
+
+  writer->append_offset = (off_t)(GUEST_PAGE_SIZE + index_bytes + hash_bytes);
+  return sparse_grow(sparse);
+}
+
+/**
+ * @brief Random dump ID; a clock/pid hash if the kernel has no getrandom()
+ */
+static void sparse_dump_id(uint8_t *id)
+{
+  if (getrandom(id, DUMPFILE_ID_LEN, 0) == DUMPFILE_ID_LEN)
+  {
+    return;
+  }
+
+  struct
+  {
+    struct timespec now;
+    pid_t pid;
+  } seed;
+  memset(&seed, 0, sizeof(seed));
+  clock_gettime(CLOCK_REALTIME, &seed.now);
+  seed.pid = getpid();
+  XXH128_hash_t hash = XXH3_128bits(&seed, sizeof(seed));
+  memcpy(id, &hash, DUMPFILE_ID_LEN);
+}
+
+/**
+ * @brief Write the header page and index once all page data is on disk
+ */
+static void sparse_finish(DumpWriter_t *writer)
+{
+  SparseState_t *sparse = &writer->sparse;
+  uint8_t *page;
+
+  if (0 != posix_memalign((void **)&page, GUEST_PAGE_SIZE, GUEST_PAGE_SIZE))
+  {
+    writer->failed = 1;
+    return;
+  }
+  memset(page, 0, GUEST_PAGE_SIZE);
+
+  DumpFileHeader_t *header = (DumpFileHeader_t *)page;
+  memcpy(header->magic, DUMPFILE_MAGIC, sizeof(header->magic));
+  header->version = DUMPFILE_VERSION;
+  header->page_size = GUEST_PAGE_SIZE;
+  header->page_count = sparse->page_count;
+  header->index_offset = GUEST_PAGE_SIZE;
+  header->hash_offset = header->index_offset + dumpfile_index_bytes(sparse->page_count);
+  header->data_offset = header->hash_offset + dumpfile_hash_bytes(sparse->page_count);
+  header->unique_pages = sparse->next_slot;
+  header->zero_pages = writer->stats->pages_zero;
+  header->duplicate_pages = writer->stats->pages_duplicate;
+  header->absent_pages = writer->stats->pages_unreadable;
+  header->base_pages = sparse->base_pages;
+  sparse_dump_id(header->dump_id);
+  if (sparse->has_base)
+  {
+    memcpy(header->base_id, sparse->base.header->dump_id, DUMPFILE_ID_LEN);
+    memcpy(header->base_path, sparse->base_path, sizeof(header->base_path));
+  }
+
+  write_sync(writer, (const uint8_t *)sparse->index, dumpfile_index_bytes(sparse->page_count),
+             (off_t)header->index_offset);
+  write_sync(writer, (const uint8_t *)sparse->hashes, dumpfile_hash_bytes(sparse->page_count),
+             (off_t)header->hash_offset);
+  // Header last, so a failed dump never carries a valid magic
+  if (!writer->failed)
+  {
+    write_sync(writer, page, GUEST_PAGE_SIZE, 0);
+  }
+  free(page);
+}
+
+/**
+ * @brief Write @p len bytes of guest memory at @p pa held in @p buffer
+ */
+static void submit_range(DumpWriter_t *writer, DumpBuffer_t *buffer, unsigned index,
+                         addr_t pa, size_t len)
+{
+  const uint8_t *data = buffer_data(buffer);
+  off_t offset = (off_t)pa;
+
+  if (writer->format == DUMP_FORMAT_LIME)
+  {
+    LimeHeader_t header = {LIME_MAGIC, LIME_VERSION, pa, pa + len - 1, {0}};
+    data -= sizeof(header);
+    memcpy((uint8_t *)data, &header, sizeof(header));
+    len += sizeof(header);
+    offset = writer->append_offset;
+    writer->append_offset += (off_t)len;
+  }
+  else if (writer->format == DUMP_FORMAT_SPARSE)
+  {
+    len = sparse_pack(writer, pa, buffer_data(buffer), len);
+    if (!len)
+    {
+      return; // nothing new in this chunk
+    }
+    offset = writer->append_offset;
+    writer->append_offset += (off_t)len;
+  }
+
+  if (!writer->use_uring)
+  {
+    write_sync(writer, data, len, offset);
+    return;
+  }
+
+  buffer->busy = 1;
+  buffer->expected = len;
+  writer->in_flight++;
+  if (uring_queue_write(&writer->ring, writer->fd, data, len, offset, index) != 0 ||
+      uring_submit(&writer->ring, 0) < 0)
+  {
+    writer->failed = 1;
+  }
+}
+
+static int open_output(DumpWriter_t *writer, const char *path)
+{
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+  // LiME headers break the block alignment O_DIRECT requires
+  if (writer->format != DUMP_FORMAT_LIME)
+  {
+    writer->fd = open(path, flags | O_DIRECT, 0600);
+    if (writer->fd >= 0)
+    {
+      writer->stats->direct_io = 1;
+      return 0;
+    }
+  }
+
+  // tmpfs and some network filesystems reject O_DIRECT
+  writer->fd = open(path, flags, 0600);
+  return (writer->fd >= 0) ? 0 : -1;
+}
+
+static void writer_close(DumpWriter_t *writer)
+{
+  if (writer->use_uring)
+  {
+    // The kernel may still be reading from in-flight buffers
+    while (writer->in_flight && 0 == wait_completions(writer))
+    {
+    }
+    uring_free(&writer->ring);
+  }
+  for (unsigned i = 0; i < DUMP_QUEUE_DEPTH; i++)
+  {
+    free(writer->buffers[i].mem);
+  }
+  free(writer->probe);
+  free(writer->sparse.index);
+  free(writer->sparse.hashes);
+  free(writer->sparse.table);
+  if (writer->sparse.has_base)
+  {
+    dumpfile_close(&writer->sparse.base);
+  }
+  if (writer->fd >= 0)
+  {
+    close(writer->fd);
+  }
+}
+
+demo_error_t dump_memory(vmi_instance_t vmi, const char *path, dump_format_t format,
+                         const char *base_path, DumpStats_t *stats)
+{
+  DumpWriter_t writer;
+  struct timespec start, end;
+
+  if (format == DUMP_FORMAT_ZSTD)
+  {
+    return base_path ? DEMO_ERROR_INIT : zdump_memory(vmi, path, stats);
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  memset(&writer, 0, sizeof(writer));
+  writer.format = format;
+  writer.stats = stats;
+  writer.fd = -1;
+
+  for (unsigned i = 0; i < DUMP_QUEUE_DEPTH; i++)
+  {
+    if (0 != posix_memalign((void **)&writer.buffers[i].mem, GUEST_PAGE_SIZE,
+                            GUEST_PAGE_SIZE + DUMP_CHUNK_SIZE))
+    {
+      writer_close(&writer);
+      return DEMO_ERROR_MEMORY;
+    }
+  }
+  writer.probe = malloc(GUEST_PAGE_SIZE);
+  if (!writer.probe)
+  {
+    writer_close(&writer);
+    return DEMO_ERROR_MEMORY;
+  }
+
+  // Truncating the base while it is mapped would destroy it
+  struct stat base_st, out_st;
+  if (base_path && 0 == stat(base_path, &base_st) && 0 == stat(path, &out_st) &&
+      base_st.st_dev == out_st.st_dev && base_st.st_ino == out_st.st_ino)
+  {
+    writer_close(&writer);
+    return DEMO_ERROR_INIT;
+  }
+
+  if (open_output(&writer, path) != 0)
+  {
+    writer_close(&writer);
+    return DEMO_ERROR_INIT;
+  }
+
+  // Kernels without io_uring (or with it disabled by policy) get plain pwrite()
+  writer.use_uring = (0 == uring_init(&writer.ring, DUMP_QUEUE_DEPTH));
+  stats->used_uring = writer.use_uring;
+
+  addr_t max_pa = vmi_get_max_physical_address(vmi);
+  if (base_path && format != DUMP_FORMAT_SPARSE)
+  {
+    writer_close(&writer);
+    return DEMO_ERROR_INIT;
+  }
+  if (format == DUMP_FORMAT_SPARSE && sparse_init(&writer, max_pa, base_path) != 0)
+  {
+    writer_close(&writer);
+    return DEMO_ERROR_MEMORY;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  addr_t pa = 0;
+  while (pa < max_pa && !writer.failed)
+  {
+    unsigned index = 0;
+    DumpBuffer_t *buffer = acquire_buffer(&writer, &index);
+    if (!buffer)
+    {
+      break;
+    }
+
+    size_t want = (max_pa - pa < DUMP_CHUNK_SIZE) ? (size_t)(max_pa - pa) : DUMP_CHUNK_SIZE;
+    size_t got = 0;
+    vmi_read_pa(vmi, pa, want, buffer_data(buffer), &got);
+    got &= (size_t)GUEST_PAGE_MASK;
+
+    if (got)
+    {
+      stats->bytes_read += got;
+      submit_range(&writer, buffer, index, pa, got);
+    }
+
+    if (got == want)
+    {
+      pa += got;
+    }
+    else
+    {
+      // Unreadable range: leave a hole (raw), end the LiME range, or mark it absent (sparse)
+      addr_t hole = pa + got;
+      pa = dump_next_readable(vmi, hole, max_pa, writer.probe);
+      stats->pages_unreadable += (pa - hole + GUEST_PAGE_SIZE - 1) / GUEST_PAGE_SIZE;
+    }
+  }
+
+  while (writer.use_uring && writer.in_flight && 0 == wait_completions(&writer))
+  {
+  }
+
+  if (!writer.failed && format == DUMP_FORMAT_SPARSE)
+  {
+    sparse_finish(&writer);
+    stats->pages_unchanged = writer.sparse.base_pages;
+  }
+
+  // Trailing holes still have to exist in a raw image
+  if (!writer.failed && format == DUMP_FORMAT_RAW && ftruncate(writer.fd, (off_t)max_pa) != 0)
+  {
+    writer.failed = 1;
+  }
+  if (!writer.failed && fdatasync(writer.fd) != 0)
+  {
+    writer.failed = 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  stats->seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+  int failed = writer.failed;
+  writer_close(&writer);
+  return failed ? DEMO_ERROR_MEMORY : DEMO_SUCCESS;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file dump.h
+ * @brief Full guest physical memory acquisition (raw, LiME, sparse or zstd)
+ *
+ * Guest memory is read in large chunks into a small pool of aligned
+ * buffers, and each filled buffer is queued as an io_uring write while
+ * the next one is being read, so reads and disk writes overlap. The
+ * sparse format drops all-zero pages and stores identical pages once
+ * (see dumpfile.h). The zstd format is written by zdump.c.
+ */
+
+#ifndef DUMP_H
+#define DUMP_H
+
+#include "vmi_demo.h"
+
+#define DUMP_CHUNK_SIZE (4 * 1024 * 1024)
+#define DUMP_QUEUE_DEPTH 8
+
+typedef enum
+{
+  DUMP_FORMAT_RAW,    // flat image, file offset == physical address, holes left sparse
+  DUMP_FORMAT_LIME,   // LiME: one 32-byte range header before each readable run
+  DUMP_FORMAT_SPARSE, // page index + deduplicated pages, zero pages elided
+  DUMP_FORMAT_ZSTD,   // independently compressed 1 MiB chunks + chunk index
+} dump_format_t;
+
+typedef struct DumpStats_t
+{
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  uint64_t pages_unreadable; // MMIO holes and unbacked frames
+  uint64_t pages_zero;       // sparse only: elided all-zero pages
+  uint64_t pages_duplicate;  // sparse only: pages stored once for several frames
+  uint64_t pages_unchanged;  // sparse only: pages left to the base dump
+  double seconds;
+  int used_uring; // 0 if io_uring was unavailable and pwrite() was used
+  int direct_io;  // O_DIRECT accepted by the target filesystem
+  unsigned compress_threads; // zstd only; 0 means compression ran on the reading thread
+} DumpStats_t;
+
+/**
+ * @brief Parse "raw" / "lime" / "sparse" / "zstd"
+ * @return 0 on success, -1 for an unknown name
+ */
+int dump_parse_format(const char *name, dump_format_t *format);
+
+/**
+ * @brief Acquire all guest physical memory into @p path
+ *
+ * Only memory access is needed; the VMI instance does not have to be
+ * OS-initialized. With @p base_path (sparse format only) the dump is
+ * incremental: pages whose hash matches that dump are not stored again.
+ */
+demo_error_t dump_memory(vmi_instance_t vmi, const char *path, dump_format_t format,
+                         const char *base_path, DumpStats_t *stats);
+
+/**
+ * @brief First readable page after the unreadable page at @p pa, or @p max_pa
+ *
+ * Skips a physical hole in doubling strides, then bisects its end.
+ * @p scratch receives the probed pages (GUEST_PAGE_SIZE bytes).
+ */
+addr_t dump_next_readable(vmi_instance_t vmi, addr_t pa, addr_t max_pa, uint8_t *scratch);
+
+#endif // DUMP_H
@@ -0,0 +1,537 @@
+/**
+ * @file dumpfile.c
+ * @brief Offline memory dump reader (sparse and compressed formats)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zstd.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "dumpfile.h"
+
+#define EXPORT_RUN_MAX (1024 * 1024) // largest single write when exporting
+
+typedef struct CachedChunk_t
+{
+  uint64_t chunk;
+  uint64_t last_used; // 0 = empty
+  uint8_t *data;
+} CachedChunk_t;
+
+struct ChunkCache_t
+{
+  ZSTD_DCtx *dctx;
+  uint64_t tick;
+  CachedChunk_t entries[DUMPFILE_ZCACHE_CHUNKS];
+};
+
+static const uint8_t g_zero_page[GUEST_PAGE_SIZE];
+
+static int id_is_zero(const uint8_t *id)
+{
+  for (unsigned i = 0; i < DUMPFILE_ID_LEN; i++)
+  {
+    if (id[i])
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int try_open_base(const char *path, const uint8_t *id, DumpFile_t *base)
+{
+  if (DEMO_SUCCESS != dumpfile_open(path, base))
+  {
+    return -1;
+  }
+  if (base->kind != DUMPFILE_SPARSE || !base->hashes ||
+      0 != memcmp(base->header->dump_id, id, DUMPFILE_ID_LEN))
+  {
+    dumpfile_close(base);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Open the base of an incremental dump at @p path
+ *
+ * Dump sets are often moved as a directory, so a base that is not at its
+ * recorded path is also looked for next to the delta.
+ */
+static int open_base(DumpFile_t *dump, const char *path)
+{
+  const DumpFileHeader_t *header = dump->header;
+  char recorded[DUMPFILE_BASE_PATH_MAX];
+  char delta[PATH_MAX];
+  char sibling[PATH_MAX + DUMPFILE_BASE_PATH_MAX];
+
+  dump->base = calloc(1, sizeof(*dump->base));
+  if (!dump->base)
+  {
+    return -1;
+  }
+
+  memcpy(recorded, header->base_path, sizeof(recorded));
+  recorded[sizeof(recorded) - 1] = '\0';
+  if (0 == try_open_base(recorded, header->base_id, dump->base))
+  {
+    return 0;
+  }
+
+  snprintf(delta, sizeof(delta), "%s", path);
+  snprintf(sibling, sizeof(sibling), "%s/%s", dirname(delta), basename(recorded));
+  if (0 == try_open_base(sibling, header->base_id, dump->base))
+  {
+    return 0;
+  }
+
+  free(dump->base);
+  dump->base = NULL;
+  return -1;
+}
+
+static int open_sparse(DumpFile_t *dump, const char *path)
+{
+  const DumpFileHeader_t *header = (const DumpFileHeader_t *)dump->map;
+  uint64_t index_bytes = dumpfile_index_bytes(header->page_count);
+
+  if ((header->version != 1 && header->version != DUMPFILE_VERSION) ||
+      header->page_size != GUEST_PAGE_SIZE ||
+      header->index_offset + index_bytes > header->data_offset ||
+      header->data_offset > dump->map_len ||
+      header->unique_pages > (dump->map_len - header->data_offset) / GUEST_PAGE_SIZE)
+  {
+    return -1;
+  }
+
+  dump->kind = DUMPFILE_SPARSE;
+  dump->page_count = header->page_count;
+  dump->header = header;
+  dump->index = (const uint32_t *)(dump->map + header->index_offset);
+  dump->data = dump->map + header->data_offset;
+
+  if (header->version == 1)
+  {
+    return 0;
+  }
+
+  if (header->hash_offset < header->index_offset + index_bytes ||
+      header->hash_offset + dumpfile_hash_bytes(header->page_count) > header->data_offset)
+  {
+    return -1;
+  }
+  dump->hashes = (const DumpFilePageHash_t *)(dump->map + header->hash_offset);
+
+  return id_is_zero(header->base_id) ? 0 : open_base(dump, path);
+}
+
+static int open_compressed(DumpFile_t *dump)
+{
+  const DumpFileZHeader_t *header = (const DumpFileZHeader_t *)dump->map;
+  uint64_t chunk_size = header->chunk_size;
+
+  if (header->version != DUMPFILE_ZVERSION || header->chunk_size != DUMPFILE_ZCHUNK_SIZE ||
+      header->chunk_count != (header->max_pa + chunk_size - 1) / chunk_size ||
+      header->index_offset > dump->map_len ||
+      header->chunk_count > (dump->map_len - header->index_offset) / sizeof(DumpFileZChunk_t))
+  {
+    return -1;
+  }
+
+  dump->cache = calloc(1, sizeof(*dump->cache));
+  if (!dump->cache)
+  {
+    return -1;
+  }
+  dump->cache->dctx = ZSTD_createDCtx();
+  if (!dump->cache->dctx)
+  {
+    return -1;
+  }
+
+  dump->kind = DUMPFILE_COMPRESSED;
+  dump->page_count = (header->max_pa + GUEST_PAGE_SIZE - 1) / GUEST_PAGE_SIZE;
+  dump->zheader = header;
+  dump->chunks = (const DumpFileZChunk_t *)(dump->map + header->index_offset);
+  return 0;
+}
+
+demo_error_t dumpfile_open(const char *path, DumpFile_t *dump)
+{
+  struct stat st;
+
+  memset(dump, 0, sizeof(*dump));
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return DEMO_ERROR_INIT;
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < GUEST_PAGE_SIZE)
+  {
+    close(fd);
+    return DEMO_ERROR_INIT;
+  }
+
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+  dump->map = map;
+  dump->map_len = (size_t)st.st_size;
+
+  int rc = -1;
+  if (0 == memcmp(map, DUMPFILE_MAGIC, 8))
+  {
+    rc = open_sparse(dump, path);
+  }
+  else if (0 == memcmp(map, DUMPFILE_ZMAGIC, 8))
+  {
+    rc = open_compressed(dump);
+  }
+  if (rc != 0)
+  {
+    dumpfile_close(dump);
+    return DEMO_ERROR_INIT;
+  }
+  return DEMO_SUCCESS;
+}
+
+static size_t chunk_bytes(const DumpFileZHeader_t *header, uint64_t chunk)
+{
+  uint64_t start = chunk * header->chunk_size;
+  uint64_t left = header->max_pa - start;
+  return (left < header->chunk_size) ? (size_t)left : header->chunk_size;
+}
+
+/**
+ * @brief Inflated contents of @p chunk, evicting the least recently used entry on a miss
+ */
+static const uint8_t *cache_get(DumpFile_t *dump, uint64_t chunk)
+{
+  ChunkCache_t *cache = dump->cache;
+  CachedChunk_t *victim = &cache->entries[0];
+
+  cache->tick++;
+  for (unsigned i = 0; i < DUMPFILE_ZCACHE_CHUNKS; i++)
+  {
+    CachedChunk_t *entry = &cache->entries[i];
+    if (entry->last_used && entry->chunk == chunk)
+    {
+      entry->last_used = cache->tick;
+      return entry->data;
+    }
+    if (entry->last_used < victim->last_used)
+    {
+      victim = entry;
+    }
+  }
+
+  const DumpFileZChunk_t *index = &dump->chunks[chunk];
+  if (index->offset > dump->map_len || index->length > dump->map_len - index->offset)
+  {
+    return NULL;
+  }
+  if (!victim->data && !(victim->data = malloc(DUMPFILE_ZCHUNK_SIZE)))
+  {
+    return NULL;
+  }
+
+  size_t expected = chunk_bytes(dump->zheader, chunk);
+  size_t size = ZSTD_decompressDCtx(cache->dctx, victim->data, DUMPFILE_ZCHUNK_SIZE,
+                                    dump->map + index->offset, index->length);
+  if (ZSTD_isError(size) || size != expected)
+  {
+    victim->last_used = 0;
+    return NULL;
+  }
+  victim->chunk = chunk;
+  victim->last_used = cache->tick;
+  return victim->data;
+}
+
+const uint8_t *dumpfile_page(DumpFile_t *dump, uint64_t pfn)
+{
+  if (pfn >= dump->page_count)
+  {
+    return NULL;
+  }
+
+  if (dump->kind == DUMPFILE_COMPRESSED)
+  {
+    uint64_t pa = pfn * GUEST_PAGE_SIZE;
+    const uint8_t *data = cache_get(dump, pa / DUMPFILE_ZCHUNK_SIZE);
+    return data ? data + (pa % DUMPFILE_ZCHUNK_SIZE) : NULL;
+  }
+
+  uint32_t slot = dump->index[pfn];
+  if (slot == DUMPFILE_PAGE_ZERO)
+  {
+    return g_zero_page;
+  }
+  if (slot == DUMPFILE_PAGE_BASE)
+  {
+    return dump->base ? dumpfile_page(dump->base, pfn) : NULL;
+  }
+  if (slot >= dump->header->unique_pages)
+  {
+    return NULL;
+  }
+  return dump->data + (size_t)slot * GUEST_PAGE_SIZE;
+}
+
+void dumpfile_close(DumpFile_t *dump)
+{
+  if (dump->base)
+  {
+    dumpfile_close(dump->base);
+    free(dump->base);
+  }
+  if (dump->cache)
+  {
+    for (unsigned i = 0; i < DUMPFILE_ZCACHE_CHUNKS; i++)
+    {
+      free(dump->cache->entries[i].data);
+    }
+    ZSTD_freeDCtx(dump->cache->dctx);
+    free(dump->cache);
+  }
+  if (dump->map)
+  {
+    munmap((void *)dump->map, dump->map_len);
+  }
+  memset(dump, 0, sizeof(*dump));
+}
+
+/**
+ * @brief Count sparse index entries that point past the data area
+ */
+static uint64_t sparse_info(const DumpFile_t *dump)
+{
+  const DumpFileHeader_t *header = dump->header;
+  uint64_t bad = 0;
+
+  for (uint64_t pfn = 0; pfn < header->page_count; pfn++)
+  {
+    uint32_t slot = dump->index[pfn];
+    if (slot < DUMPFILE_PAGE_BASE && slot >= header->unique_pages)
+    {
+      bad++;
+    }
+  }
+
+  printf("  Unique pages:    %lu\n", (unsigned long)header->unique_pages);
+  printf("  Zero pages:      %lu\n", (unsigned long)header->zero_pages);
+  printf("  Duplicate pages: %lu\n", (unsigned long)header->duplicate_pages);
+  printf("  Absent pages:    %lu\n", (unsigned long)header->absent_pages);
+  if (dump->base)
+  {
+    printf("  Base pages:      %lu (unchanged since %s)\n", (unsigned long)header->base_pages,
+           header->base_path);
+  }
+  return bad;
+}
+
+/**
+ * @brief Read every captured page back and count those that do not match their hash
+ */
+static uint64_t verify_hashes(DumpFile_t *dump, uint64_t *checked)
+{
+  uint64_t bad = 0;
+
+  *checked = 0;
+  for (uint64_t pfn = 0; pfn < dump->page_count; pfn++)
+  {
+    if (dump->index[pfn] == DUMPFILE_PAGE_ABSENT)
+    {
+      continue;
+    }
+    const uint8_t *page = dumpfile_page(dump, pfn);
+    XXH128_hash_t hash = page ? XXH3_128bits(page, GUEST_PAGE_SIZE) : (XXH128_hash_t){0, 0};
+    if (!page || hash.low64 != dump->hashes[pfn].low64 || hash.high64 != dump->hashes[pfn].high64)
+    {
+      bad++;
+    }
+    (*checked)++;
+  }
+  return bad;
+}
+
+/**
+ * @brief Count chunks whose frame lies outside the file or has the wrong size
+ */
+static uint64_t compressed_info(const DumpFile_t *dump)
+{
+  const DumpFileZHeader_t *header = dump->zheader;
+  uint64_t bad = 0;
+
+  for (uint64_t chunk = 0; chunk < header->chunk_count; chunk++)
+  {
+    const DumpFileZChunk_t *index = &dump->chunks[chunk];
+    if (index->offset > dump->map_len || index->length > dump->map_len - index->offset ||
+        ZSTD_getFrameContentSize(dump->map + index->offset, index->length) !=
+            chunk_bytes(header, chunk))
+    {
+      bad++;
+    }
+  }
+
+  printf("  Chunks:          %lu x %u KiB (zstd)\n", (unsigned long)header->chunk_count,
+         header->chunk_size / 1024);
+  printf("  Absent pages:    %lu (stored as zeros)\n", (unsigned long)header->absent_pages);
+  return bad;
+}
+
+demo_error_t dumpfile_info(const char *path)
+{
+  DumpFile_t dump;
+
+  if (DEMO_SUCCESS != dumpfile_open(path, &dump))
+  {
+    printf("ERROR: '%s' is not a readable sparse or compressed dump\n", path);
+    return DEMO_ERROR_INIT;
+  }
+
+  double guest_mib = (double)dump.page_count * GUEST_PAGE_SIZE / (1024.0 * 1024.0);
+  double file_mib = (double)dump.map_len / (1024.0 * 1024.0);
+  printf("%s dump %s\n", (dump.kind == DUMPFILE_SPARSE) ? "Sparse" : "Compressed", path);
+  printf("  Guest pages:     %lu (%.1f MiB)\n", (unsigned long)dump.page_count, guest_mib);
+
+  uint64_t bad = (dump.kind == DUMPFILE_SPARSE) ? sparse_info(&dump) : compressed_info(&dump);
+
+  printf("  File size:       %.1f MiB (%.1f%% of guest)\n", file_mib,
+         guest_mib > 0 ? 100.0 * file_mib / guest_mib : 0.0);
+
+  if (bad)
+  {
+    dumpfile_close(&dump);
+    printf("ERROR: %lu index entries are inconsistent\n", (unsigned long)bad);
+    return DEMO_ERROR_MEMORY;
+  }
+  printf("✓ Index consistent\n");
+
+  if (dump.kind == DUMPFILE_SPARSE && dump.hashes)
+  {
+    uint64_t checked = 0;
+    bad = verify_hashes(&dump, &checked);
+    if (bad)
+    {
+      dumpfile_close(&dump);
+      printf("ERROR: %lu of %lu pages do not match their recorded hash\n", (unsigned long)bad,
+             (unsigned long)checked);
+      return DEMO_ERROR_MEMORY;
+    }
+    printf("✓ %lu pages match their recorded hashes%s\n", (unsigned long)checked,
+           dump.base ? " (read through the base dumps)" : "");
+  }
+  dumpfile_close(&dump);
+  return DEMO_SUCCESS;
+}
+
+int dumpfile_pwrite(int fd, const void *data, size_t len, uint64_t offset)
+{
+  const uint8_t *bytes = data;
+
+  while (len > 0)
+  {
+    ssize_t written = pwrite(fd, bytes, len, (off_t)offset);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written <= 0)
+    {
+      return -1;
+    }
+    bytes += written;
+    len -= (size_t)written;
+    offset += (uint64_t)written;
+  }
+  return 0;
+}
+
+demo_error_t dumpfile_export(const char *path, const char *out_path)
+{
+  DumpFile_t dump;
+  uint64_t written = 0, holes = 0, absent = 0;
+  size_t run = 0;
+  uint64_t run_start = 0;
+
+  if (DEMO_SUCCESS != dumpfile_open(path, &dump))
+  {
+    printf("ERROR: '%s' is not a readable sparse or compressed dump\n", path);
+    return DEMO_ERROR_INIT;
+  }
+
+  uint8_t *buffer = malloc(EXPORT_RUN_MAX);
+  int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  int failed = (!buffer || fd < 0);
+
+  // Consecutive data pages are gathered into one write; compressed pages
+  // only stay valid until the next lookup, so they are copied
+  for (uint64_t pfn = 0; pfn < dump.page_count && !failed; pfn++)
+  {
+    const uint8_t *page = dumpfile_page(&dump, pfn);
+    int hole = !page || page == g_zero_page || 0 == memcmp(page, g_zero_page, GUEST_PAGE_SIZE);
+
+    if (run && (hole || run == EXPORT_RUN_MAX))
+    {
+      failed = dumpfile_pwrite(fd, buffer, run, run_start * GUEST_PAGE_SIZE);
+      written += run / GUEST_PAGE_SIZE;
+      run = 0;
+    }
+    if (hole)
+    {
+      absent += !page;
+      holes += !!page;
+      continue;
+    }
+    if (!run)
+    {
+      run_start = pfn;
+    }
+    memcpy(buffer + run, page, GUEST_PAGE_SIZE);
+    run += GUEST_PAGE_SIZE;
+  }
+  if (run && !failed)
+  {
+    failed = dumpfile_pwrite(fd, buffer, run, run_start * GUEST_PAGE_SIZE);
+    written += run / GUEST_PAGE_SIZE;
+  }
+
+  // Trailing holes still have to exist in a raw image
+  if (!failed && ftruncate(fd, (off_t)(dump.page_count * GUEST_PAGE_SIZE)) != 0)
+  {
+    failed = 1;
+  }
+  if (fd >= 0)
+  {
+    failed |= (close(fd) != 0);
+  }
+  free(buffer);
+  dumpfile_close(&dump);
+
+  if (failed)
+  {
+    printf("ERROR: Could not write raw image %s\n", out_path);
+    return DEMO_ERROR_MEMORY;
+  }
+  printf("✓ Raw image %s: %lu pages written, %lu zero and %lu absent pages left as holes\n",
+         out_path, (unsigned long)written, (unsigned long)holes, (unsigned long)absent);
+  return DEMO_SUCCESS;
+}
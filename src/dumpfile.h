@@ -0,0 +1,183 @@
+/**
+ * @file dumpfile.h
+ * @brief Offline memory dump formats and their reader
+ *
+ * Sparse layout (all offsets page aligned):
+ *   header page | page index (uint32_t per guest page) | page hashes | unique page data
+ *
+ * Each index entry is either a slot number into the data area or one of
+ * the DUMPFILE_PAGE_* markers, so all-zero and unreadable pages take no
+ * data and identical pages share one slot. Opening a dump maps it once;
+ * page lookups are an index load and a pointer add.
+ *
+ * An incremental sparse dump names a base dump; pages whose hash matches
+ * the base are marked DUMPFILE_PAGE_BASE and read through from it, so a
+ * chain of deltas resolves back to the full dump it started from. Page
+ * hashes (version 2) are kept for every page, inherited ones included,
+ * so any dump can serve as the next delta's base.
+ *
+ * Compressed layout:
+ *   header page | zstd frames, one per chunk, in completion order | chunk index
+ *
+ * Every DUMPFILE_ZCHUNK_SIZE bytes of guest memory are compressed on
+ * their own, so any address can be read by inflating a single chunk.
+ * The reader keeps recently inflated chunks in a small cache.
+ */
+
+#ifndef DUMPFILE_H
+#define DUMPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vmi_demo.h"
+
+#define DUMPFILE_MAGIC "VMISPRS1"
+#define DUMPFILE_VERSION 2 // 1: no page hashes, no base
+#define DUMPFILE_PAGE_ZERO 0xffffffffu
+#define DUMPFILE_PAGE_ABSENT 0xfffffffeu // unreadable in the guest (MMIO hole)
+#define DUMPFILE_PAGE_BASE 0xfffffffdu   // unchanged since the base dump
+#define DUMPFILE_ID_LEN 16
+#define DUMPFILE_BASE_PATH_MAX 256
+
+#define DUMPFILE_ZMAGIC "VMIZSTD1"
+#define DUMPFILE_ZVERSION 1
+#define DUMPFILE_ZCHUNK_SIZE (1024 * 1024)
+#define DUMPFILE_ZCACHE_CHUNKS 16
+
+typedef struct DumpFileHeader_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t page_size;
+  uint64_t page_count; // guest pages covered by the index
+  uint64_t index_offset;
+  uint64_t data_offset;
+  uint64_t unique_pages;
+  uint64_t zero_pages;
+  uint64_t duplicate_pages;
+  uint64_t absent_pages;
+
+  // Version 2
+  uint64_t hash_offset; // DumpFilePageHash_t per guest page
+  uint64_t base_pages;  // pages read through from the base
+  uint8_t dump_id[DUMPFILE_ID_LEN];
+  uint8_t base_id[DUMPFILE_ID_LEN]; // all zero for a full dump
+  char base_path[DUMPFILE_BASE_PATH_MAX];
+} DumpFileHeader_t;
+
+// XXH3-128 of a page's contents; absent pages hash to zero
+typedef struct DumpFilePageHash_t
+{
+  uint64_t low64;
+  uint64_t high64;
+} DumpFilePageHash_t;
+
+typedef struct DumpFileZHeader_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t chunk_size;
+  uint64_t chunk_count;
+  uint64_t max_pa;
+  uint64_t index_offset; // chunk_count DumpFileZChunk_t entries
+  uint64_t absent_pages; // stored as zeros
+} DumpFileZHeader_t;
+
+typedef struct DumpFileZChunk_t
+{
+  uint64_t offset;
+  uint32_t length; // compressed bytes
+  uint32_t reserved;
+} DumpFileZChunk_t;
+
+typedef enum
+{
+  DUMPFILE_SPARSE,
+  DUMPFILE_COMPRESSED,
+} dumpfile_kind_t;
+
+typedef struct ChunkCache_t ChunkCache_t;
+
+typedef struct DumpFile_t DumpFile_t;
+
+struct DumpFile_t
+{
+  const uint8_t *map;
+  size_t map_len;
+  dumpfile_kind_t kind;
+  uint64_t page_count;
+
+  // Sparse
+  const DumpFileHeader_t *header;
+  const uint32_t *index;
+  const DumpFilePageHash_t *hashes; // NULL for version 1
+  const uint8_t *data;
+  DumpFile_t *base;                 // opened for incremental dumps
+
+  // Compressed
+  const DumpFileZHeader_t *zheader;
+  const DumpFileZChunk_t *chunks;
+  ChunkCache_t *cache;
+};
+
+/**
+ * @brief Map and validate a sparse or compressed dump
+ *
+ * The base of an incremental dump is looked for at its recorded path and
+ * then next to @p path, and must carry the recorded dump ID.
+ */
+demo_error_t dumpfile_open(const char *path, DumpFile_t *dump);
+
+/**
+ * @brief Page contents for guest frame @p pfn, or NULL if it was not captured
+ *
+ * Zero pages resolve to a shared zero page. For compressed dumps the
+ * pointer refers to the chunk cache and stays valid only until the next
+ * call on @p dump; handles are not thread safe.
+ */
+const uint8_t *dumpfile_page(DumpFile_t *dump, uint64_t pfn);
+
+void dumpfile_close(DumpFile_t *dump);
+
+/**
+ * @brief Print header statistics and check every index entry
+ *
+ * Sparse dumps with page hashes are also read back page by page, through
+ * any chain of base dumps, and every page is checked against its hash.
+ */
+demo_error_t dumpfile_info(const char *path);
+
+/**
+ * @brief Expand a sparse or compressed dump into a flat raw image at @p out_path
+ *
+ * File offset equals physical address, and zero and absent pages are left
+ * as holes. LibVMI's file mode reads the result when it is given the image
+ * path in place of a domain name.
+ */
+demo_error_t dumpfile_export(const char *path, const char *out_path);
+
+/**
+ * @brief Write @p len bytes at file @p offset, retrying short and interrupted writes
+ * @return 0 on success, -1 on error
+ */
+int dumpfile_pwrite(int fd, const void *data, size_t len, uint64_t offset);
+
+/**
+ * @brief Bytes reserved for the page index, padded to a whole page
+ */
+static inline uint64_t dumpfile_index_bytes(uint64_t page_count)
+{
+  uint64_t bytes = page_count * sizeof(uint32_t);
+  return (bytes + GUEST_PAGE_SIZE - 1) & GUEST_PAGE_MASK;
+}
+
+/**
+ * @brief Bytes reserved for the page hashes, padded to a whole page
+ */
+static inline uint64_t dumpfile_hash_bytes(uint64_t page_count)
+{
+  uint64_t bytes = page_count * sizeof(DumpFilePageHash_t);
+  return (bytes + GUEST_PAGE_SIZE - 1) & GUEST_PAGE_MASK;
+}
+
+#endif // DUMPFILE_H
@@ -0,0 +1,448 @@
+/**
+ * @file evtrace.c
+ * @brief Record and replay of guest events with the memory they read
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "evtrace.h"
+#include "proctrack.h"
+
+#define MAP_MIN 1024
+#define STR_MAX 4096 // longest string served during replay
+#define WRITE_BUFFER (1 << 20)
+
+typedef enum
+{
+  MODE_OFF,
+  MODE_RECORD,
+  MODE_REPLAY
+} trace_mode_t;
+
+// Open-addressing map keyed by page VA
+typedef struct PageMap_t
+{
+  addr_t *keys;     // page VA | 1, 0 for an empty slot
+  uint64_t *values; // recording: content hash; replaying: data index + 1, 0 if absent
+  size_t count;
+  size_t capacity;
+} PageMap_t;
+
+static trace_mode_t g_mode = MODE_OFF;
+static int g_in_event; // recording: reads belong to the current event
+static FILE *g_file;
+static PageMap_t g_pages;
+static uint8_t *g_data; // replay page contents, GUEST_PAGE_SIZE each
+static size_t g_data_pages;
+static size_t g_data_capacity;
+static uint64_t g_missing; // replayed reads of pages the trace never recorded
+
+static size_t map_hash(addr_t key, size_t capacity)
+{
+  return (size_t)(((key >> 12) * 0x9e3779b97f4a7c15ull) >> 32) & (capacity - 1);
+}
+
+/**
+ * @brief Find @p page's slot, adding it if @p insert; 0 if absent or out of memory
+ */
+static int map_find(PageMap_t *map, addr_t page, int insert, size_t *slot)
+{
+  addr_t key = page | 1;
+
+  if (insert && (map->count + 1) * 2 > map->capacity)
+  {
+    size_t capacity = map->capacity ? map->capacity * 2 : MAP_MIN;
+    addr_t *keys = calloc(capacity, sizeof(*keys));
+    uint64_t *values = calloc(capacity, sizeof(*values));
+    if (!keys || !values)
+    {
+      free(keys);
+      free(values);
+      return 0;
+    }
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+      if (map->keys[i])
+      {
+        size_t j = map_hash(map->keys[i], capacity);
+        while (keys[j])
+        {
+          j = (j + 1) & (capacity - 1);
+        }
+        keys[j] = map->keys[i];
+        values[j] = map->values[i];
+      }
+    }
+    free(map->keys);
+    free(map->values);
+    map->keys = keys;
+    map->values = values;
+    map->capacity = capacity;
+  }
+
+  if (!map->capacity)
+  {
+    return 0;
+  }
+
+  size_t i = map_hash(key, map->capacity);
+  while (map->keys[i] && map->keys[i] != key)
+  {
+    i = (i + 1) & (map->capacity - 1);
+  }
+  if (!map->keys[i] && !insert)
+  {
+    return 0;
+  }
+  if (!map->keys[i])
+  {
+    map->keys[i] = key;
+    map->values[i] = 0;
+    map->count++;
+  }
+  *slot = i;
+  return 1;
+}
+
+static void map_free(PageMap_t *map)
+{
+  free(map->keys);
+  free(map->values);
+  memset(map, 0, sizeof(*map));
+}
+
+int evtrace_replaying(void)
+{
+  return g_mode == MODE_REPLAY;
+}
+
+demo_error_t evtrace_record_start(const char *path, const KernelOffsets_t *offsets, addr_t list_head)
+{
+  EvTraceHeader_t header;
+
+  g_file = fopen(path, "wb");
+  if (!g_file)
+  {
+    return DEMO_ERROR_INIT;
+  }
+  setvbuf(g_file, NULL, _IOFBF, WRITE_BUFFER);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, EVTRACE_MAGIC, sizeof(header.magic));
+  header.version = EVTRACE_VERSION;
+  header.page_size = GUEST_PAGE_SIZE;
+  header.list_head = list_head;
+  header.eprocess_tasks = offsets->eprocess_tasks;
+  header.eprocess_pid = offsets->eprocess_pid;
+  header.eprocess_pname = offsets->eprocess_pname;
+  header.eprocess_peb = offsets->eprocess_peb;
+  header.eprocess_threads = offsets->eprocess_threads;
+  header.kprocess_pdbase = offsets->kprocess_pdbase;
+  header.kprocess_user_pdbase = offsets->kprocess_user_pdbase;
+
+  if (1 != fwrite(&header, sizeof(header), 1, g_file))
+  {
+    fclose(g_file);
+    g_file = NULL;
+    return DEMO_ERROR_INIT;
+  }
+  g_mode = MODE_RECORD;
+  return DEMO_SUCCESS;
+}
+
+void evtrace_record_stop(void)
+{
+  if (g_mode == MODE_RECORD)
+  {
+    if (0 != fclose(g_file))
+    {
+      fprintf(stderr, "WARNING: Event trace may be incomplete\n");
+    }
+    g_file = NULL;
+    g_mode = MODE_OFF;
+    map_free(&g_pages);
+  }
+}
+
+static void write_record(uint32_t type, uint32_t flags, uint64_t value, const void *page)
+{
+  EvTraceRecord_t record = {type, flags, value};
+
+  if (1 != fwrite(&record, sizeof(record), 1, g_file) ||
+      (page && 1 != fwrite(page, GUEST_PAGE_SIZE, 1, g_file)))
+  {
+    // Keep the guest running; a short trace is still replayable up to here
+    fprintf(stderr, "WARNING: Event trace write failed; recording stopped\n");
+    evtrace_record_stop();
+  }
+}
+
+void evtrace_event(evtrace_record_t type, addr_t value)
+{
+  if (g_mode == MODE_RECORD)
+  {
+    write_record(type, 0, value, NULL);
+    g_in_event = 1;
+  }
+}
+
+void evtrace_event_end(void)
+{
+  g_in_event = 0;
+}
+
+void evtrace_capture(vmi_instance_t vmi, addr_t va, size_t len)
+{
+  uint8_t page_buf[GUEST_PAGE_SIZE];
+  addr_t last = (va + (len ? len : 1) - 1) & GUEST_PAGE_MASK;
+
+  for (addr_t page = va & GUEST_PAGE_MASK; g_mode == MODE_RECORD && g_in_event && page <= last;
+       page += GUEST_PAGE_SIZE)
+  {
+    size_t got = 0;
+    int present = VMI_SUCCESS == vmi_read_va(vmi, page, 0, GUEST_PAGE_SIZE, page_buf, &got) &&
+                  got == GUEST_PAGE_SIZE;
+    uint64_t hash = present ? XXH3_64bits(page_buf, GUEST_PAGE_SIZE) : 0;
+    size_t slot;
+    int known = map_find(&g_pages, page, 0, &slot);
+
+    if (known && g_pages.values[slot] == hash)
+    {
+      continue;
+    }
+    if (map_find(&g_pages, page, 1, &slot))
+    {
+      g_pages.values[slot] = hash;
+    }
+    write_record(EVTRACE_PAGE, (uint32_t)present, page, present ? page_buf : NULL);
+  }
+}
+
+/**
+ * @brief Contents of the replayed page at @p page, or NULL (counted if never recorded)
+ */
+static const uint8_t *replay_page(addr_t page)
+{
+  size_t slot;
+
+  if (!map_find(&g_pages, page, 0, &slot))
+  {
+    g_missing++;
+    return NULL;
+  }
+  uint64_t index = g_pages.values[slot];
+  return index ? g_data + (index - 1) * GUEST_PAGE_SIZE : NULL;
+}
+
+status_t evtrace_read(addr_t va, void *buf, size_t len)
+{
+  uint8_t *out = buf;
+
+  while (len > 0)
+  {
+    const uint8_t *page = replay_page(va & GUEST_PAGE_MASK);
+    size_t offset = va & (GUEST_PAGE_SIZE - 1);
+    size_t chunk = GUEST_PAGE_SIZE - offset < len ? GUEST_PAGE_SIZE - offset : len;
+
+    if (!page)
+    {
+      return VMI_FAILURE;
+    }
+    memcpy(out, page + offset, chunk);
+    out += chunk;
+    va += chunk;
+    len -= chunk;
+  }
+  return VMI_SUCCESS;
+}
+
+char *evtrace_read_str(addr_t va)
+{
+  char *str = malloc(STR_MAX);
+  if (!str)
+  {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < STR_MAX; i++)
+  {
+    if (VMI_SUCCESS != evtrace_read(va + i, &str[i], 1))
+    {
+      break;
+    }
+    if (!str[i])
+    {
+      return str;
+    }
+  }
+  free(str);
+  return NULL;
+}
+
+static demo_error_t store_page(addr_t page, int present, FILE *file)
+{
+  size_t slot;
+
+  if (!map_find(&g_pages, page, 1, &slot))
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+  if (!present)
+  {
+    g_pages.values[slot] = 0;
+    return DEMO_SUCCESS;
+  }
+
+  // A page recorded again overwrites its earlier contents
+  if (!g_pages.values[slot])
+  {
+    if (g_data_pages == g_data_capacity)
+    {
+      size_t capacity = g_data_capacity ? g_data_capacity * 2 : 256;
+      uint8_t *data = realloc(g_data, capacity * GUEST_PAGE_SIZE);
+      if (!data)
+      {
+        return DEMO_ERROR_MEMORY;
+      }
+      g_data = data;
+      g_data_capacity = capacity;
+    }
+    g_pages.values[slot] = ++g_data_pages;
+  }
+  uint8_t *dest = g_data + (g_pages.values[slot] - 1) * GUEST_PAGE_SIZE;
+  return (1 == fread(dest, GUEST_PAGE_SIZE, 1, file)) ? DEMO_SUCCESS : DEMO_ERROR_INIT;
+}
+
+/**
+ * @brief Hand one recorded event to the tracker, after the pages read while handling it
+ */
+static void dispatch(ProcessTracker_t *tracker, const EvTraceRecord_t *event)
+{
+  switch (event->type)
+  {
+  case EVTRACE_CR3:
+    proctrack_cr3(tracker, event->value);
+    break;
+  case EVTRACE_REFRESH:
+    proctrack_refresh(tracker);
+    break;
+  case EVTRACE_SWEEP:
+    proctrack_sweep(tracker);
+    printf("Sweep %lu: %zu processes tracked\n", (unsigned long)tracker->epoch, tracker->count);
+    break;
+  }
+}
+
+demo_error_t evtrace_replay(const char *path)
+{
+  EvTraceHeader_t header;
+  FILE *file = fopen(path, "rb");
+
+  if (!file)
+  {
+    printf("ERROR: Cannot open event trace '%s'\n", path);
+    return DEMO_ERROR_INIT;
+  }
+  if (1 != fread(&header, sizeof(header), 1, file) ||
+      0 != memcmp(header.magic, EVTRACE_MAGIC, sizeof(header.magic)) ||
+      header.version != EVTRACE_VERSION || header.page_size != GUEST_PAGE_SIZE)
+  {
+    printf("ERROR: '%s' is not a version %d event trace\n", path, EVTRACE_VERSION);
+    fclose(file);
+    return DEMO_ERROR_INIT;
+  }
+
+  KernelOffsets_t offsets = {
+      .eprocess_tasks = header.eprocess_tasks,
+      .eprocess_pid = header.eprocess_pid,
+      .eprocess_pname = header.eprocess_pname,
+      .eprocess_peb = header.eprocess_peb,
+      .eprocess_threads = header.eprocess_threads,
+      .kprocess_pdbase = header.kprocess_pdbase,
+      .kprocess_user_pdbase = header.kprocess_user_pdbase,
+  };
+  ProcTrackSource_t source;
+  ProcessTracker_t tracker;
+
+  proctrack_live_source(&source, NULL, &offsets, header.list_head);
+  source.changed = proctrack_print_change;
+  proctrack_init(&tracker, &source);
+  g_mode = MODE_REPLAY;
+  g_missing = 0;
+  printf("Replaying %s\n", path);
+
+  EvTraceRecord_t record, pending = {0};
+  uint64_t events = 0, pages = 0;
+  demo_error_t result = DEMO_SUCCESS;
+  double handling_ms = 0;
+
+  while (result == DEMO_SUCCESS)
+  {
+    int more = 1 == fread(&record, sizeof(record), 1, file);
+
+    if (more && record.type == EVTRACE_PAGE)
+    {
+      pages++;
+      result = store_page(record.value, (int)record.flags, file);
+      continue;
+    }
+
+    // Every page of the pending event is loaded: run it
+    if (pending.type)
+    {
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      dispatch(&tracker, &pending);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      handling_ms += (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+      events++;
+    }
+    if (!more)
+    {
+      break;
+    }
+    if (record.type < EVTRACE_CR3 || record.type > EVTRACE_SWEEP)
+    {
+      printf("ERROR: Unknown record type %u in '%s'\n", record.type, path);
+      result = DEMO_ERROR_INIT;
+    }
+    pending = record;
+  }
+
+  if (result == DEMO_ERROR_INIT && !ferror(file) && feof(file))
+  {
+    printf("ERROR: '%s' is truncated\n", path);
+  }
+  else if (result == DEMO_SUCCESS)
+  {
+    const ProcTrackStats_t *stats = &tracker.stats;
+    printf("\nEvents replayed:  %lu (%lu pages, %zu distinct)\n", (unsigned long)events,
+           (unsigned long)pages, g_pages.count);
+    printf("Handling time:    %.3f ms (%.2f µs per event)\n", handling_ms,
+           events ? handling_ms * 1e3 / (double)events : 0.0);
+    printf("CR3 events:       %lu, list walks %lu, link checks %lu\n", (unsigned long)stats->cr3_events,
+           (unsigned long)stats->walks, (unsigned long)stats->checked);
+    printf("Created/exited:   %lu/%lu (%lu within one interval)\n", (unsigned long)stats->created,
+           (unsigned long)stats->exited, (unsigned long)stats->short_lived);
+    if (g_missing)
+    {
+      printf("WARNING: %lu read(s) touched pages the trace never recorded; the analysis diverged from the recording\n",
+             (unsigned long)g_missing);
+    }
+  }
+
+  proctrack_free(&tracker);
+  map_free(&g_pages);
+  free(g_data);
+  g_data = NULL;
+  g_data_pages = g_data_capacity = 0;
+  g_mode = MODE_OFF;
+  fclose(file);
+  return result;
+}
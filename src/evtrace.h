@@ -0,0 +1,96 @@
+/**
+ * @file evtrace.h
+ * @brief Record and replay of guest events with the memory they read
+ *
+ * While recording, every process tracker entry point (CR3 write, list
+ * refresh, sweep) is written to the trace. Each guest page that an
+ * instrumented read touches while handling it is written too, but only
+ * when its contents changed since it was last recorded. Replay feeds the
+ * same events to the tracker. Reads are served from the recorded pages,
+ * so the analysis runs unchanged without a hypervisor, and two replays
+ * of a trace do the same work.
+ *
+ * Trace layout: an EvTraceHeader_t, then EvTraceRecord_t records. A
+ * present PAGE record is followed by the page's GUEST_PAGE_SIZE bytes.
+ * Pages recorded after an event were read while handling that event.
+ */
+
+#ifndef EVTRACE_H
+#define EVTRACE_H
+
+#include "vmi_demo.h"
+#include "symbols.h"
+
+#define EVTRACE_MAGIC "VMIEVTR1"
+#define EVTRACE_VERSION 2
+
+typedef enum
+{
+  EVTRACE_PAGE = 1, // value: page VA, flags: 1 if present
+  EVTRACE_CR3,      // value: CR3
+  EVTRACE_REFRESH,  // full process list walk
+  EVTRACE_SWEEP     // end of a sweep interval
+} evtrace_record_t;
+
+typedef struct EvTraceHeader_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t page_size;
+  uint64_t list_head; // PsActiveProcessHead VA
+  uint64_t eprocess_tasks;
+  uint64_t eprocess_pid;
+  uint64_t eprocess_pname;
+  uint64_t eprocess_peb;
+  uint64_t eprocess_threads;
+  uint64_t kprocess_pdbase;
+  uint64_t kprocess_user_pdbase;
+} EvTraceHeader_t;
+
+typedef struct EvTraceRecord_t
+{
+  uint32_t type;
+  uint32_t flags;
+  uint64_t value;
+} EvTraceRecord_t;
+
+/**
+ * @brief Start writing a trace to @p path
+ */
+demo_error_t evtrace_record_start(const char *path, const KernelOffsets_t *offsets, addr_t list_head);
+
+void evtrace_record_stop(void);
+
+int evtrace_replaying(void);
+
+/**
+ * @brief Record an event; reads until evtrace_event_end() are captured with it
+ *
+ * A no-op unless recording.
+ */
+void evtrace_event(evtrace_record_t type, addr_t value);
+void evtrace_event_end(void);
+
+/**
+ * @brief Record the pages under [@p va, @p va + @p len) if they changed
+ *
+ * A no-op unless recording and inside an event.
+ */
+void evtrace_capture(vmi_instance_t vmi, addr_t va, size_t len);
+
+/**
+ * @brief Serve a read from the replayed pages
+ */
+status_t evtrace_read(addr_t va, void *buf, size_t len);
+
+/**
+ * @brief Serve a NUL-terminated string from the replayed pages; the caller frees it
+ */
+char *evtrace_read_str(addr_t va);
+
+/**
+ * @brief Replay @p path through the process tracker and report timing
+ */
+demo_error_t evtrace_replay(const char *path);
+
+#endif // EVTRACE_H
@@ -0,0 +1,268 @@
+/**
+ * @file integrity.c
+ * @brief Incremental code-integrity hashing of loaded kernel drivers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "integrity.h"
+#include "pe.h"
+#include "output.h"
+
+void integrity_init(IntegrityCache_t *cache, size_t page_budget)
+{
+  memset(cache, 0, sizeof(*cache));
+  cache->page_budget = page_budget ? page_budget : INTEGRITY_DEFAULT_PAGE_BUDGET;
+}
+
+/**
+ * @brief Collect the resident code pages of a driver from its PE header
+ */
+static void baseline_driver(vmi_instance_t vmi, DriverBaseline_t *driver)
+{
+  uint8_t header[GUEST_PAGE_SIZE];
+  PeSection_t sections[PE_MAX_SECTIONS];
+  size_t page_count = 0;
+  addr_t last_va = 0;
+
+  if (VMI_FAILURE == vmi_read_va(vmi, driver->base, 0, sizeof(header), header, NULL))
+  {
+    return;
+  }
+
+  int section_count = pe_parse_sections(header, sizeof(header), sections, PE_MAX_SECTIONS);
+  if (section_count <= 0)
+  {
+    return;
+  }
+
+  for (int i = 0; i < section_count; i++)
+  {
+    if (pe_section_is_code(&sections[i]))
+    {
+      page_count += (sections[i].size + 2 * GUEST_PAGE_SIZE - 1) / GUEST_PAGE_SIZE;
+    }
+  }
+  if (!page_count || !(driver->pages = calloc(page_count, sizeof(*driver->pages))))
+  {
+    return;
+  }
+
+  // Small drivers may pack several sections into one page; record it once
+  for (int i = 0; i < section_count; i++)
+  {
+    if (!pe_section_is_code(&sections[i]) || sections[i].rva >= driver->size)
+    {
+      continue;
+    }
+
+    addr_t start = (driver->base + sections[i].rva) & GUEST_PAGE_MASK;
+    addr_t end = driver->base + sections[i].rva + sections[i].size;
+    for (addr_t va = start; va < end; va += GUEST_PAGE_SIZE)
+    {
+      if (va != last_va)
+      {
+        driver->pages[driver->page_count++].va = va;
+        last_va = va;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Read and hash one page through its cached frame
+ */
+static void hash_page(vmi_instance_t vmi, IntegrityCache_t *cache, const DriverBaseline_t *driver,
+                      PageFingerprint_t *page, IntegrityStats_t *stats)
+{
+  uint8_t data[GUEST_PAGE_SIZE];
+
+  if (VMI_FAILURE == vmi_read_pa(vmi, page->pa, sizeof(data), data, NULL))
+  {
+    page->pa = 0;
+    stats->pages_not_resident++;
+    return;
+  }
+
+  uint64_t previous = page->current;
+  page->current = XXH3_64bits(data, sizeof(data));
+  page->checked = cache->sweep;
+  stats->pages_hashed++;
+
+  if (!page->has_baseline)
+  {
+    page->baseline = page->current;
+    page->has_baseline = 1;
+    return;
+  }
+
+  if (page->current != previous)
+  {
+    stats->pages_changed++;
+  }
+  if (page->current != page->baseline)
+  {
+    stats->pages_modified++;
+    output_text("  [!] %s+0x%lx modified (frame 0x%lx, hash %016lx, baseline %016lx)\n",
+           driver->name, page->va - driver->base, page->pa,
+           (unsigned long)page->current, (unsigned long)page->baseline);
+  }
+}
+
+/**
+ * @brief Match the module list against cached baselines
+ */
+static demo_error_t reconcile_drivers(vmi_instance_t vmi, IntegrityCache_t *cache,
+                                      const KernelModuleList_t *modules, IntegrityStats_t *stats)
+{
+  for (size_t m = 0; m < modules->count; m++)
+  {
+    const KernelModule_t *module = &modules->modules[m];
+    DriverBaseline_t *driver = NULL;
+
+    for (size_t d = 0; d < cache->count; d++)
+    {
+      if (cache->drivers[d].base == module->base && cache->drivers[d].size == module->size &&
+          0 == strcmp(cache->drivers[d].name, module->name))
+      {
+        driver = &cache->drivers[d];
+        break;
+      }
+    }
+
+    if (!driver)
+    {
+      if (cache->count == cache->capacity)
+      {
+        size_t capacity = cache->capacity ? cache->capacity * 2 : 128;
+        DriverBaseline_t *grown = realloc(cache->drivers, capacity * sizeof(*grown));
+        if (!grown)
+        {
+          return DEMO_ERROR_MEMORY;
+        }
+        cache->drivers = grown;
+        cache->capacity = capacity;
+      }
+
+      driver = &cache->drivers[cache->count++];
+      memset(driver, 0, sizeof(*driver));
+      driver->base = module->base;
+      driver->size = module->size;
+      memcpy(driver->name, module->name, sizeof(driver->name));
+      stats->drivers_added++;
+    }
+
+    // Headers can be paged out at first sight; retry until we get them
+    if (!driver->pages)
+    {
+      baseline_driver(vmi, driver);
+    }
+    driver->seen = cache->sweep;
+  }
+
+  for (size_t d = 0; d < cache->count;)
+  {
+    if (cache->drivers[d].seen == cache->sweep)
+    {
+      d++;
+      continue;
+    }
+
+    free(cache->drivers[d].pages);
+    cache->drivers[d] = cache->drivers[--cache->count];
+    stats->drivers_removed++;
+  }
+
+  if (cache->cursor_driver >= cache->count)
+  {
+    cache->cursor_driver = 0;
+    cache->cursor_page = 0;
+  }
+  return DEMO_SUCCESS;
+}
+
+demo_error_t integrity_sweep(vmi_instance_t vmi, IntegrityCache_t *cache,
+                             const KernelModuleList_t *modules, IntegrityStats_t *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+  cache->sweep++;
+
+  demo_error_t result = reconcile_drivers(vmi, cache, modules, stats);
+  if (result != DEMO_SUCCESS)
+  {
+    return result;
+  }
+
+  // Stale cached translations would hide a remapped page
+  vmi_v2pcache_flush(vmi, ~0ULL);
+
+  // Pass 1: rehash only pages whose backing frame changed
+  for (size_t d = 0; d < cache->count; d++)
+  {
+    DriverBaseline_t *driver = &cache->drivers[d];
+    stats->pages += driver->page_count;
+
+    for (size_t p = 0; p < driver->page_count; p++)
+    {
+      PageFingerprint_t *page = &driver->pages[p];
+      addr_t pa = 0;
+
+      if (VMI_FAILURE == vmi_translate_kv2p(vmi, page->va, &pa))
+      {
+        page->pa = 0;
+        stats->pages_not_resident++;
+        continue;
+      }
+
+      if (pa != page->pa)
+      {
+        if (page->pa)
+        {
+          stats->frames_moved++;
+        }
+        page->pa = pa;
+        hash_page(vmi, cache, driver, page, stats);
+      }
+    }
+  }
+  stats->drivers = cache->count;
+
+  // Pass 2: round-robin rechecks catch in-place writes to unmoved frames
+  size_t budget = cache->page_budget;
+  size_t visited = 0;
+  while (budget && visited < stats->pages)
+  {
+    DriverBaseline_t *driver = &cache->drivers[cache->cursor_driver];
+    if (cache->cursor_page >= driver->page_count)
+    {
+      cache->cursor_page = 0;
+      cache->cursor_driver = (cache->cursor_driver + 1) % cache->count;
+      continue;
+    }
+
+    PageFingerprint_t *page = &driver->pages[cache->cursor_page++];
+    visited++;
+    if (page->pa && page->checked != cache->sweep)
+    {
+      hash_page(vmi, cache, driver, page, stats);
+      budget--;
+    }
+  }
+
+  return DEMO_SUCCESS;
+}
+
+void integrity_free(IntegrityCache_t *cache)
+{
+  for (size_t d = 0; d < cache->count; d++)
+  {
+    free(cache->drivers[d].pages);
+  }
+  free(cache->drivers);
+  memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,85 @@
+/**
+ * @file integrity.h
+ * @brief Incremental code-integrity hashing of loaded kernel drivers
+ *
+ * Every resident executable page of every driver is hashed once into a
+ * baseline. Later sweeps only re-read a page when its physical frame has
+ * changed, plus a fixed budget of round-robin rechecks, so each page is
+ * still re-verified periodically without rehashing the whole kernel.
+ */
+
+#ifndef INTEGRITY_H
+#define INTEGRITY_H
+
+#include <stddef.h>
+#include "kmodules.h"
+
+#define INTEGRITY_DEFAULT_PAGE_BUDGET 256
+
+// Per-page fingerprint cache entry
+typedef struct PageFingerprint_t
+{
+  addr_t va;
+  addr_t pa;         // frame that backed the page when last hashed, 0 if not resident
+  uint64_t baseline; // first hash taken of this page
+  uint64_t current;  // most recent hash
+  uint32_t checked;  // sweep number of the most recent hash
+  uint8_t has_baseline;
+} PageFingerprint_t;
+
+// Baseline for one driver image
+typedef struct DriverBaseline_t
+{
+  addr_t base;
+  uint32_t size;
+  char name[MAX_MODULE_NAME];
+  PageFingerprint_t *pages;
+  size_t page_count;
+  uint32_t seen; // last sweep the driver was present in the module list
+} DriverBaseline_t;
+
+typedef struct IntegrityCache_t
+{
+  DriverBaseline_t *drivers;
+  size_t count;
+  size_t capacity;
+  uint32_t sweep;
+  size_t page_budget; // round-robin rehashes per sweep for unmoved frames
+  size_t cursor_driver;
+  size_t cursor_page;
+} IntegrityCache_t;
+
+// Results of a single sweep
+typedef struct IntegrityStats_t
+{
+  size_t drivers;
+  size_t drivers_added;
+  size_t drivers_removed;
+  size_t pages;
+  size_t pages_hashed;
+  size_t frames_moved;
+  size_t pages_not_resident;
+  size_t pages_modified; // differ from their baseline (a lasting patch counts every sweep)
+  size_t pages_changed;  // differ from their previous hash (new patches and reverts only)
+} IntegrityStats_t;
+
+/**
+ * @brief Prepare an empty cache; @p page_budget of 0 selects the default
+ */
+void integrity_init(IntegrityCache_t *cache, size_t page_budget);
+
+/**
+ * @brief Verify drivers in @p modules against their baselines
+ *
+ * Drivers seen for the first time are baselined, drivers that disappeared
+ * are dropped. Modified pages are reported on stdout as they are found.
+ */
+demo_error_t integrity_sweep(vmi_instance_t vmi, IntegrityCache_t *cache,
+                             const KernelModuleList_t *modules, IntegrityStats_t *stats);
+
+/**
+ * @brief Release all baselines held by @p cache
+ */
+void integrity_free(IntegrityCache_t *cache);
+
+#endif // INTEGRITY_H
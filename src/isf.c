@@ -0,0 +1,578 @@
+/**
+ * @file isf.c
+ * @brief Streaming loader for Volatility3 ISF symbol files (.json / .json.xz)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lzma.h>
+
+#include "isf.h"
+
+#define ISF_IN_SIZE (64 * 1024)
+#define ISF_BUF_SIZE (256 * 1024)
+#define ISF_MAX_KEY 128
+
+static const uint8_t g_xz_magic[6] = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+
+// Refillable window over the (decompressed) JSON text
+typedef struct IsfReader_t
+{
+  FILE *file;
+  int xz;
+  int input_done;
+  int stream_end;
+  lzma_stream lz;
+  size_t pos;
+  size_t len;
+  size_t consumed;
+  uint8_t in[ISF_IN_SIZE];
+  uint8_t buf[ISF_BUF_SIZE];
+} IsfReader_t;
+
+/**
+ * @brief Fetch the next block of JSON text; returns 0 at end of input or on error
+ */
+static int refill(IsfReader_t *r)
+{
+  r->consumed += r->len;
+  r->pos = 0;
+  r->len = 0;
+
+  if (!r->xz)
+  {
+    r->len = fread(r->buf, 1, sizeof(r->buf), r->file);
+    return r->len > 0;
+  }
+  if (r->stream_end)
+  {
+    return 0;
+  }
+
+  r->lz.next_out = r->buf;
+  r->lz.avail_out = sizeof(r->buf);
+
+  while (r->lz.avail_out == sizeof(r->buf))
+  {
+    if (r->lz.avail_in == 0 && !r->input_done)
+    {
+      r->lz.next_in = r->in;
+      r->lz.avail_in = fread(r->in, 1, sizeof(r->in), r->file);
+      r->input_done = r->lz.avail_in == 0;
+    }
+
+    lzma_ret ret = lzma_code(&r->lz, r->input_done ? LZMA_FINISH : LZMA_RUN);
+    if (ret == LZMA_STREAM_END)
+    {
+      r->stream_end = 1;
+      break;
+    }
+    if (ret != LZMA_OK)
+    {
+      return 0;
+    }
+  }
+
+  r->len = sizeof(r->buf) - r->lz.avail_out;
+  return r->len > 0;
+}
+
+static inline int peek(IsfReader_t *r)
+{
+  if (r->pos == r->len && !refill(r))
+  {
+    return -1;
+  }
+  return r->buf[r->pos];
+}
+
+static inline int skip_ws(IsfReader_t *r)
+{
+  int c;
+  while ((c = peek(r)) == ' ' || c == '\n' || c == '\r' || c == '\t')
+  {
+    r->pos++;
+  }
+  return c;
+}
+
+static int expect(IsfReader_t *r, int want)
+{
+  if (skip_ws(r) != want)
+  {
+    return -1;
+  }
+  r->pos++;
+  return 0;
+}
+
+/**
+ * @brief Skip the rest of a string whose opening quote was consumed
+ */
+static int skip_string_body(IsfReader_t *r)
+{
+  for (;;)
+  {
+    if (r->pos == r->len && !refill(r))
+    {
+      return -1;
+    }
+
+    const uint8_t *p = r->buf + r->pos;
+    const uint8_t *end = r->buf + r->len;
+    while (p < end && *p != '"' && *p != '\\')
+    {
+      p++;
+    }
+    r->pos = (size_t)(p - r->buf);
+
+    if (p == end)
+    {
+      continue;
+    }
+    r->pos++;
+    if (*p == '"')
+    {
+      return 0;
+    }
+    // Escaped character: skip it whatever it is
+    if (peek(r) < 0)
+    {
+      return -1;
+    }
+    r->pos++;
+  }
+}
+
+/**
+ * @brief Read a string into @p out; overlong strings are truncated and flagged
+ * @return Length, ISF_MAX_KEY when truncated, or -1 on error
+ */
+static int read_string(IsfReader_t *r, char *out)
+{
+  size_t n = 0;
+  int truncated = 0;
+
+  if (expect(r, '"'))
+  {
+    return -1;
+  }
+
+  for (;;)
+  {
+    int c = peek(r);
+    if (c < 0)
+    {
+      return -1;
+    }
+    r->pos++;
+    if (c == '"')
+    {
+      break;
+    }
+    if (c == '\\')
+    {
+      // Symbol and type names are plain ASCII; keep escapes verbatim
+      c = peek(r);
+      if (c < 0)
+      {
+        return -1;
+      }
+      r->pos++;
+    }
+    if (n < ISF_MAX_KEY - 1)
+    {
+      out[n++] = (char)c;
+    }
+    else
+    {
+      truncated = 1;
+    }
+  }
+
+  out[n] = '\0';
+  return truncated ? ISF_MAX_KEY : (int)n;
+}
+
+static int read_int(IsfReader_t *r, int64_t *out)
+{
+  int negative = 0;
+  uint64_t value = 0;
+  int digits = 0;
+  int c = skip_ws(r);
+
+  if (c == '-')
+  {
+    negative = 1;
+    r->pos++;
+  }
+  while ((c = peek(r)) >= '0' && c <= '9')
+  {
+    value = value * 10 + (uint64_t)(c - '0');
+    r->pos++;
+    digits++;
+  }
+  *out = negative ? -(int64_t)value : (int64_t)value;
+  return digits ? 0 : -1;
+}
+
+/**
+ * @brief Skip any JSON value without interpreting it
+ */
+static int skip_value(IsfReader_t *r)
+{
+  int c = skip_ws(r);
+  if (c < 0)
+  {
+    return -1;
+  }
+
+  if (c == '"')
+  {
+    r->pos++;
+    return skip_string_body(r);
+  }
+
+  if (c != '{' && c != '[')
+  {
+    // Number or literal: runs until a delimiter
+    while ((c = peek(r)) >= 0 && c != ',' && c != '}' && c != ']' &&
+           c != ' ' && c != '\n' && c != '\r' && c != '\t')
+    {
+      r->pos++;
+    }
+    return 0;
+  }
+
+  size_t depth = 0;
+  for (;;)
+  {
+    if (r->pos == r->len && !refill(r))
+    {
+      return -1;
+    }
+
+    const uint8_t *p = r->buf + r->pos;
+    const uint8_t *end = r->buf + r->len;
+    for (; p < end; p++)
+    {
+      c = *p;
+      if (c == '"')
+      {
+        r->pos = (size_t)(p - r->buf) + 1;
+        if (skip_string_body(r))
+        {
+          return -1;
+        }
+        goto rescan;
+      }
+      if (c == '{' || c == '[')
+      {
+        depth++;
+      }
+      else if (c == '}' || c == ']')
+      {
+        if (--depth == 0)
+        {
+          r->pos = (size_t)(p - r->buf) + 1;
+          return 0;
+        }
+      }
+    }
+    r->pos = r->len;
+  rescan:;
+  }
+}
+
+/**
+ * @brief Handler for one member of an object; must consume the value
+ */
+typedef int (*member_fn)(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx);
+
+/**
+ * @brief Iterate the members of an object, stopping early when @p done says so
+ */
+static int for_each_member(IsfReader_t *r, member_fn handler, IsfRequest_t *request,
+                           const void *ctx, int (*done)(const IsfRequest_t *))
+{
+  char key[ISF_MAX_KEY];
+
+  if (expect(r, '{'))
+  {
+    return -1;
+  }
+  if (skip_ws(r) == '}')
+  {
+    r->pos++;
+    return 0;
+  }
+
+  for (;;)
+  {
+    if (read_string(r, key) < 0 || expect(r, ':') || handler(r, key, request, ctx))
+    {
+      return -1;
+    }
+    if (done && done(request))
+    {
+      return 1;
+    }
+
+    int c = skip_ws(r);
+    r->pos++;
+    if (c == '}')
+    {
+      return 0;
+    }
+    if (c != ',')
+    {
+      return -1;
+    }
+  }
+}
+
+static int field_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  IsfField_t *field = (IsfField_t *)ctx;
+  (void)request;
+
+  if (0 == strcmp(key, "offset") && 0 == read_int(r, &field->value))
+  {
+    field->found = 1;
+    return 0;
+  }
+  return skip_value(r);
+}
+
+static int fields_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  const char *type = ctx;
+
+  for (size_t i = 0; i < request->field_count; i++)
+  {
+    IsfField_t *field = &request->fields[i];
+    if (field->field && !field->found && 0 == strcmp(field->type, type) &&
+        0 == strcmp(field->field, key))
+    {
+      return for_each_member(r, field_member, request, field, NULL) < 0 ? -1 : 0;
+    }
+  }
+  return skip_value(r);
+}
+
+static int type_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  const char *type = ctx;
+
+  if (0 == strcmp(key, "fields"))
+  {
+    return for_each_member(r, fields_member, request, type, NULL) < 0 ? -1 : 0;
+  }
+
+  if (0 == strcmp(key, "size"))
+  {
+    int64_t size = 0;
+    if (read_int(r, &size))
+    {
+      return -1;
+    }
+    for (size_t i = 0; i < request->field_count; i++)
+    {
+      IsfField_t *field = &request->fields[i];
+      if (!field->field && 0 == strcmp(field->type, type))
+      {
+        field->value = size;
+        field->found = 1;
+      }
+    }
+    return 0;
+  }
+  return skip_value(r);
+}
+
+static int user_types_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  (void)ctx;
+  for (size_t i = 0; i < request->field_count; i++)
+  {
+    if (0 == strcmp(request->fields[i].type, key))
+    {
+      return for_each_member(r, type_member, request, key, NULL) < 0 ? -1 : 0;
+    }
+  }
+  return skip_value(r);
+}
+
+static int symbol_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  IsfSymbol_t *symbol = (IsfSymbol_t *)ctx;
+  int64_t address = 0;
+  (void)request;
+
+  if (0 == strcmp(key, "address") && 0 == read_int(r, &address))
+  {
+    symbol->address = (uint64_t)address;
+    symbol->found = 1;
+    return 0;
+  }
+  return skip_value(r);
+}
+
+static int symbols_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  (void)ctx;
+  for (size_t i = 0; i < request->symbol_count; i++)
+  {
+    IsfSymbol_t *symbol = &request->symbols[i];
+    if (!symbol->found && 0 == strcmp(symbol->name, key))
+    {
+      return for_each_member(r, symbol_member, request, symbol, NULL) < 0 ? -1 : 0;
+    }
+  }
+  return skip_value(r);
+}
+
+static int pdb_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  char value[ISF_MAX_KEY];
+  (void)ctx;
+
+  if (0 == strcmp(key, "GUID"))
+  {
+    if (read_string(r, value) < 0)
+    {
+      return -1;
+    }
+    size_t len = strlen(value);
+    if (len >= sizeof(request->pdb_guid))
+    {
+      len = sizeof(request->pdb_guid) - 1;
+    }
+    memcpy(request->pdb_guid, value, len);
+    request->pdb_guid[len] = '\0';
+    return 0;
+  }
+  if (0 == strcmp(key, "age"))
+  {
+    int64_t age = 0;
+    if (read_int(r, &age))
+    {
+      return -1;
+    }
+    request->pdb_age = (uint32_t)age;
+    return 0;
+  }
+  return skip_value(r);
+}
+
+static int windows_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  if (0 == strcmp(key, "pdb"))
+  {
+    return for_each_member(r, pdb_member, request, ctx, NULL) < 0 ? -1 : 0;
+  }
+  return skip_value(r);
+}
+
+static int metadata_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  if (0 == strcmp(key, "windows"))
+  {
+    return for_each_member(r, windows_member, request, ctx, NULL) < 0 ? -1 : 0;
+  }
+  return skip_value(r);
+}
+
+static int top_member(IsfReader_t *r, const char *key, IsfRequest_t *request, const void *ctx)
+{
+  if (0 == strcmp(key, "user_types"))
+  {
+    return for_each_member(r, user_types_member, request, ctx, NULL) < 0 ? -1 : 0;
+  }
+  if (0 == strcmp(key, "symbols"))
+  {
+    return for_each_member(r, symbols_member, request, ctx, NULL) < 0 ? -1 : 0;
+  }
+  if (0 == strcmp(key, "metadata"))
+  {
+    return for_each_member(r, metadata_member, request, ctx, NULL) < 0 ? -1 : 0;
+  }
+  return skip_value(r);
+}
+
+/**
+ * @brief True once every request and the PDB identity have been found
+ */
+static int request_complete(const IsfRequest_t *request)
+{
+  if (!request->pdb_guid[0])
+  {
+    return 0;
+  }
+  for (size_t i = 0; i < request->field_count; i++)
+  {
+    if (!request->fields[i].found)
+    {
+      return 0;
+    }
+  }
+  for (size_t i = 0; i < request->symbol_count; i++)
+  {
+    if (!request->symbols[i].found)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+demo_error_t isf_load(const char *path, IsfRequest_t *request)
+{
+  demo_error_t result = DEMO_SUCCESS;
+  uint8_t magic[sizeof(g_xz_magic)];
+
+  IsfReader_t *r = calloc(1, sizeof(*r));
+  if (!r)
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+
+  r->file = fopen(path, "rb");
+  if (!r->file)
+  {
+    free(r);
+    return DEMO_ERROR_INIT;
+  }
+
+  // Accept both compressed and plain JSON
+  r->xz = fread(magic, 1, sizeof(magic), r->file) == sizeof(magic) &&
+          0 == memcmp(magic, g_xz_magic, sizeof(magic));
+  rewind(r->file);
+
+  if (r->xz)
+  {
+    lzma_stream init = LZMA_STREAM_INIT;
+    r->lz = init;
+    if (LZMA_OK != lzma_stream_decoder(&r->lz, UINT64_MAX, 0))
+    {
+      result = DEMO_ERROR_INIT;
+      goto done;
+    }
+  }
+
+  if (for_each_member(r, top_member, request, NULL, request_complete) < 0)
+  {
+    result = DEMO_ERROR_INIT;
+  }
+
+done:
+  request->bytes_parsed = r->consumed + r->pos;
+  if (r->xz)
+  {
+    lzma_end(&r->lz);
+  }
+  fclose(r->file);
+  free(r);
+  return result;
+}
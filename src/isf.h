@@ -0,0 +1,56 @@
+/**
+ * @file isf.h
+ * @brief Streaming loader for Volatility3 ISF symbol files (.json / .json.xz)
+ *
+ * The caller lists the struct fields, struct sizes and symbols it needs;
+ * the file is then decompressed and tokenized in a single forward pass
+ * without building a document tree. Anything not requested is skipped at
+ * scanning speed, and the pass stops as soon as every request is satisfied.
+ */
+
+#ifndef ISF_H
+#define ISF_H
+
+#include <stddef.h>
+#include "vmi_demo.h"
+
+#define ISF_GUID_LEN 33
+
+// Requested struct member offset, or struct size when @ref field is NULL
+typedef struct IsfField_t
+{
+  const char *type;  // e.g. "_EPROCESS"
+  const char *field; // e.g. "ActiveProcessLinks", NULL for the struct size
+  int64_t value;
+  uint8_t found;
+} IsfField_t;
+
+// Requested symbol; @ref address is relative to the image base
+typedef struct IsfSymbol_t
+{
+  const char *name;
+  uint64_t address;
+  uint8_t found;
+} IsfSymbol_t;
+
+typedef struct IsfRequest_t
+{
+  IsfField_t *fields;
+  size_t field_count;
+  IsfSymbol_t *symbols;
+  size_t symbol_count;
+
+  // Filled from metadata.windows.pdb
+  char pdb_guid[ISF_GUID_LEN];
+  uint32_t pdb_age;
+
+  size_t bytes_parsed; // decompressed JSON bytes consumed
+} IsfRequest_t;
+
+/**
+ * @brief Stream @p path once and fill every request it can satisfy
+ * @return DEMO_SUCCESS if the file parsed, even when some requests were not found
+ */
+demo_error_t isf_load(const char *path, IsfRequest_t *request);
+
+#endif // ISF_H
@@ -0,0 +1,279 @@
+/**
+ * @file jsonl.c
+ * @brief JSON Lines record writer with a preallocated output buffer
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "jsonl.h"
+
+// Largest single append outside of string bodies: a 20-digit integer plus punctuation
+#define JSONL_MIN_BUFFER 256
+#define JSONL_SLACK 32
+
+static const char g_hex_digits[] = "0123456789abcdef";
+
+static void write_all(JsonlWriter_t *writer, const char *data, size_t len)
+{
+  while (len > 0 && !writer->failed)
+  {
+    ssize_t written = write(writer->fd, data, len);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      writer->failed = 1;
+      return;
+    }
+    data += written;
+    len -= (size_t)written;
+  }
+}
+
+static inline void reserve(JsonlWriter_t *writer, size_t needed)
+{
+  if (writer->capacity - writer->len < needed)
+  {
+    jsonl_flush(writer);
+  }
+}
+
+static inline void put_char(JsonlWriter_t *writer, char c)
+{
+  writer->buf[writer->len++] = c;
+}
+
+/**
+ * @brief Length of the well-formed UTF-8 sequence at @p p, 0 if there is none
+ *
+ * Follows RFC 3629: the second byte's range depends on the lead byte, which
+ * rules out overlong forms (C0, C1, E0 80-9F, F0 80-8F), surrogates
+ * (ED A0-BF) and code points above U+10FFFF (F4 90-BF, F5-FF).
+ */
+static size_t utf8_sequence(const unsigned char *p)
+{
+  size_t n = 0;
+  unsigned char low = 0x80, high = 0xbf;
+
+  if (p[0] >= 0xc2 && p[0] <= 0xdf)
+  {
+    n = 2;
+  }
+  else if (p[0] >= 0xe0 && p[0] <= 0xef)
+  {
+    n = 3;
+    low = (p[0] == 0xe0) ? 0xa0 : low;
+    high = (p[0] == 0xed) ? 0x9f : high;
+  }
+  else if (p[0] >= 0xf0 && p[0] <= 0xf4)
+  {
+    n = 4;
+    low = (p[0] == 0xf0) ? 0x90 : low;
+    high = (p[0] == 0xf4) ? 0x8f : high;
+  }
+
+  if (n && (p[1] < low || p[1] > high))
+  {
+    return 0;
+  }
+  for (size_t i = 2; i < n; i++)
+  {
+    if ((p[i] & 0xc0) != 0x80)
+    {
+      return 0;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief Append a quoted, escaped string
+ *
+ * Guest strings are raw bytes. Well-formed UTF-8 sequences (transcoded
+ * UTF-16) pass through; any other byte outside printable ASCII is written
+ * as \u00XX so every record stays valid JSON.
+ */
+static void put_string(JsonlWriter_t *writer, const char *value)
+{
+  reserve(writer, JSONL_SLACK);
+  put_char(writer, '"');
+
+  for (const unsigned char *p = (const unsigned char *)value; *p; p++)
+  {
+    reserve(writer, JSONL_SLACK);
+    unsigned char c = *p;
+    size_t n;
+
+    if (c == '"' || c == '\\')
+    {
+      put_char(writer, '\\');
+      put_char(writer, (char)c);
+    }
+    else if (c >= 0x20 && c < 0x7f)
+    {
+      put_char(writer, (char)c);
+    }
+    else if (c >= 0x80 && (n = utf8_sequence(p)))
+    {
+      for (; n; n--)
+      {
+        put_char(writer, (char)*p++);
+      }
+      p--;
+    }
+    else
+    {
+      memcpy(writer->buf + writer->len, "\\u00", 4);
+      writer->len += 4;
+      put_char(writer, g_hex_digits[c >> 4]);
+      put_char(writer, g_hex_digits[c & 0xf]);
+    }
+  }
+  put_char(writer, '"');
+}
+
+static void put_key(JsonlWriter_t *writer, const char *key)
+{
+  reserve(writer, JSONL_SLACK);
+  if (writer->fields++)
+  {
+    put_char(writer, ',');
+  }
+  put_string(writer, key);
+  put_char(writer, ':');
+}
+
+static void put_decimal(JsonlWriter_t *writer, uint64_t value)
+{
+  char digits[20];
+  size_t n = 0;
+
+  do
+  {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+
+  reserve(writer, JSONL_SLACK);
+  while (n)
+  {
+    put_char(writer, digits[--n]);
+  }
+}
+
+int jsonl_init(JsonlWriter_t *writer, int fd, size_t capacity)
+{
+  memset(writer, 0, sizeof(*writer));
+  writer->fd = fd;
+  writer->capacity = (capacity < JSONL_MIN_BUFFER) ? JSONL_MIN_BUFFER : capacity;
+  writer->buf = malloc(writer->capacity);
+  return writer->buf ? 0 : -1;
+}
+
+void jsonl_begin(JsonlWriter_t *writer, const char *type)
+{
+  reserve(writer, JSONL_SLACK);
+  put_char(writer, '{');
+  writer->fields = 0;
+  jsonl_str(writer, "type", type);
+}
+
+void jsonl_str(JsonlWriter_t *writer, const char *key, const char *value)
+{
+  put_key(writer, key);
+  put_string(writer, value ? value : "");
+}
+
+void jsonl_str_list(JsonlWriter_t *writer, const char *key, const char *entries, size_t len)
+{
+  put_key(writer, key);
+  reserve(writer, JSONL_SLACK);
+  put_char(writer, '[');
+  for (size_t off = 0; off < len; off += strlen(entries + off) + 1)
+  {
+    if (off)
+    {
+      reserve(writer, JSONL_SLACK);
+      put_char(writer, ',');
+    }
+    put_string(writer, entries + off);
+  }
+  reserve(writer, JSONL_SLACK);
+  put_char(writer, ']');
+}
+
+void jsonl_u64(JsonlWriter_t *writer, const char *key, uint64_t value)
+{
+  put_key(writer, key);
+  put_decimal(writer, value);
+}
+
+void jsonl_i64(JsonlWriter_t *writer, const char *key, int64_t value)
+{
+  put_key(writer, key);
+  if (value < 0)
+  {
+    put_char(writer, '-');
+    put_decimal(writer, (uint64_t)0 - (uint64_t)value);
+  }
+  else
+  {
+    put_decimal(writer, (uint64_t)value);
+  }
+}
+
+void jsonl_hex(JsonlWriter_t *writer, const char *key, uint64_t value)
+{
+  char digits[16];
+  size_t n = 0;
+
+  do
+  {
+    digits[n++] = g_hex_digits[value & 0xf];
+    value >>= 4;
+  } while (value);
+
+  put_key(writer, key);
+  reserve(writer, JSONL_SLACK);
+  memcpy(writer->buf + writer->len, "\"0x", 3);
+  writer->len += 3;
+  while (n)
+  {
+    put_char(writer, digits[--n]);
+  }
+  put_char(writer, '"');
+}
+
+void jsonl_end(JsonlWriter_t *writer)
+{
+  reserve(writer, JSONL_SLACK);
+  put_char(writer, '}');
+  put_char(writer, '\n');
+
+  // Keep whole blocks going out; a partial buffer waits for the next record
+  if (writer->len >= writer->capacity - writer->capacity / 4)
+  {
+    jsonl_flush(writer);
+  }
+}
+
+void jsonl_flush(JsonlWriter_t *writer)
+{
+  write_all(writer, writer->buf, writer->len);
+  writer->len = 0;
+}
+
+void jsonl_free(JsonlWriter_t *writer)
+{
+  if (writer->buf)
+  {
+    jsonl_flush(writer);
+    free(writer->buf);
+    writer->buf = NULL;
+  }
+}
@@ -0,0 +1,68 @@
+/**
+ * @file jsonl.h
+ * @brief JSON Lines record writer with a preallocated output buffer
+ *
+ * Records are serialized straight into one reusable buffer by a small
+ * hand-written escaper and integer formatter, and the buffer is written
+ * to the file descriptor in large blocks rather than once per record.
+ */
+
+#ifndef JSONL_H
+#define JSONL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSONL_DEFAULT_BUFFER (64 * 1024)
+
+typedef struct JsonlWriter_t
+{
+  int fd;
+  char *buf;
+  size_t len;
+  size_t capacity;
+  int fields; // fields written to the open record
+  int failed; // a write to fd failed; further output is dropped
+} JsonlWriter_t;
+
+/**
+ * @brief Allocate the buffer; records are written to @p fd
+ * @return 0 on success, -1 on allocation failure
+ */
+int jsonl_init(JsonlWriter_t *writer, int fd, size_t capacity);
+
+/**
+ * @brief Start a record: {"type":"<type>"
+ */
+void jsonl_begin(JsonlWriter_t *writer, const char *type);
+
+void jsonl_str(JsonlWriter_t *writer, const char *key, const char *value);
+
+/**
+ * @brief Array of strings from @p len bytes of NUL-terminated entries
+ */
+void jsonl_str_list(JsonlWriter_t *writer, const char *key, const char *entries, size_t len);
+void jsonl_u64(JsonlWriter_t *writer, const char *key, uint64_t value);
+void jsonl_i64(JsonlWriter_t *writer, const char *key, int64_t value);
+
+/**
+ * @brief Address as a "0x..." string (JSON numbers lose precision above 2^53)
+ */
+void jsonl_hex(JsonlWriter_t *writer, const char *key, uint64_t value);
+
+/**
+ * @brief Close the record; flushes once the buffer is mostly full
+ */
+void jsonl_end(JsonlWriter_t *writer);
+
+/**
+ * @brief Write out everything buffered
+ */
+void jsonl_flush(JsonlWriter_t *writer);
+
+/**
+ * @brief Flush and release the buffer
+ */
+void jsonl_free(JsonlWriter_t *writer);
+
+#endif // JSONL_H
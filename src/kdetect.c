@@ -0,0 +1,158 @@
+/**
+ * @file kdetect.c
+ * @brief Locate the Windows kernel image in guest physical memory
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "kdetect.h"
+
+// Physical memory is read in large chunks; only page starts are inspected
+#define SCAN_CHUNK (2 * 1024 * 1024)
+
+// KUSER_SHARED_DATA: kernel and user mappings of the same page
+#define KUSER_SHARED_DATA_KERNEL 0xfffff78000000000ull
+#define KUSER_SHARED_DATA_USER 0x7ffe0000ull
+#define KUSER_NT_BUILD_NUMBER 0x260 // Windows 10 and later
+#define KUSER_NT_MAJOR_VERSION 0x26c
+#define DTB_MASK 0x000ffffffffff000ull // CR3 without PCID and no-flush bits
+
+static const char *const g_kernel_pdbs[] = {
+    "ntkrnlmp.pdb", // multiprocessor (every x64 build since Vista)
+    "ntoskrnl.pdb",
+    "ntkrnlpa.pdb", // x86 PAE
+    "ntkrpamp.pdb",
+};
+
+static int is_kernel_pdb(const char *path)
+{
+  // Microsoft kernels carry a bare name, but tolerate a build path
+  const char *name = strrchr(path, '\\');
+  name = name ? name + 1 : path;
+
+  for (size_t i = 0; i < sizeof(g_kernel_pdbs) / sizeof(g_kernel_pdbs[0]); i++)
+  {
+    if (0 == strcasecmp(name, g_kernel_pdbs[i]))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Check whether the PE image whose header page is at @p pa is the kernel
+ *
+ * The kernel is mapped with large pages, so its RVAs can be followed
+ * physically from the header.
+ */
+static int probe_image(vmi_instance_t vmi, addr_t pa, const uint8_t *header, KernelImage_t *image)
+{
+  uint8_t directory[PE_DEBUG_DIRECTORY_MAX];
+  uint8_t record[PE_CODEVIEW_MAX + 1];
+  uint32_t rva = 0, size = 0;
+
+  if (pe_debug_directory(header, GUEST_PAGE_SIZE, &rva, &size) != 0)
+  {
+    return 0;
+  }
+
+  size = (size < sizeof(directory)) ? size : sizeof(directory);
+  if (VMI_FAILURE == vmi_read_pa(vmi, pa + rva, size, directory, NULL) ||
+      pe_find_codeview(directory, size, &rva, &size) != 0)
+  {
+    return 0;
+  }
+
+  size = (size < PE_CODEVIEW_MAX) ? size : PE_CODEVIEW_MAX;
+  if (size <= PE_RSDS_PDB_NAME ||
+      VMI_FAILURE == vmi_read_pa(vmi, pa + rva, size, record, NULL) ||
+      pe_parse_rsds(record, size, image->guid, &image->age) != 0)
+  {
+    return 0;
+  }
+
+  record[size] = '\0';
+  const char *pdb = (const char *)record + PE_RSDS_PDB_NAME;
+  if (!is_kernel_pdb(pdb))
+  {
+    return 0;
+  }
+
+  image->pa = pa;
+  strncpy(image->pdb_name, pdb, sizeof(image->pdb_name) - 1);
+  image->pdb_name[sizeof(image->pdb_name) - 1] = '\0';
+  return 1;
+}
+
+demo_error_t kdetect_find_kernel(vmi_instance_t vmi, KernelImage_t *image)
+{
+  addr_t max_pa = vmi_get_max_physical_address(vmi);
+  uint8_t *chunk = malloc(SCAN_CHUNK);
+  addr_t pa = 0;
+
+  if (!chunk)
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+  memset(image, 0, sizeof(*image));
+
+  while (pa < max_pa)
+  {
+    size_t want = (max_pa - pa < SCAN_CHUNK) ? (size_t)(max_pa - pa) : SCAN_CHUNK;
+    size_t got = 0;
+
+    // A partial read stops at an MMIO hole or unbacked frame; skip past it
+    vmi_read_pa(vmi, pa, want, chunk, &got);
+    got &= (size_t)GUEST_PAGE_MASK;
+
+    for (size_t off = 0; off < got; off += GUEST_PAGE_SIZE)
+    {
+      image->pages_scanned++;
+      if (chunk[off] == 'M' && chunk[off + 1] == 'Z' &&
+          probe_image(vmi, pa + off, chunk + off, image))
+      {
+        free(chunk);
+        return DEMO_SUCCESS;
+      }
+    }
+
+    pa += (got == want) ? got : got + GUEST_PAGE_SIZE;
+  }
+
+  free(chunk);
+  return DEMO_ERROR_MODULE;
+}
+
+demo_error_t kdetect_kernel_build(vmi_instance_t vmi, uint32_t *build)
+{
+  static const addr_t kuser[] = {KUSER_SHARED_DATA_KERNEL, KUSER_SHARED_DATA_USER};
+  uint64_t cr3 = 0;
+
+  if (VMI_FAILURE == vmi_get_vcpureg(vmi, &cr3, CR3, 0) ||
+      (VMI_PM_UNKNOWN == vmi_get_page_mode(vmi, 0) && VMI_PM_UNKNOWN == vmi_init_paging(vmi, 0)))
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  for (size_t i = 0; i < sizeof(kuser) / sizeof(kuser[0]); i++)
+  {
+    addr_t pa = 0;
+    uint32_t major = 0, number = 0;
+
+    if (VMI_SUCCESS == vmi_pagetable_lookup(vmi, cr3 & DTB_MASK, kuser[i], &pa) &&
+        VMI_SUCCESS == vmi_read_32_pa(vmi, pa + KUSER_NT_MAJOR_VERSION, &major) &&
+        VMI_SUCCESS == vmi_read_32_pa(vmi, pa + KUSER_NT_BUILD_NUMBER, &number))
+    {
+      if (major < 10)
+      {
+        return DEMO_ERROR_MODULE;
+      }
+      *build = number & 0xffff;
+      return DEMO_SUCCESS;
+    }
+  }
+  return DEMO_ERROR_MODULE;
+}
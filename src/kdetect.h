@@ -0,0 +1,46 @@
+/**
+ * @file kdetect.h
+ * @brief Locate the Windows kernel image in guest physical memory
+ *
+ * Works on a LibVMI instance that has only been initialized for memory
+ * access (no OS profile yet): page-aligned PE headers are checked for a
+ * CodeView record naming a kernel PDB, which yields both the physical
+ * load address LibVMI needs as win_ntoskrnl and the GUID that keys the
+ * profile cache.
+ */
+
+#ifndef KDETECT_H
+#define KDETECT_H
+
+#include "vmi_demo.h"
+#include "pe.h"
+
+#define KDETECT_PDB_NAME_LEN 32
+
+typedef struct KernelImage_t
+{
+  addr_t pa; // physical address of the MZ header
+  char guid[PE_GUID_LEN];
+  uint32_t age;
+  char pdb_name[KDETECT_PDB_NAME_LEN]; // e.g. "ntkrnlmp.pdb"
+  size_t pages_scanned;
+} KernelImage_t;
+
+/**
+ * @brief Scan physical memory upwards from 0 and stop at the first kernel image
+ * @return DEMO_SUCCESS if found, DEMO_ERROR_MODULE if no kernel image was seen
+ */
+demo_error_t kdetect_find_kernel(vmi_instance_t vmi, KernelImage_t *image);
+
+/**
+ * @brief Read the NT build number from KUSER_SHARED_DATA
+ *
+ * Translates through vCPU 0's CR3, so it also works before LibVMI's OS
+ * initialization. Under KVA shadowing that CR3 may be a user address
+ * space, which still maps the page at its user address.
+ *
+ * @return DEMO_ERROR_MODULE if the page is not mapped or the kernel is older than Windows 10
+ */
+demo_error_t kdetect_kernel_build(vmi_instance_t vmi, uint32_t *build);
+
+#endif // KDETECT_H
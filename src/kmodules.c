@@ -0,0 +1,175 @@
+/**
+ * @file kmodules.c
+ * @brief Loaded module list enumeration (PsLoadedModuleList and PEB Ldr)
+ *
+ * The leading fields of the x64 LDR_DATA_TABLE_ENTRY, PEB and PEB_LDR_DATA
+ * have kept the same layout from Windows 7 through Windows 11, so they are
+ * hardcoded here instead of being looked up per build.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "kmodules.h"
+#include "symbols.h"
+#include "utf16.h"
+
+// x64 LDR_DATA_TABLE_ENTRY layout
+#define LDR_IN_LOAD_ORDER_LINKS 0x00
+#define LDR_DLL_BASE 0x30
+#define LDR_SIZE_OF_IMAGE 0x40
+#define LDR_BASE_DLL_NAME 0x58
+#define LDR_ENTRY_READ_SIZE 0x68
+
+// x64 PEB.Ldr and PEB_LDR_DATA.InLoadOrderModuleList
+#define PEB_LDR 0x18
+#define LDR_DATA_IN_LOAD_ORDER_LIST 0x10
+
+// Guard against looping forever on a corrupted or smeared list
+#define MAX_LOADED_MODULES 4096
+
+/**
+ * @brief Read a UNICODE_STRING as UTF-8, cut at a character boundary to fit
+ */
+static void read_module_name(vmi_instance_t vmi, vmi_pid_t pid, const uint8_t *ustr,
+                             char *out, size_t out_len)
+{
+  uint16_t length = 0;
+  addr_t buffer = 0;
+  uint16_t wide[MAX_MODULE_NAME];
+  size_t chars = 0;
+
+  memcpy(&length, ustr, sizeof(length));
+  memcpy(&buffer, ustr + 8, sizeof(buffer));
+
+  out[0] = '\0';
+  chars = length / 2;
+  if (chars > MAX_MODULE_NAME)
+  {
+    chars = MAX_MODULE_NAME; // more than fits in out once transcoded
+  }
+  if (!buffer || !chars ||
+      VMI_FAILURE == vmi_read_va(vmi, buffer, pid, chars * 2, wide, NULL))
+  {
+    return;
+  }
+
+  utf16_to_utf8(wide, chars, out, out_len);
+}
+
+demo_error_t kmodules_finish(KernelModuleList_t *list, demo_error_t walk)
+{
+  if (walk == DEMO_SUCCESS && !list->count)
+  {
+    walk = DEMO_ERROR_MODULE;
+  }
+  if (walk == DEMO_SUCCESS && !list->unindexed &&
+      modindex_update(&list->index, list->intervals, list->count) < 0)
+  {
+    walk = DEMO_ERROR_MEMORY;
+  }
+  if (walk != DEMO_SUCCESS)
+  {
+    // Lookups must not attribute addresses to modules of an earlier walk
+    list->count = 0;
+    modindex_clear(&list->index);
+  }
+  return walk;
+}
+
+/**
+ * @brief Walk an LDR_DATA_TABLE_ENTRY list in the address space of @p pid
+ */
+static demo_error_t walk_ldr_list(vmi_instance_t vmi, vmi_pid_t pid, addr_t list_head,
+                                  KernelModuleList_t *list)
+{
+  addr_t entry = 0;
+  uint8_t raw[LDR_ENTRY_READ_SIZE];
+
+  list->count = 0;
+
+  if (VMI_FAILURE == vmi_read_addr_va(vmi, list_head, pid, &entry))
+  {
+    return kmodules_finish(list, DEMO_ERROR_MODULE);
+  }
+
+  while (entry && entry != list_head && list->count < MAX_LOADED_MODULES)
+  {
+    // One read covers links, base, size and both name descriptors
+    if (VMI_FAILURE == vmi_read_va(vmi, entry, pid, sizeof(raw), raw, NULL))
+    {
+      break;
+    }
+
+    if (list->count == list->capacity)
+    {
+      size_t capacity = list->capacity ? list->capacity * 2 : 128;
+      KernelModule_t *grown = realloc(list->modules, capacity * sizeof(*grown));
+      if (!grown)
+      {
+        return kmodules_finish(list, DEMO_ERROR_MEMORY);
+      }
+      list->modules = grown;
+
+      ModuleInterval_t *intervals = realloc(list->intervals, capacity * sizeof(*intervals));
+      if (!intervals)
+      {
+        return kmodules_finish(list, DEMO_ERROR_MEMORY);
+      }
+      list->intervals = intervals;
+      list->capacity = capacity;
+    }
+
+    KernelModule_t *module = &list->modules[list->count];
+    memcpy(&module->base, raw + LDR_DLL_BASE, sizeof(module->base));
+    memcpy(&module->size, raw + LDR_SIZE_OF_IMAGE, sizeof(module->size));
+    read_module_name(vmi, pid, raw + LDR_BASE_DLL_NAME, module->name, sizeof(module->name));
+
+    if (module->base && module->size)
+    {
+      ModuleInterval_t *interval = &list->intervals[list->count];
+      interval->start = module->base;
+      interval->end = module->base + module->size;
+      interval->owner = (uint32_t)list->count;
+      list->count++;
+    }
+
+    memcpy(&entry, raw + LDR_IN_LOAD_ORDER_LINKS, sizeof(entry));
+  }
+
+  return kmodules_finish(list, DEMO_SUCCESS);
+}
+
+demo_error_t kmodules_enumerate(vmi_instance_t vmi, KernelModuleList_t *list)
+{
+  addr_t list_head = 0;
+
+  if (VMI_FAILURE == symbols_ksym2v(vmi, "PsLoadedModuleList", &list_head))
+  {
+    return kmodules_finish(list, DEMO_ERROR_MODULE);
+  }
+  return walk_ldr_list(vmi, 0, list_head, list);
+}
+
+demo_error_t kmodules_enumerate_process(vmi_instance_t vmi, vmi_pid_t pid, addr_t peb,
+                                        KernelModuleList_t *list)
+{
+  addr_t ldr = 0;
+
+  if (!peb || VMI_FAILURE == vmi_read_addr_va(vmi, peb + PEB_LDR, pid, &ldr) || !ldr)
+  {
+    return kmodules_finish(list, DEMO_ERROR_MODULE);
+  }
+  return walk_ldr_list(vmi, pid, ldr + LDR_DATA_IN_LOAD_ORDER_LIST, list);
+}
+
+void kmodules_free(KernelModuleList_t *list)
+{
+  free(list->modules);
+  free(list->intervals);
+  modindex_free(&list->index);
+  list->modules = NULL;
+  list->intervals = NULL;
+  list->count = 0;
+  list->capacity = 0;
+}
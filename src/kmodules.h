@@ -0,0 +1,75 @@
+/**
+ * @file kmodules.h
+ * @brief Loaded module list enumeration (PsLoadedModuleList and PEB Ldr)
+ *
+ * The same list type holds the kernel driver list and a process's
+ * user-mode modules; a list used for address attribution carries an
+ * interval index that is only re-laid out when the list changes.
+ */
+
+#ifndef KMODULES_H
+#define KMODULES_H
+
+#include <stddef.h>
+#include "vmi_demo.h"
+#include "modindex.h"
+
+// Loaded module (one LDR_DATA_TABLE_ENTRY)
+typedef struct KernelModule_t
+{
+  addr_t base;
+  uint32_t size;
+  char name[MAX_MODULE_NAME];
+} KernelModule_t;
+
+// Growable array of modules in load order, plus its address index
+typedef struct KernelModuleList_t
+{
+  KernelModule_t *modules;
+  size_t count;
+  size_t capacity;
+  ModuleInterval_t *intervals; // scratch for index updates
+  ModuleIndex_t index;
+  int unindexed; // set by owners that only list the modules; kmodules_find always misses
+} KernelModuleList_t;
+
+/**
+ * @brief Walk PsLoadedModuleList and refill @p list
+ *
+ * @p list may be reused across sweeps; its index is only re-laid out
+ * when the driver set changed.
+ */
+demo_error_t kmodules_enumerate(vmi_instance_t vmi, KernelModuleList_t *list);
+
+/**
+ * @brief Walk PEB->Ldr->InLoadOrderModuleList of process @p pid and refill @p list
+ */
+demo_error_t kmodules_enumerate_process(vmi_instance_t vmi, vmi_pid_t pid, addr_t peb,
+                                        KernelModuleList_t *list);
+
+/**
+ * @brief Index @p list after a walk that returned @p walk
+ *
+ * A failed or empty walk empties the list and its index, so lookups miss
+ * instead of returning modules from an earlier walk. Lists marked
+ * unindexed skip the index.
+ *
+ * @return @p walk, DEMO_ERROR_MODULE for an empty list or DEMO_ERROR_MEMORY
+ */
+demo_error_t kmodules_finish(KernelModuleList_t *list, demo_error_t walk);
+
+/**
+ * @brief Find the module whose image contains @p addr, or NULL
+ */
+static inline const KernelModule_t *kmodules_find(const KernelModuleList_t *list, addr_t addr)
+{
+  uint32_t owner = modindex_lookup(&list->index, addr);
+  return (owner == MODINDEX_NONE) ? NULL : &list->modules[owner];
+}
+
+/**
+ * @brief Release memory held by @p list
+ */
+void kmodules_free(KernelModuleList_t *list);
+
+#endif // KMODULES_H
@@ -0,0 +1,272 @@
+/**
+ * @file linuxos.c
+ * @brief Linux guest support: task list and per-task memory maps
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linuxos.h"
+#include "isf.h"
+#include "readstats.h"
+#include "output.h"
+
+#define WALK_MAX 65536 // guards against a corrupted (looping) list
+#define MAX_VMAS 65536 // default vm.max_map_count is 65530
+
+// Index into g_fields
+enum
+{
+  FIELD_TASKS,
+  FIELD_PID,
+  FIELD_COMM,
+  FIELD_MM,
+  FIELD_MM_MMAP,
+  FIELD_VMA_START,
+  FIELD_VMA_END,
+  FIELD_VMA_NEXT,
+  FIELD_VMA_FILE,
+  FIELD_FILE_PATH,
+  FIELD_PATH_DENTRY,
+  FIELD_DENTRY_NAME,
+  FIELD_QSTR_NAME,
+  FIELD_COUNT
+};
+
+static IsfField_t g_fields[FIELD_COUNT] = {
+    {"task_struct", "tasks", 0, 0},
+    {"task_struct", "pid", 0, 0},
+    {"task_struct", "comm", 0, 0},
+    {"task_struct", "mm", 0, 0},
+    {"mm_struct", "mmap", 0, 0},
+    {"vm_area_struct", "vm_start", 0, 0},
+    {"vm_area_struct", "vm_end", 0, 0},
+    {"vm_area_struct", "vm_next", 0, 0},
+    {"vm_area_struct", "vm_file", 0, 0},
+    {"file", "f_path", 0, 0},
+    {"path", "dentry", 0, 0},
+    {"dentry", "d_name", 0, 0},
+    {"qstr", "name", 0, 0},
+};
+
+static IsfRequest_t g_request = {g_fields, FIELD_COUNT, NULL, 0, {0}, 0, 0};
+
+/**
+ * @brief ISF offset if present, else LibVMI's @p config_name
+ */
+static size_t task_offset(vmi_instance_t vmi, int field, const char *config_name)
+{
+  addr_t offset = 0;
+
+  if (g_fields[field].found)
+  {
+    return (size_t)g_fields[field].value;
+  }
+  if (VMI_FAILURE == vmi_get_offset(vmi, config_name, &offset))
+  {
+    return 0;
+  }
+  return offset;
+}
+
+static size_t isf_offset(int field)
+{
+  return g_fields[field].found ? (size_t)g_fields[field].value : 0;
+}
+
+demo_error_t linux_resolve_offsets(vmi_instance_t vmi, const char *isf_path, LinuxOffsets_t *offsets)
+{
+  memset(offsets, 0, sizeof(*offsets));
+
+  if (isf_path && DEMO_SUCCESS != isf_load(isf_path, &g_request))
+  {
+    output_text("WARNING: Could not load Linux ISF %s\n", isf_path);
+  }
+
+  offsets->tasks = task_offset(vmi, FIELD_TASKS, "linux_tasks");
+  offsets->pid = task_offset(vmi, FIELD_PID, "linux_pid");
+  offsets->comm = task_offset(vmi, FIELD_COMM, "linux_name");
+  offsets->mm = task_offset(vmi, FIELD_MM, "linux_mm");
+
+  // mm_struct.mmap and vm_area_struct.vm_start sit at offset 0, so only
+  // the found flags tell whether memory maps can be walked
+  offsets->has_vmas = 1;
+  for (int field = FIELD_MM_MMAP; field < FIELD_COUNT; field++)
+  {
+    offsets->has_vmas &= g_fields[field].found;
+  }
+  offsets->has_vmas &= (offsets->mm != 0);
+  offsets->mm_mmap = isf_offset(FIELD_MM_MMAP);
+  offsets->vma_start = isf_offset(FIELD_VMA_START);
+  offsets->vma_end = isf_offset(FIELD_VMA_END);
+  offsets->vma_next = isf_offset(FIELD_VMA_NEXT);
+  offsets->vma_file = isf_offset(FIELD_VMA_FILE);
+  offsets->file_dentry = isf_offset(FIELD_FILE_PATH) + isf_offset(FIELD_PATH_DENTRY);
+  offsets->dentry_name = isf_offset(FIELD_DENTRY_NAME) + isf_offset(FIELD_QSTR_NAME);
+
+  if (!offsets->tasks || !offsets->pid || !offsets->comm)
+  {
+    return DEMO_ERROR_PROCESS;
+  }
+  return DEMO_SUCCESS;
+}
+
+demo_error_t linux_enumerate_tasks(vmi_instance_t vmi, const LinuxOffsets_t *offsets, LinuxTaskList_t *list)
+{
+  addr_t init_task = 0;
+
+  list->count = 0;
+
+  if (VMI_FAILURE == vmi_translate_ksym2v(vmi, "init_task", &init_task) || !init_task)
+  {
+    return DEMO_ERROR_PROCESS;
+  }
+
+  // init_task (the idle task, PID 0) is the list head and a task of its own
+  addr_t head = init_task + offsets->tasks;
+  addr_t link = head;
+  do
+  {
+    addr_t task = link - offsets->tasks;
+    uint32_t pid = 0;
+
+    if (list->count == list->capacity)
+    {
+      size_t capacity = list->capacity ? list->capacity * 2 : 256;
+      LinuxTask_t *grown = realloc(list->tasks, capacity * sizeof(*grown));
+      if (!grown)
+      {
+        return DEMO_ERROR_MEMORY;
+      }
+      list->tasks = grown;
+      list->capacity = capacity;
+    }
+
+    if (VMI_SUCCESS == readstats_read_32(vmi, READ_SITE_PID, task + offsets->pid, &pid))
+    {
+      LinuxTask_t *entry = &list->tasks[list->count++];
+      entry->pid = (vmi_pid_t)pid;
+      entry->task = task;
+      entry->mm = 0;
+      if (offsets->mm)
+      {
+        readstats_read_addr(vmi, READ_SITE_PEB, task + offsets->mm, &entry->mm);
+      }
+
+      char *name = readstats_read_str(vmi, READ_SITE_NAME, task + offsets->comm);
+      snprintf(entry->name, sizeof(entry->name), "%s", name ? name : "?");
+      free(name);
+    }
+
+    if (VMI_FAILURE == readstats_read_addr(vmi, READ_SITE_LINK, link, &link))
+    {
+      break;
+    }
+  } while (link && link != head && list->count < WALK_MAX);
+
+  return list->count ? DEMO_SUCCESS : DEMO_ERROR_PROCESS;
+}
+
+/**
+ * @brief Copy the last path component of @p file into @p out
+ */
+static void read_file_name(vmi_instance_t vmi, const LinuxOffsets_t *offsets, addr_t file,
+                           char *out, size_t len)
+{
+  addr_t dentry = 0;
+  addr_t name_ptr = 0;
+  char *name = NULL;
+
+  if (VMI_SUCCESS == readstats_read_addr(vmi, READ_SITE_VMA, file + offsets->file_dentry, &dentry) && dentry &&
+      VMI_SUCCESS == readstats_read_addr(vmi, READ_SITE_VMA, dentry + offsets->dentry_name, &name_ptr) && name_ptr)
+  {
+    name = readstats_read_str(vmi, READ_SITE_VMA, name_ptr);
+  }
+  snprintf(out, len, "%s", name ? name : "?");
+  free(name);
+}
+
+demo_error_t linux_enumerate_vmas(vmi_instance_t vmi, const LinuxOffsets_t *offsets,
+                                  const LinuxTask_t *task, KernelModuleList_t *list)
+{
+  addr_t vma = 0;
+
+  list->count = 0;
+
+  if (!task->mm || !offsets->has_vmas ||
+      VMI_FAILURE == readstats_read_addr(vmi, READ_SITE_VMA, task->mm + offsets->mm_mmap, &vma))
+  {
+    return kmodules_finish(list, DEMO_ERROR_MODULE);
+  }
+
+  while (vma && list->count < MAX_VMAS)
+  {
+    addr_t start = 0;
+    addr_t end = 0;
+    addr_t file = 0;
+
+    if (VMI_FAILURE == readstats_read_addr(vmi, READ_SITE_VMA, vma + offsets->vma_start, &start) ||
+        VMI_FAILURE == readstats_read_addr(vmi, READ_SITE_VMA, vma + offsets->vma_end, &end) ||
+        VMI_FAILURE == readstats_read_addr(vmi, READ_SITE_VMA, vma + offsets->vma_file, &file))
+    {
+      break;
+    }
+
+    if (list->count == list->capacity)
+    {
+      size_t capacity = list->capacity ? list->capacity * 2 : 128;
+      KernelModule_t *grown = realloc(list->modules, capacity * sizeof(*grown));
+      if (!grown)
+      {
+        return kmodules_finish(list, DEMO_ERROR_MEMORY);
+      }
+      list->modules = grown;
+
+      ModuleInterval_t *intervals = realloc(list->intervals, capacity * sizeof(*intervals));
+      if (!intervals)
+      {
+        return kmodules_finish(list, DEMO_ERROR_MEMORY);
+      }
+      list->intervals = intervals;
+      list->capacity = capacity;
+    }
+
+    if (end > start)
+    {
+      KernelModule_t *module = &list->modules[list->count];
+      module->base = start;
+      // KernelModule_t.size is 32-bit; the interval keeps the true extent
+      module->size = (end - start > UINT32_MAX) ? UINT32_MAX : (uint32_t)(end - start);
+      if (file)
+      {
+        read_file_name(vmi, offsets, file, module->name, sizeof(module->name));
+      }
+      else
+      {
+        snprintf(module->name, sizeof(module->name), "[anon]");
+      }
+
+      ModuleInterval_t *interval = &list->intervals[list->count];
+      interval->start = start;
+      interval->end = end;
+      interval->owner = (uint32_t)list->count;
+      list->count++;
+    }
+
+    if (VMI_FAILURE == readstats_read_addr(vmi, READ_SITE_VMA, vma + offsets->vma_next, &vma))
+    {
+      break;
+    }
+  }
+
+  return kmodules_finish(list, DEMO_SUCCESS);
+}
+
+void linux_free_tasks(LinuxTaskList_t *list)
+{
+  free(list->tasks);
+  list->tasks = NULL;
+  list->count = 0;
+  list->capacity = 0;
+}
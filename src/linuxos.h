@@ -0,0 +1,71 @@
+/**
+ * @file linuxos.h
+ * @brief Linux guest support: task list and per-task memory maps
+ *
+ * Tasks are walked from init_task.tasks with LibVMI's linux_tasks,
+ * linux_pid, linux_name and linux_mm offsets. Memory maps follow
+ * mm_struct.mmap through vm_area_struct.vm_next. Those offsets are not
+ * part of LibVMI's configuration and come from a Volatility3 Linux ISF
+ * (--isf). Kernels from 6.1 on keep VMAs in a maple tree instead of that
+ * list, so their ISF has no mm_struct.mmap and maps are skipped.
+ */
+
+#ifndef LINUXOS_H
+#define LINUXOS_H
+
+#include "vmi_demo.h"
+#include "kmodules.h"
+
+typedef struct LinuxOffsets_t
+{
+  size_t tasks; // task_struct.tasks
+  size_t pid;   // task_struct.pid
+  size_t comm;  // task_struct.comm
+  size_t mm;    // task_struct.mm
+  // Memory maps, valid only when has_vmas is set
+  size_t mm_mmap;     // mm_struct.mmap
+  size_t vma_start;   // vm_area_struct.vm_start
+  size_t vma_end;     // vm_area_struct.vm_end
+  size_t vma_next;    // vm_area_struct.vm_next
+  size_t vma_file;    // vm_area_struct.vm_file
+  size_t file_dentry; // file.f_path + path.dentry
+  size_t dentry_name; // dentry.d_name + qstr.name
+  uint8_t has_vmas;
+} LinuxOffsets_t;
+
+typedef struct LinuxTask_t
+{
+  vmi_pid_t pid;
+  char name[MAX_PROC_NAME];
+  addr_t task; // task_struct
+  addr_t mm;   // 0 for kernel threads
+} LinuxTask_t;
+
+typedef struct LinuxTaskList_t
+{
+  LinuxTask_t *tasks;
+  size_t count;
+  size_t capacity;
+} LinuxTaskList_t;
+
+/**
+ * @brief Resolve task offsets from LibVMI and memory-map offsets from @p isf_path
+ * @param isf_path Volatility3 Linux ISF, or NULL to skip memory maps
+ * @return DEMO_ERROR_PROCESS if the task list offsets are unknown
+ */
+demo_error_t linux_resolve_offsets(vmi_instance_t vmi, const char *isf_path, LinuxOffsets_t *offsets);
+
+/**
+ * @brief Walk init_task.tasks and refill @p list
+ */
+demo_error_t linux_enumerate_tasks(vmi_instance_t vmi, const LinuxOffsets_t *offsets, LinuxTaskList_t *list);
+
+/**
+ * @brief Refill @p list with @p task's VMAs: file name (or "[anon]"), start and length
+ */
+demo_error_t linux_enumerate_vmas(vmi_instance_t vmi, const LinuxOffsets_t *offsets,
+                                  const LinuxTask_t *task, KernelModuleList_t *list);
+
+void linux_free_tasks(LinuxTaskList_t *list);
+
+#endif // LINUXOS_H
@@ -0,0 +1,378 @@
+/**
+ * @file metrics.c
+ * @brief Prometheus text-format metrics endpoint for continuous mode
+ */
+
+#define _GNU_SOURCE // accept4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+#include "readstats.h"
+
+#define METRICS_BODY_MAX (16 * 1024)
+#define METRICS_REQUEST_MAX 1024
+
+typedef struct MetricInfo_t
+{
+  const char *name;
+  const char *type;
+  const char *help;
+  int seconds; // stored in nanoseconds, exposed in seconds
+} MetricInfo_t;
+
+static const MetricInfo_t g_info[METRIC_COUNT] = {
+    [METRIC_SWEEPS] = {"vmi_sweeps_total", "counter", "Completed introspection sweeps.", 0},
+    [METRIC_SWEEP_FAILURES] = {"vmi_sweep_failures_total", "counter", "Sweeps that ended with an error.", 0},
+    [METRIC_SWEEP_NS_TOTAL] = {"vmi_sweep_seconds_total", "counter", "Time spent in sweeps.", 1},
+    [METRIC_SWEEP_NS_LAST] = {"vmi_sweep_last_seconds", "gauge", "Duration of the most recent sweep.", 1},
+    [METRIC_SWEEP_NS_MAX] = {"vmi_sweep_max_seconds", "gauge", "Longest sweep since start.", 1},
+    [METRIC_PROCESSES] = {"vmi_processes", "gauge", "Processes seen in the most recent sweep.", 0},
+    [METRIC_MODULES] = {"vmi_process_modules", "gauge", "User-mode modules seen in the most recent sweep.", 0},
+    [METRIC_PAUSES] = {"vmi_vm_pauses_total", "counter", "Times the guest was paused.", 0},
+    [METRIC_PAUSE_NS_TOTAL] = {"vmi_vm_pause_seconds_total", "counter", "Time the guest spent paused.", 1},
+    [METRIC_PAUSE_NS_LAST] = {"vmi_vm_pause_last_seconds", "gauge", "Duration of the most recent pause.", 1},
+    [METRIC_PAUSE_NS_MAX] = {"vmi_vm_pause_max_seconds", "gauge", "Longest pause since start.", 1},
+    [METRIC_CODE_PAGES_CHECKED] = {"vmi_code_pages_checked_total", "counter", "Driver code pages covered by integrity sweeps.", 0},
+    [METRIC_CODE_PAGES_HASHED] = {"vmi_code_pages_hashed_total", "counter", "Driver code pages rehashed (integrity cache misses).", 0},
+    [METRIC_SSDT_CHECKS] = {"vmi_service_table_checks_total", "counter", "Service table checks.", 0},
+    [METRIC_SSDT_CACHE_HITS] = {"vmi_service_table_cache_hits_total", "counter", "Service table checks answered from the cache.", 0},
+    [METRIC_SWEEP_INTERVAL_NS] = {"vmi_sweep_interval_seconds", "gauge", "Wait before the next sweep.", 1},
+};
+
+static uint64_t g_values[METRIC_COUNT];
+
+static int g_listen_fd = -1;
+static int g_stop_pipe[2] = {-1, -1};
+static pthread_t g_thread;
+static int g_started;
+static char g_unix_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+typedef struct Body_t
+{
+  char buf[METRICS_BODY_MAX];
+  size_t len;
+} Body_t;
+
+void metrics_add(metric_t metric, uint64_t value)
+{
+  uint64_t current = __atomic_load_n(&g_values[metric], __ATOMIC_RELAXED);
+  __atomic_store_n(&g_values[metric], current + value, __ATOMIC_RELAXED);
+}
+
+void metrics_set(metric_t metric, uint64_t value)
+{
+  __atomic_store_n(&g_values[metric], value, __ATOMIC_RELAXED);
+}
+
+void metrics_max(metric_t metric, uint64_t value)
+{
+  if (value > __atomic_load_n(&g_values[metric], __ATOMIC_RELAXED))
+  {
+    __atomic_store_n(&g_values[metric], value, __ATOMIC_RELAXED);
+  }
+}
+
+static void append(Body_t *body, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(Body_t *body, const char *fmt, ...)
+{
+  va_list args;
+
+  if (body->len >= sizeof(body->buf))
+  {
+    return;
+  }
+  va_start(args, fmt);
+  int n = vsnprintf(body->buf + body->len, sizeof(body->buf) - body->len, fmt, args);
+  va_end(args);
+  if (n > 0)
+  {
+    body->len += (size_t)n;
+  }
+}
+
+static void family(Body_t *body, const char *name, const char *type, const char *help)
+{
+  append(body, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void render(Body_t *body)
+{
+  body->len = 0;
+
+  for (unsigned i = 0; i < METRIC_COUNT; i++)
+  {
+    const MetricInfo_t *info = &g_info[i];
+    uint64_t value = __atomic_load_n(&g_values[i], __ATOMIC_RELAXED);
+
+    family(body, info->name, info->type, info->help);
+    if (info->seconds)
+    {
+      append(body, "%s %.9f\n", info->name, (double)value / 1e9);
+    }
+    else
+    {
+      append(body, "%s %lu\n", info->name, (unsigned long)value);
+    }
+  }
+
+  ReadTotals_t totals[READ_SITE_COUNT];
+  for (unsigned i = 0; i < READ_SITE_COUNT; i++)
+  {
+    readstats_totals((read_site_t)i, &totals[i]);
+  }
+
+  family(body, "vmi_guest_reads_total", "counter", "Guest memory reads by call site.");
+  for (unsigned i = 0; i < READ_SITE_COUNT; i++)
+  {
+    append(body, "vmi_guest_reads_total{site=\"%s\"} %lu\n", readstats_site_name((read_site_t)i),
+           (unsigned long)totals[i].count);
+  }
+  family(body, "vmi_guest_read_failures_total", "counter", "Failed guest memory reads by call site.");
+  for (unsigned i = 0; i < READ_SITE_COUNT; i++)
+  {
+    append(body, "vmi_guest_read_failures_total{site=\"%s\"} %lu\n",
+           readstats_site_name((read_site_t)i), (unsigned long)totals[i].failures);
+  }
+  family(body, "vmi_guest_read_bytes_total", "counter", "Bytes read from the guest by call site.");
+  for (unsigned i = 0; i < READ_SITE_COUNT; i++)
+  {
+    append(body, "vmi_guest_read_bytes_total{site=\"%s\"} %lu\n",
+           readstats_site_name((read_site_t)i), (unsigned long)totals[i].bytes);
+  }
+  family(body, "vmi_guest_read_seconds_total", "counter", "Time spent in guest reads by call site.");
+  for (unsigned i = 0; i < READ_SITE_COUNT; i++)
+  {
+    append(body, "vmi_guest_read_seconds_total{site=\"%s\"} %.9f\n",
+           readstats_site_name((read_site_t)i), (double)totals[i].total_ns / 1e9);
+  }
+
+  family(body, "vmi_sweep_phase_last_seconds", "gauge", "Duration of each phase in the most recent sweep.");
+  for (unsigned i = 0; i < SWEEP_PHASE_COUNT; i++)
+  {
+    append(body, "vmi_sweep_phase_last_seconds{phase=\"%s\"} %.9f\n",
+           readstats_phase_name((sweep_phase_t)i),
+           (double)readstats_phase_last_ns((sweep_phase_t)i) / 1e9);
+  }
+}
+
+static void write_all(int fd, const char *data, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t written = send(fd, data, len, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written <= 0)
+    {
+      return;
+    }
+    data += written;
+    len -= (size_t)written;
+  }
+}
+
+/**
+ * @brief Answer one HTTP request; anything but GET /metrics (or /) gets a 404
+ */
+static void serve(int fd, Body_t *body)
+{
+  char request[METRICS_REQUEST_MAX];
+  char header[160];
+
+  // A client that connects and sends nothing must not stall the endpoint
+  struct timeval timeout = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+  if (n <= 0)
+  {
+    return;
+  }
+  request[n] = '\0';
+
+  if (0 != strncmp(request, "GET /metrics ", 13) && 0 != strncmp(request, "GET / ", 6))
+  {
+    static const char not_found[] =
+        "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    write_all(fd, not_found, sizeof(not_found) - 1);
+    return;
+  }
+
+  render(body);
+  int len = snprintf(header, sizeof(header),
+                     "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n",
+                     body->len);
+  write_all(fd, header, (size_t)len);
+  write_all(fd, body->buf, body->len);
+}
+
+static void *metrics_thread(void *arg)
+{
+  (void)arg;
+  Body_t *body = malloc(sizeof(*body));
+  struct pollfd fds[2] = {{g_listen_fd, POLLIN, 0}, {g_stop_pipe[0], POLLIN, 0}};
+
+  while (body)
+  {
+    if (poll(fds, 2, -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      break;
+    }
+    if (fds[1].revents)
+    {
+      break;
+    }
+    if (fds[0].revents & POLLIN)
+    {
+      int client = accept4(g_listen_fd, NULL, NULL, SOCK_CLOEXEC);
+      if (client >= 0)
+      {
+        serve(client, body);
+        close(client);
+      }
+    }
+  }
+  free(body);
+  return NULL;
+}
+
+static int listen_unix(const char *path)
+{
+  struct sockaddr_un addr;
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+  {
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  unlink(path); // stale socket from a previous run
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+  strcpy(g_unix_path, path);
+  return fd;
+}
+
+static int listen_tcp(const char *address)
+{
+  struct sockaddr_in addr;
+  char host[64] = "127.0.0.1";
+  const char *port = address;
+  const char *colon = strrchr(address, ':');
+
+  if (colon)
+  {
+    size_t len = (size_t)(colon - address);
+    if (len >= sizeof(host))
+    {
+      return -1;
+    }
+    memcpy(host, address, len);
+    host[len] = '\0';
+    port = colon + 1;
+  }
+
+  char *end = NULL;
+  unsigned long number = strtoul(port, &end, 10);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)number);
+  if (!*port || *end || number == 0 || number > 65535 || inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+  {
+    return -1;
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+demo_error_t metrics_start(const char *address)
+{
+  g_listen_fd = (0 == strncmp(address, "unix:", 5)) ? listen_unix(address + 5) : listen_tcp(address);
+  if (g_listen_fd < 0)
+  {
+    return DEMO_ERROR_INIT;
+  }
+
+  if (pipe(g_stop_pipe) != 0 || 0 != pthread_create(&g_thread, NULL, metrics_thread, NULL))
+  {
+    metrics_stop();
+    return DEMO_ERROR_INIT;
+  }
+  g_started = 1;
+  return DEMO_SUCCESS;
+}
+
+void metrics_stop(void)
+{
+  if (g_started)
+  {
+    ssize_t ignored = write(g_stop_pipe[1], "x", 1);
+    (void)ignored;
+    pthread_join(g_thread, NULL);
+    g_started = 0;
+  }
+  for (int i = 0; i < 2; i++)
+  {
+    if (g_stop_pipe[i] >= 0)
+    {
+      close(g_stop_pipe[i]);
+      g_stop_pipe[i] = -1;
+    }
+  }
+  if (g_listen_fd >= 0)
+  {
+    close(g_listen_fd);
+    g_listen_fd = -1;
+  }
+  if (g_unix_path[0])
+  {
+    unlink(g_unix_path);
+    g_unix_path[0] = '\0';
+  }
+}
@@ -0,0 +1,49 @@
+/**
+ * @file metrics.h
+ * @brief Prometheus text-format metrics endpoint for continuous mode
+ *
+ * The sweep thread updates plain 64-bit cells with relaxed atomic stores;
+ * a listener thread serves them, together with the read statistics, as
+ * Prometheus text exposition over HTTP on a local TCP port or a Unix
+ * socket. Nothing on the sweep path takes a lock or waits for a scrape.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "vmi_demo.h"
+
+typedef enum
+{
+  METRIC_SWEEPS,             // counter
+  METRIC_SWEEP_FAILURES,     // counter
+  METRIC_SWEEP_NS_TOTAL,     // counter
+  METRIC_SWEEP_NS_LAST,      // gauge
+  METRIC_SWEEP_NS_MAX,       // gauge
+  METRIC_PROCESSES,          // gauge, last sweep
+  METRIC_MODULES,            // gauge, last sweep
+  METRIC_PAUSES,             // counter
+  METRIC_PAUSE_NS_TOTAL,     // counter
+  METRIC_PAUSE_NS_LAST,      // gauge
+  METRIC_PAUSE_NS_MAX,       // gauge
+  METRIC_CODE_PAGES_CHECKED, // counter: pages covered by integrity sweeps
+  METRIC_CODE_PAGES_HASHED,  // counter: pages actually rehashed (cache misses)
+  METRIC_SSDT_CHECKS,        // counter
+  METRIC_SSDT_CACHE_HITS,    // counter: tables unchanged since the last sweep
+  METRIC_SWEEP_INTERVAL_NS,  // gauge: wait before the next sweep
+  METRIC_COUNT
+} metric_t;
+
+/**
+ * @brief Start serving on @p address: "unix:/path", "host:port" or "port" (127.0.0.1)
+ */
+demo_error_t metrics_start(const char *address);
+
+void metrics_stop(void);
+
+// Single writer per metric: the sweep thread
+void metrics_add(metric_t metric, uint64_t value);
+void metrics_set(metric_t metric, uint64_t value);
+void metrics_max(metric_t metric, uint64_t value);
+
+#endif // METRICS_H
@@ -0,0 +1,127 @@
+/**
+ * @file modindex.c
+ * @brief Address-to-module interval index
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "modindex.h"
+
+void modindex_init(ModuleIndex_t *index)
+{
+  memset(index, 0, sizeof(*index));
+}
+
+static int compare_intervals(const void *a, const void *b)
+{
+  const ModuleInterval_t *left = a, *right = b;
+  return (left->start > right->start) - (left->start < right->start);
+}
+
+static int same_starts(const ModuleInterval_t *a, const ModuleInterval_t *b, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    if (a[i].start != b[i].start)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int same_extents(const ModuleInterval_t *a, const ModuleInterval_t *b, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    if (a[i].end != b[i].end || a[i].owner != b[i].owner)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Fill Eytzinger slot @p k and its subtree from sorted[i...] in order
+ */
+static size_t layout(ModuleIndex_t *index, size_t i, size_t k)
+{
+  if (k <= index->count)
+  {
+    i = layout(index, i, 2 * k);
+    index->keys[k] = index->sorted[i].start;
+    index->rank[k] = (uint32_t)i;
+    i = layout(index, i + 1, 2 * k + 1);
+  }
+  return i;
+}
+
+int modindex_update(ModuleIndex_t *index, const ModuleInterval_t *intervals, size_t count)
+{
+  ModuleInterval_t *incoming = malloc((count ? count : 1) * sizeof(*incoming));
+  if (!incoming)
+  {
+    modindex_clear(index);
+    return -1;
+  }
+  memcpy(incoming, intervals, count * sizeof(*incoming));
+  qsort(incoming, count, sizeof(*incoming), compare_intervals);
+
+  // keys and rank depend only on the starts; with the same starts the tree stands
+  if (index->keys && count == index->count && same_starts(incoming, index->sorted, count))
+  {
+    int changed = !same_extents(incoming, index->sorted, count);
+    free(index->sorted);
+    index->sorted = incoming;
+    index->generation += (uint64_t)changed;
+    return changed;
+  }
+
+  if (count + 1 > index->capacity)
+  {
+    addr_t *keys = realloc(index->keys, (count + 1) * sizeof(*keys));
+    if (keys)
+    {
+      index->keys = keys;
+    }
+    uint32_t *rank = realloc(index->rank, (count + 1) * sizeof(*rank));
+    if (rank)
+    {
+      index->rank = rank;
+    }
+    if (!keys || !rank)
+    {
+      free(incoming);
+      modindex_clear(index);
+      return -1;
+    }
+    index->capacity = count + 1;
+  }
+
+  free(index->sorted);
+  index->sorted = incoming;
+  index->count = count;
+  index->rank[0] = (uint32_t)count;
+  layout(index, 0, 1);
+  index->generation++;
+  return 1;
+}
+
+void modindex_clear(ModuleIndex_t *index)
+{
+  if (index->count)
+  {
+    index->count = 0;
+    index->generation++;
+  }
+}
+
+void modindex_free(ModuleIndex_t *index)
+{
+  free(index->sorted);
+  free(index->keys);
+  free(index->rank);
+  memset(index, 0, sizeof(*index));
+}
@@ -0,0 +1,86 @@
+/**
+ * @file modindex.h
+ * @brief Address-to-module interval index
+ *
+ * Interval starts are stored in Eytzinger (BFS) order so a lookup walks an
+ * implicit binary tree whose top levels share cache lines, with a
+ * branchless descent. Updates diff the new interval set against the current
+ * one: an identical set costs nothing, changed ends or owners are patched
+ * in place, and only a changed set of starts re-lays out the tree.
+ */
+
+#ifndef MODINDEX_H
+#define MODINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libvmi/libvmi.h>
+
+#define MODINDEX_NONE UINT32_MAX
+
+// Half-open address range [start, end) owned by @ref owner
+typedef struct ModuleInterval_t
+{
+  addr_t start;
+  addr_t end;
+  uint32_t owner; // caller-defined id, e.g. index into a module array
+} ModuleInterval_t;
+
+typedef struct ModuleIndex_t
+{
+  ModuleInterval_t *sorted; // intervals sorted by start
+  size_t count;
+  size_t capacity;
+  addr_t *keys;             // Eytzinger-ordered starts, 1-based
+  uint32_t *rank;           // Eytzinger slot -> position in @ref sorted, rank[0] = count
+  uint64_t generation;      // bumped whenever the indexed set changes
+} ModuleIndex_t;
+
+void modindex_init(ModuleIndex_t *index);
+
+/**
+ * @brief Replace the indexed set with @p intervals (any order, non-overlapping)
+ * @return 1 if the set changed, 0 if it was unchanged, -1 on allocation failure (the index is then empty)
+ */
+int modindex_update(ModuleIndex_t *index, const ModuleInterval_t *intervals, size_t count);
+
+/**
+ * @brief Empty the index so every lookup misses
+ */
+void modindex_clear(ModuleIndex_t *index);
+
+/**
+ * @brief Owner id of the interval containing @p addr, or MODINDEX_NONE
+ */
+static inline uint32_t modindex_lookup(const ModuleIndex_t *index, addr_t addr)
+{
+  size_t k = 1;
+  const size_t n = index->count;
+
+  if (!n)
+  {
+    return MODINDEX_NONE;
+  }
+
+  // Descend to the first start > addr; the comparison feeds the index, not a branch
+  while (k <= n)
+  {
+    __builtin_prefetch(index->keys + 16 * k);
+    k = 2 * k + (index->keys[k] <= addr);
+  }
+  k >>= __builtin_ffsll(~(long long)k);
+
+  // rank[k] is the sorted position of that successor; its predecessor may contain addr
+  size_t pos = index->rank[k];
+  if (pos == 0)
+  {
+    return MODINDEX_NONE;
+  }
+
+  const ModuleInterval_t *interval = &index->sorted[pos - 1];
+  return (addr < interval->end) ? interval->owner : MODINDEX_NONE;
+}
+
+void modindex_free(ModuleIndex_t *index);
+
+#endif // MODINDEX_H
@@ -0,0 +1,420 @@
+/**
+ * @file output.c
+ * @brief Asynchronous output: SPSC record ring drained by a writer thread
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "jsonl.h"
+
+#define CACHE_LINE 64
+
+// Consumer backoff while the ring is empty
+#define IDLE_SLEEP_MIN_NS 20000
+#define IDLE_SLEEP_MAX_NS 1000000
+
+typedef enum
+{
+  RECORD_TEXT,
+  RECORD_LONG_TEXT,
+  RECORD_PROCESS,
+  RECORD_MODULE,
+  RECORD_THREAD_POINTER,
+  RECORD_PROCESS_PARAMS,
+  RECORD_FLUSH,
+  RECORD_STOP
+} record_type_t;
+
+typedef struct OutputRecord_t
+{
+  record_type_t type;
+  vmi_pid_t pid;
+  uint32_t value; // module size, EPROCESS offset or environment length
+  addr_t address;
+  union
+  {
+    struct
+    {
+      char process[MAX_PROC_NAME];
+      char name[MAX_MODULE_NAME]; // module or owner name
+    } item;
+    struct
+    {
+      char process[MAX_PROC_NAME];
+      char *strings; // image path, command line, directory, environment; freed by the writer
+    } params;
+    char text[OUTPUT_TEXT_LEN];
+    char *long_text; // a line that did not fit in text; freed by the writer
+  };
+} OutputRecord_t;
+
+// Producer and consumer indices live on separate cache lines
+typedef struct OutputRing_t
+{
+  size_t head __attribute__((aligned(CACHE_LINE))); // next slot the producer fills
+  size_t tail __attribute__((aligned(CACHE_LINE))); // next slot the consumer drains
+  size_t stalls __attribute__((aligned(CACHE_LINE)));
+  OutputRecord_t slots[OUTPUT_RING_SLOTS];
+} OutputRing_t;
+
+static OutputRing_t g_ring;
+static pthread_t g_thread;
+static int g_started = 0;
+static int g_jsonl_enabled = 0;
+static JsonlWriter_t g_writer;
+
+static void copy_name(char *dst, size_t len, const char *src)
+{
+  strncpy(dst, src ? src : "", len - 1);
+  dst[len - 1] = '\0';
+}
+
+/**
+ * @brief Claim the next free slot, waiting for the consumer if the ring is full
+ */
+static OutputRecord_t *ring_reserve(void)
+{
+  size_t head = g_ring.head;
+
+  if (head - __atomic_load_n(&g_ring.tail, __ATOMIC_ACQUIRE) == OUTPUT_RING_SLOTS)
+  {
+    g_ring.stalls++;
+    while (head - __atomic_load_n(&g_ring.tail, __ATOMIC_ACQUIRE) == OUTPUT_RING_SLOTS)
+    {
+      sched_yield();
+    }
+  }
+  return &g_ring.slots[head & (OUTPUT_RING_SLOTS - 1)];
+}
+
+static void ring_publish(void)
+{
+  __atomic_store_n(&g_ring.head, g_ring.head + 1, __ATOMIC_RELEASE);
+}
+
+static void write_record(const OutputRecord_t *record);
+
+/**
+ * @brief Hand a filled slot to the output thread, or write it inline before start
+ */
+static void commit(OutputRecord_t *record)
+{
+  if (g_started)
+  {
+    ring_publish();
+  }
+  else
+  {
+    write_record(record);
+  }
+}
+
+static void write_params(const OutputRecord_t *record)
+{
+  const char *image_path = record->params.strings;
+  const char *command_line = image_path + strlen(image_path) + 1;
+  const char *directory = command_line + strlen(command_line) + 1;
+  const char *environment = directory + strlen(directory) + 1;
+
+  if (g_jsonl_enabled)
+  {
+    jsonl_begin(&g_writer, "process_params");
+    jsonl_i64(&g_writer, "pid", record->pid);
+    jsonl_str(&g_writer, "process", record->params.process);
+    jsonl_str(&g_writer, "image_path", image_path);
+    jsonl_str(&g_writer, "command_line", command_line);
+    jsonl_str(&g_writer, "current_directory", directory);
+    if (record->value)
+    {
+      jsonl_str_list(&g_writer, "environment", environment, record->value);
+    }
+    jsonl_end(&g_writer);
+    return;
+  }
+
+  printf("    Image:       %s\n", image_path);
+  printf("    Command:     %s\n", command_line);
+  printf("    Directory:   %s\n", directory);
+  if (record->value)
+  {
+    size_t variables = 0;
+    for (uint32_t i = 0; i < record->value; i++)
+    {
+      variables += !environment[i];
+    }
+    printf("    Environment: %zu variables\n", variables);
+  }
+}
+
+static void write_record(const OutputRecord_t *record)
+{
+  switch (record->type)
+  {
+  case RECORD_TEXT:
+    fputs(record->text, stdout);
+    break;
+  case RECORD_LONG_TEXT:
+    fputs(record->long_text, stdout);
+    free(record->long_text);
+    break;
+  case RECORD_PROCESS:
+    if (g_jsonl_enabled)
+    {
+      jsonl_begin(&g_writer, "process");
+      jsonl_i64(&g_writer, "pid", record->pid);
+      jsonl_str(&g_writer, "name", record->item.process);
+      jsonl_hex(&g_writer, "eprocess", record->address);
+      jsonl_end(&g_writer);
+    }
+    else
+    {
+      printf("[%5d] %-20s (EPROCESS: 0x%lx)\n", record->pid, record->item.process, record->address);
+    }
+    break;
+  case RECORD_MODULE:
+    if (g_jsonl_enabled)
+    {
+      jsonl_begin(&g_writer, "module");
+      jsonl_i64(&g_writer, "pid", record->pid);
+      jsonl_str(&g_writer, "process", record->item.process);
+      jsonl_str(&g_writer, "name", record->item.name);
+      jsonl_hex(&g_writer, "base", record->address);
+      jsonl_u64(&g_writer, "size", record->value);
+      jsonl_end(&g_writer);
+    }
+    else
+    {
+      printf("    0x%016lx %-24s (%u KiB)\n", record->address, record->item.name, record->value / 1024);
+    }
+    break;
+  case RECORD_THREAD_POINTER:
+    if (g_jsonl_enabled)
+    {
+      jsonl_begin(&g_writer, "thread_pointer");
+      jsonl_i64(&g_writer, "pid", record->pid);
+      jsonl_str(&g_writer, "process", record->item.process);
+      jsonl_u64(&g_writer, "offset", record->value);
+      jsonl_hex(&g_writer, "pointer", record->address);
+      jsonl_str(&g_writer, "owner", record->item.name);
+      jsonl_end(&g_writer);
+    }
+    else
+    {
+      printf("    Thread-related pointer at +0x%x: 0x%lx%s%s\n", record->value, record->address,
+             record->item.name[0] ? " in " : "", record->item.name);
+    }
+    break;
+  case RECORD_PROCESS_PARAMS:
+    write_params(record);
+    free(record->params.strings);
+    break;
+  case RECORD_FLUSH:
+  case RECORD_STOP:
+    if (g_jsonl_enabled)
+    {
+      jsonl_flush(&g_writer);
+    }
+    fflush(stdout);
+    break;
+  }
+}
+
+static void *output_thread(void *arg)
+{
+  long sleep_ns = IDLE_SLEEP_MIN_NS;
+  (void)arg;
+
+  for (;;)
+  {
+    size_t tail = g_ring.tail;
+    if (tail == __atomic_load_n(&g_ring.head, __ATOMIC_ACQUIRE))
+    {
+      // Idle: let a terminal see what we have, then back off
+      fflush(stdout);
+      struct timespec ts = {0, sleep_ns};
+      nanosleep(&ts, NULL);
+      sleep_ns = (sleep_ns * 2 < IDLE_SLEEP_MAX_NS) ? sleep_ns * 2 : IDLE_SLEEP_MAX_NS;
+      continue;
+    }
+    sleep_ns = IDLE_SLEEP_MIN_NS;
+
+    const OutputRecord_t *record = &g_ring.slots[tail & (OUTPUT_RING_SLOTS - 1)];
+    record_type_t type = record->type;
+    write_record(record);
+    __atomic_store_n(&g_ring.tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (type == RECORD_STOP)
+    {
+      return NULL;
+    }
+  }
+}
+
+demo_error_t output_start(int jsonl_fd)
+{
+  if (jsonl_fd >= 0)
+  {
+    if (0 != jsonl_init(&g_writer, jsonl_fd, JSONL_DEFAULT_BUFFER))
+    {
+      return DEMO_ERROR_MEMORY;
+    }
+    g_jsonl_enabled = 1;
+  }
+
+  if (0 != pthread_create(&g_thread, NULL, output_thread, NULL))
+  {
+    return DEMO_ERROR_INIT;
+  }
+  g_started = 1;
+  return DEMO_SUCCESS;
+}
+
+void output_stop(void)
+{
+  if (g_started)
+  {
+    ring_reserve()->type = RECORD_STOP;
+    ring_publish();
+    pthread_join(g_thread, NULL);
+    g_started = 0;
+  }
+
+  if (g_jsonl_enabled)
+  {
+    jsonl_free(&g_writer);
+    close(g_writer.fd);
+    g_jsonl_enabled = 0;
+  }
+  fflush(stdout);
+}
+
+int output_jsonl(void)
+{
+  return g_jsonl_enabled;
+}
+
+void output_text(const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+
+  if (!g_started)
+  {
+    vprintf(fmt, args);
+  }
+  else
+  {
+    OutputRecord_t *record = ring_reserve();
+    va_list again;
+    va_copy(again, args);
+    record->type = RECORD_TEXT;
+    int len = vsnprintf(record->text, sizeof(record->text), fmt, args);
+
+    // Too long for the slot: carry a heap copy rather than lose the tail and its newline
+    char *text = (len >= (int)sizeof(record->text)) ? malloc((size_t)len + 1) : NULL;
+    if (text)
+    {
+      vsnprintf(text, (size_t)len + 1, fmt, again);
+      record->type = RECORD_LONG_TEXT;
+      record->long_text = text;
+    }
+    va_end(again);
+    ring_publish();
+  }
+  va_end(args);
+}
+
+void output_process(vmi_pid_t pid, const char *name, addr_t eprocess)
+{
+  OutputRecord_t *record = ring_reserve();
+  record->type = RECORD_PROCESS;
+  record->pid = pid;
+  record->address = eprocess;
+  copy_name(record->item.process, sizeof(record->item.process), name);
+
+  commit(record);
+}
+
+void output_module(vmi_pid_t pid, const char *process, const char *name, addr_t base, uint32_t size)
+{
+  OutputRecord_t *record = ring_reserve();
+  record->type = RECORD_MODULE;
+  record->pid = pid;
+  record->value = size;
+  record->address = base;
+  copy_name(record->item.process, sizeof(record->item.process), process);
+  copy_name(record->item.name, sizeof(record->item.name), name);
+
+  commit(record);
+}
+
+void output_process_params(vmi_pid_t pid, const char *process, const char *image_path,
+                           const char *command_line, const char *current_directory,
+                           const char *environment, size_t environment_len)
+{
+  size_t lengths[3] = {strlen(image_path) + 1, strlen(command_line) + 1, strlen(current_directory) + 1};
+  char *strings = malloc(lengths[0] + lengths[1] + lengths[2] + environment_len + 1);
+  if (!strings)
+  {
+    return;
+  }
+
+  char *p = strings;
+  memcpy(p, image_path, lengths[0]);
+  p += lengths[0];
+  memcpy(p, command_line, lengths[1]);
+  p += lengths[1];
+  memcpy(p, current_directory, lengths[2]);
+  p += lengths[2];
+  memcpy(p, environment, environment_len);
+  p[environment_len] = '\0';
+
+  OutputRecord_t *record = ring_reserve();
+  record->type = RECORD_PROCESS_PARAMS;
+  record->pid = pid;
+  record->value = (uint32_t)environment_len;
+  copy_name(record->params.process, sizeof(record->params.process), process);
+  record->params.strings = strings;
+
+  commit(record);
+}
+
+void output_thread_pointer(vmi_pid_t pid, const char *process, uint32_t offset, addr_t pointer,
+                           const char *owner)
+{
+  OutputRecord_t *record = ring_reserve();
+  record->type = RECORD_THREAD_POINTER;
+  record->pid = pid;
+  record->value = offset;
+  record->address = pointer;
+  copy_name(record->item.process, sizeof(record->item.process), process);
+  copy_name(record->item.name, sizeof(record->item.name), owner);
+
+  commit(record);
+}
+
+void output_flush(void)
+{
+  if (g_started)
+  {
+    ring_reserve()->type = RECORD_FLUSH;
+    ring_publish();
+  }
+  else
+  {
+    fflush(stdout);
+  }
+}
+
+size_t output_stalls(void)
+{
+  return g_ring.stalls;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file output.h
+ * @brief Asynchronous output: SPSC record ring drained by a writer thread
+ *
+ * The introspection thread only copies fixed-size records into a
+ * single-producer/single-consumer ring; formatting (text or JSON Lines)
+ * and the write() calls happen on a dedicated output thread. Process
+ * parameters are the exception: their strings are unbounded, so the
+ * record carries one heap copy that the output thread frees. Text lines
+ * longer than OUTPUT_TEXT_LEN are carried the same way. A slow
+ * stdout or pipe reader therefore backs up the ring instead of the sweep.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "vmi_demo.h"
+
+#define OUTPUT_RING_SLOTS 8192 // power of two; roughly one busy sweep of records
+#define OUTPUT_TEXT_LEN 256
+
+/**
+ * @brief Start the output thread
+ * @param jsonl_fd Descriptor for JSON Lines records, or -1 for text mode
+ */
+demo_error_t output_start(int jsonl_fd);
+
+/**
+ * @brief Drain everything queued, stop the thread and close the JSON stream
+ */
+void output_stop(void);
+
+/**
+ * @brief True when records are emitted as JSON Lines
+ */
+int output_jsonl(void);
+
+/**
+ * @brief Queue a human-readable line (written directly if the thread is not running)
+ */
+void output_text(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+void output_process(vmi_pid_t pid, const char *name, addr_t eprocess);
+void output_module(vmi_pid_t pid, const char *process, const char *name, addr_t base, uint32_t size);
+void output_thread_pointer(vmi_pid_t pid, const char *process, uint32_t offset, addr_t pointer,
+                           const char *owner);
+
+/**
+ * @brief Queue a process's parameters; @p environment holds @p environment_len bytes of
+ *        NUL-terminated entries, 0 when not read
+ */
+void output_process_params(vmi_pid_t pid, const char *process, const char *image_path,
+                           const char *command_line, const char *current_directory,
+                           const char *environment, size_t environment_len);
+
+/**
+ * @brief Ask the output thread to flush its buffers (end of a sweep)
+ */
+void output_flush(void);
+
+/**
+ * @brief Number of times the producer found the ring full and had to wait
+ */
+size_t output_stalls(void);
+
+#endif // OUTPUT_H
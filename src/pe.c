@@ -0,0 +1,147 @@
+/**
+ * @file pe.c
+ * @brief Minimal PE header parsing for in-memory kernel images
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pe.h"
+
+#define DOS_E_LFANEW 0x3c
+#define NT_SIGNATURE 0x00004550 // "PE\0\0"
+#define FILE_NUMBER_OF_SECTIONS 0x02
+#define FILE_SIZE_OF_OPTIONAL_HEADER 0x10
+#define FILE_HEADER_SIZE 0x14
+#define SECTION_HEADER_SIZE 0x28
+#define OPTIONAL_MAGIC_PE32 0x10b
+#define OPTIONAL_MAGIC_PE32_PLUS 0x20b
+#define DATA_DIRECTORY_PE32 0x60
+#define DATA_DIRECTORY_PE32_PLUS 0x70
+#define DATA_DIRECTORY_DEBUG 6
+#define DEBUG_DIRECTORY_SIZE 0x1c
+#define DEBUG_TYPE_CODEVIEW 2
+
+static uint16_t rd16(const uint8_t *p)
+{
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/**
+ * @brief Offset of the NT headers, or 0 if @p header is not a PE image
+ */
+static uint32_t nt_headers(const uint8_t *header, size_t header_len)
+{
+  if (header_len < 0x40 || header[0] != 'M' || header[1] != 'Z')
+  {
+    return 0;
+  }
+
+  uint32_t nt = rd32(header + DOS_E_LFANEW);
+  if (nt == 0 || nt > header_len - 4 - FILE_HEADER_SIZE || rd32(header + nt) != NT_SIGNATURE)
+  {
+    return 0;
+  }
+  return nt;
+}
+
+int pe_parse_sections(const uint8_t *header, size_t header_len,
+                      PeSection_t *sections, int max_sections)
+{
+  uint32_t nt = nt_headers(header, header_len);
+  if (!nt)
+  {
+    return -1;
+  }
+
+  const uint8_t *file_header = header + nt + 4;
+  uint16_t count = rd16(file_header + FILE_NUMBER_OF_SECTIONS);
+  size_t table = nt + 4 + FILE_HEADER_SIZE + rd16(file_header + FILE_SIZE_OF_OPTIONAL_HEADER);
+
+  int parsed = 0;
+  for (uint16_t i = 0; i < count && parsed < max_sections; i++)
+  {
+    size_t off = table + (size_t)i * SECTION_HEADER_SIZE;
+    if (off + SECTION_HEADER_SIZE > header_len)
+    {
+      break;
+    }
+
+    const uint8_t *raw = header + off;
+    PeSection_t *section = &sections[parsed++];
+    memcpy(section->name, raw, 8);
+    section->name[8] = '\0';
+    section->size = rd32(raw + 0x08); // VirtualSize
+    section->rva = rd32(raw + 0x0c);
+    section->characteristics = rd32(raw + 0x24);
+  }
+
+  return parsed;
+}
+
+int pe_debug_directory(const uint8_t *header, size_t header_len, uint32_t *rva, uint32_t *size)
+{
+  uint32_t nt = nt_headers(header, header_len);
+  if (!nt)
+  {
+    return -1;
+  }
+
+  size_t optional = nt + 4 + FILE_HEADER_SIZE;
+  if (optional + 2 > header_len)
+  {
+    return -1;
+  }
+
+  uint16_t magic = rd16(header + optional);
+  size_t directories = optional + ((magic == OPTIONAL_MAGIC_PE32_PLUS) ? DATA_DIRECTORY_PE32_PLUS
+                                                                      : DATA_DIRECTORY_PE32);
+  size_t entry = directories + DATA_DIRECTORY_DEBUG * 8;
+  if ((magic != OPTIONAL_MAGIC_PE32 && magic != OPTIONAL_MAGIC_PE32_PLUS) || entry + 8 > header_len)
+  {
+    return -1;
+  }
+
+  *rva = rd32(header + entry);
+  *size = rd32(header + entry + 4);
+  return (*rva && *size) ? 0 : -1;
+}
+
+int pe_find_codeview(const uint8_t *directory, size_t directory_len, uint32_t *rva, uint32_t *size)
+{
+  for (size_t off = 0; off + DEBUG_DIRECTORY_SIZE <= directory_len; off += DEBUG_DIRECTORY_SIZE)
+  {
+    const uint8_t *entry = directory + off;
+    if (rd32(entry + 0x0c) == DEBUG_TYPE_CODEVIEW)
+    {
+      *size = rd32(entry + 0x10);
+      *rva = rd32(entry + 0x14); // AddressOfRawData
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int pe_parse_rsds(const uint8_t *record, size_t record_len, char guid[PE_GUID_LEN], uint32_t *age)
+{
+  if (record_len < 24 || memcmp(record, "RSDS", 4) != 0)
+  {
+    return -1;
+  }
+
+  // Data1..3 are little-endian integers, Data4 is printed byte by byte
+  const uint8_t *g = record + 4;
+  snprintf(guid, PE_GUID_LEN, "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X",
+           rd32(g), rd16(g + 4), rd16(g + 6), g[8], g[9], g[10], g[11], g[12], g[13], g[14], g[15]);
+  *age = rd32(record + 20);
+  return 0;
+}
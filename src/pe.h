@@ -0,0 +1,65 @@
+/**
+ * @file pe.h
+ * @brief Minimal PE header parsing for in-memory kernel images
+ */
+
+#ifndef PE_H
+#define PE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PE_MAX_SECTIONS 96
+#define PE_GUID_LEN 33 // 32 hex digits + NUL, as used in symbol server paths
+#define PE_DEBUG_DIRECTORY_MAX (0x1c * 8) // room for 8 IMAGE_DEBUG_DIRECTORY entries
+#define PE_CODEVIEW_MAX 0x100
+#define PE_RSDS_PDB_NAME 24 // NUL-terminated PDB path after signature, GUID and age
+
+#define PE_SCN_MEM_DISCARDABLE 0x02000000
+#define PE_SCN_MEM_EXECUTE 0x20000000
+#define PE_SCN_MEM_WRITE 0x80000000
+
+// One IMAGE_SECTION_HEADER, reduced to the fields we use
+typedef struct PeSection_t
+{
+  char name[9];
+  uint32_t rva;
+  uint32_t size;
+  uint32_t characteristics;
+} PeSection_t;
+
+/**
+ * @brief Parse the section table out of a mapped image header
+ * @param header First bytes of the image (normally its first page)
+ * @return Number of sections written to @p sections, or -1 if not a PE image
+ */
+int pe_parse_sections(const uint8_t *header, size_t header_len,
+                      PeSection_t *sections, int max_sections);
+
+/**
+ * @brief Locate the debug directory (IMAGE_DIRECTORY_ENTRY_DEBUG)
+ * @return 0 on success, -1 if the image has none
+ */
+int pe_debug_directory(const uint8_t *header, size_t header_len, uint32_t *rva, uint32_t *size);
+
+/**
+ * @brief Find the CodeView entry in a copy of the debug directory
+ * @return 0 on success with the RVA/size of the CodeView record, -1 otherwise
+ */
+int pe_find_codeview(const uint8_t *directory, size_t directory_len, uint32_t *rva, uint32_t *size);
+
+/**
+ * @brief Decode an RSDS CodeView record into the symbol-server GUID string and age
+ */
+int pe_parse_rsds(const uint8_t *record, size_t record_len, char guid[PE_GUID_LEN], uint32_t *age);
+
+/**
+ * @brief True for resident code: executable and not discarded after init
+ */
+static inline int pe_section_is_code(const PeSection_t *section)
+{
+  return (section->characteristics & PE_SCN_MEM_EXECUTE) &&
+         !(section->characteristics & PE_SCN_MEM_DISCARDABLE);
+}
+
+#endif // PE_H
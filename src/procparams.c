@@ -0,0 +1,215 @@
+/**
+ * @file procparams.c
+ * @brief Process parameters (command line, image path, directory, environment)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "procparams.h"
+#include "utf16.h"
+
+// x64 PEB.ProcessParameters
+#define PEB_PROCESS_PARAMETERS 0x20
+
+// x64 RTL_USER_PROCESS_PARAMETERS, unchanged from Windows Vista through 11
+#define RUPP_LENGTH 0x04
+#define RUPP_FLAGS 0x08
+#define RUPP_CURRENT_DIRECTORY 0x38 // CURDIR.DosPath
+#define RUPP_IMAGE_PATH_NAME 0x60
+#define RUPP_COMMAND_LINE 0x70
+#define RUPP_ENVIRONMENT 0x80
+#define RUPP_ENVIRONMENT_SIZE 0x3f0
+#define RUPP_MIN_SIZE 0x3f8
+#define RUPP_NORMALIZED 0x1 // string buffers are addresses, not offsets from the block
+
+#define PARAMS_FIRST_READ 4096     // the structure plus the strings of most processes
+#define PARAMS_MAX (192 * 1024)    // three UNICODE_STRINGs of at most 64 KiB
+#define ENVIRONMENT_MAX (128 * 1024)
+
+typedef struct UnicodeRef_t
+{
+  size_t bytes;
+  addr_t buffer;
+} UnicodeRef_t;
+
+static int grow(void **mem, size_t *capacity, size_t needed)
+{
+  if (needed <= *capacity)
+  {
+    return 0;
+  }
+  void *grown = realloc(*mem, needed);
+  if (!grown)
+  {
+    return -1;
+  }
+  *mem = grown;
+  *capacity = needed;
+  return 0;
+}
+
+static UnicodeRef_t unicode_at(const uint8_t *block, size_t offset, addr_t base, int normalized)
+{
+  UnicodeRef_t ref = {0, 0};
+  uint16_t length = 0;
+
+  memcpy(&length, block + offset, sizeof(length));
+  memcpy(&ref.buffer, block + offset + 8, sizeof(ref.buffer));
+  ref.bytes = length & ~1u;
+  if (ref.buffer && !normalized)
+  {
+    ref.buffer += base;
+  }
+  return ref;
+}
+
+/**
+ * @brief Transcode @p ref, from the block when it lies inside, else with its own read
+ *
+ * @p scratch holds at least ref.bytes and is 2-byte aligned.
+ */
+static const char *decode(vmi_instance_t vmi, vmi_pid_t pid, const UnicodeRef_t *ref, addr_t base,
+                          const uint8_t *block, size_t have, uint8_t *scratch, char **out)
+{
+  const char *start = *out;
+  const uint8_t *src = NULL;
+
+  if (ref->buffer >= base && ref->buffer + ref->bytes <= base + have && !((ref->buffer - base) & 1))
+  {
+    src = block + (ref->buffer - base);
+  }
+  else if (ref->buffer && ref->bytes &&
+           VMI_SUCCESS == vmi_read_va(vmi, ref->buffer, pid, ref->bytes, scratch, NULL))
+  {
+    src = scratch;
+  }
+
+  if (!src)
+  {
+    *(*out)++ = '\0';
+    return start;
+  }
+  size_t units = ref->bytes / 2;
+  *out += utf16_to_utf8((const uint16_t *)src, units, *out, UTF16_MAX_UTF8(units) + 1) + 1;
+  return start;
+}
+
+/**
+ * @brief Code units up to and including the last entry's NUL
+ */
+static size_t environment_units(const uint16_t *env, size_t units)
+{
+  size_t last = 0;
+
+  for (size_t i = 0; i < units; i++)
+  {
+    if (!env[i])
+    {
+      if (i == last)
+      {
+        break; // empty entry: end of the block
+      }
+      last = i + 1;
+    }
+  }
+  return last;
+}
+
+demo_error_t procparams_read(vmi_instance_t vmi, vmi_pid_t pid, addr_t peb, int environment,
+                             ProcessParams_t *params)
+{
+  addr_t base = 0;
+  size_t have = 0;
+  uint32_t length = 0, flags = 0;
+
+  params->environment_len = 0;
+
+  if (!peb || VMI_FAILURE == vmi_read_addr_va(vmi, peb + PEB_PROCESS_PARAMETERS, pid, &base) || !base ||
+      grow((void **)&params->raw, &params->raw_capacity, PARAMS_FIRST_READ) != 0)
+  {
+    return DEMO_ERROR_PROCESS;
+  }
+
+  // A short read still covers the structure unless its first page is missing
+  vmi_read_va(vmi, base, pid, PARAMS_FIRST_READ, params->raw, &have);
+  if (have < RUPP_MIN_SIZE)
+  {
+    return DEMO_ERROR_PROCESS;
+  }
+
+  memcpy(&length, params->raw + RUPP_LENGTH, sizeof(length));
+  memcpy(&flags, params->raw + RUPP_FLAGS, sizeof(flags));
+  if (have == PARAMS_FIRST_READ && length > have && length <= PARAMS_MAX &&
+      grow((void **)&params->raw, &params->raw_capacity, length) == 0)
+  {
+    size_t more = 0;
+    vmi_read_va(vmi, base + have, pid, length - have, params->raw + have, &more);
+    have += more;
+  }
+
+  int normalized = flags & RUPP_NORMALIZED;
+  UnicodeRef_t strings[3] = {
+      unicode_at(params->raw, RUPP_IMAGE_PATH_NAME, base, normalized),
+      unicode_at(params->raw, RUPP_COMMAND_LINE, base, normalized),
+      unicode_at(params->raw, RUPP_CURRENT_DIRECTORY, base, normalized),
+  };
+  addr_t env = 0;
+  uint64_t env_bytes = 0;
+  if (environment)
+  {
+    memcpy(&env, params->raw + RUPP_ENVIRONMENT, sizeof(env));
+    memcpy(&env_bytes, params->raw + RUPP_ENVIRONMENT_SIZE, sizeof(env_bytes));
+    if (!env)
+    {
+      env_bytes = 0;
+    }
+    else if (!env_bytes || env_bytes > ENVIRONMENT_MAX)
+    {
+      env_bytes = ENVIRONMENT_MAX;
+    }
+    env_bytes &= ~1ull;
+  }
+
+  // Strings outside the block are read after it, at an aligned offset
+  size_t scratch = (have + 15) & ~(size_t)15;
+  size_t scratch_len = env_bytes;
+  size_t units = env_bytes / 2;
+  for (size_t i = 0; i < 3; i++)
+  {
+    scratch_len = (strings[i].bytes > scratch_len) ? strings[i].bytes : scratch_len;
+    units += strings[i].bytes / 2;
+  }
+  if (grow((void **)&params->raw, &params->raw_capacity, scratch + scratch_len) != 0 ||
+      grow((void **)&params->buffer, &params->buffer_capacity, UTF16_MAX_UTF8(units) + 4) != 0)
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+
+  char *out = params->buffer;
+  const uint8_t *block = params->raw;
+  uint8_t *temp = params->raw + scratch;
+  params->image_path = decode(vmi, pid, &strings[0], base, block, have, temp, &out);
+  params->command_line = decode(vmi, pid, &strings[1], base, block, have, temp, &out);
+  params->current_directory = decode(vmi, pid, &strings[2], base, block, have, temp, &out);
+
+  params->environment = out;
+  *out = '\0';
+  if (env_bytes)
+  {
+    // The recorded size can overshoot the mapping; keep whatever was read
+    size_t got = 0;
+    vmi_read_va(vmi, env, pid, env_bytes, temp, &got);
+    size_t env_units = environment_units((const uint16_t *)temp, got / 2);
+    params->environment_len = utf16_to_utf8((const uint16_t *)temp, env_units, out,
+                                            UTF16_MAX_UTF8(env_units) + 1);
+  }
+  return DEMO_SUCCESS;
+}
+
+void procparams_free(ProcessParams_t *params)
+{
+  free(params->buffer);
+  free(params->raw);
+  memset(params, 0, sizeof(*params));
+}
@@ -0,0 +1,41 @@
+/**
+ * @file procparams.h
+ * @brief Process parameters (command line, image path, directory, environment)
+ *
+ * RTL_USER_PROCESS_PARAMETERS is one heap block holding the structure and,
+ * once normalized, the strings it points to. One read of the block usually
+ * yields every string; only strings outside it cost another read. The
+ * environment is a separate block and takes one more read.
+ */
+
+#ifndef PROCPARAMS_H
+#define PROCPARAMS_H
+
+#include "vmi_demo.h"
+
+// UTF-8 strings; they point into @ref buffer and stay valid until the next read
+typedef struct ProcessParams_t
+{
+  const char *image_path;
+  const char *command_line;
+  const char *current_directory;
+  const char *environment; // "NAME=value\0" entries
+  size_t environment_len;  // bytes, 0 when not read
+  // Reused across processes and sweeps
+  char *buffer;
+  size_t buffer_capacity;
+  uint8_t *raw;
+  size_t raw_capacity;
+} ProcessParams_t;
+
+/**
+ * @brief Read the process parameters of @p pid through its PEB
+ * @param environment Also read the environment block
+ * @return DEMO_ERROR_PROCESS if the parameters block is not readable (e.g. paged out)
+ */
+demo_error_t procparams_read(vmi_instance_t vmi, vmi_pid_t pid, addr_t peb, int environment,
+                             ProcessParams_t *params);
+
+void procparams_free(ProcessParams_t *params);
+
+#endif // PROCPARAMS_H
@@ -0,0 +1,565 @@
+/**
+ * @file proctrack.c
+ * @brief Event-driven process tracking from guest CR3 writes
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "proctrack.h"
+#include "readstats.h"
+#include "evtrace.h"
+
+// CR3 carries PCID/flag bits below the page frame and a no-flush bit on top
+#define DTB_MASK 0x000ffffffffff000ull
+#define SLOTS_MIN 64
+#define UNKNOWN_MAX 256
+#define WALK_MAX 65536 // guards against a corrupted (looping) list
+
+static size_t slot_of(addr_t dtb, size_t slot_count)
+{
+  return (size_t)(((dtb >> 12) * 0x9e3779b97f4a7c15ull) >> 32) & (slot_count - 1);
+}
+
+static long find(const ProcessTracker_t *tracker, addr_t dtb)
+{
+  if (!tracker->slot_count || !dtb)
+  {
+    return -1;
+  }
+  for (size_t slot = slot_of(dtb, tracker->slot_count);; slot = (slot + 1) & (tracker->slot_count - 1))
+  {
+    uint32_t entry = tracker->slots[slot];
+    if (!entry)
+    {
+      return -1;
+    }
+    const TrackedProcess_t *process = &tracker->processes[entry - 1];
+    if (process->dtb == dtb || process->user_dtb == dtb)
+    {
+      return (long)entry - 1;
+    }
+  }
+}
+
+static void index_dtb(ProcessTracker_t *tracker, addr_t dtb, size_t i)
+{
+  if (!dtb || find(tracker, dtb) >= 0)
+  {
+    return;
+  }
+  size_t slot = slot_of(dtb, tracker->slot_count);
+  while (tracker->slots[slot])
+  {
+    slot = (slot + 1) & (tracker->slot_count - 1);
+  }
+  tracker->slots[slot] = (uint32_t)i + 1;
+}
+
+/**
+ * @brief Rebuild the DTB index; only runs when the process set changes
+ */
+static demo_error_t reindex(ProcessTracker_t *tracker)
+{
+  // Up to two DTBs per process, at most half the slots in use
+  size_t slot_count = SLOTS_MIN;
+  while (slot_count < tracker->count * 4)
+  {
+    slot_count *= 2;
+  }
+
+  if (slot_count != tracker->slot_count)
+  {
+    uint32_t *slots = realloc(tracker->slots, slot_count * sizeof(*slots));
+    if (!slots)
+    {
+      return DEMO_ERROR_MEMORY;
+    }
+    tracker->slots = slots;
+    tracker->slot_count = slot_count;
+  }
+  memset(tracker->slots, 0, slot_count * sizeof(*tracker->slots));
+
+  for (size_t i = 0; i < tracker->count; i++)
+  {
+    index_dtb(tracker, tracker->processes[i].dtb, i);
+    index_dtb(tracker, tracker->processes[i].user_dtb, i);
+  }
+  return DEMO_SUCCESS;
+}
+
+static void notify(ProcessTracker_t *tracker, proc_change_t change, const TrackedProcess_t *process)
+{
+  if (change == PROC_CHANGE_CREATED)
+  {
+    tracker->stats.created++;
+  }
+  else
+  {
+    tracker->stats.exited++;
+    if (process->created == tracker->epoch && tracker->epoch > 0)
+    {
+      tracker->stats.short_lived++;
+    }
+  }
+  if (tracker->source.changed)
+  {
+    tracker->source.changed(tracker->source.ctx, change, process);
+  }
+}
+
+void proctrack_init(ProcessTracker_t *tracker, const ProcTrackSource_t *source)
+{
+  memset(tracker, 0, sizeof(*tracker));
+  tracker->source = *source;
+}
+
+void proctrack_free(ProcessTracker_t *tracker)
+{
+  free(tracker->processes);
+  free(tracker->slots);
+  free(tracker->unknown);
+  free(tracker->scratch);
+  memset(tracker, 0, sizeof(*tracker));
+}
+
+static demo_error_t refresh(ProcessTracker_t *tracker)
+{
+  tracker->stats.walks++;
+  if (DEMO_SUCCESS != tracker->source.walk(tracker->source.ctx, &tracker->scratch, &tracker->scratch_capacity,
+                                          &tracker->scratch_count))
+  {
+    return DEMO_ERROR_PROCESS;
+  }
+
+  char *matched = calloc(tracker->count + 1, 1);
+  if (!matched)
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+
+  // The walk is the new table; carry history over for processes already known
+  for (size_t i = 0; i < tracker->scratch_count; i++)
+  {
+    TrackedProcess_t *process = &tracker->scratch[i];
+    process->dtb &= DTB_MASK;
+    process->user_dtb &= DTB_MASK; // unshadowed processes hold 1 here
+    process->last_seen = tracker->epoch;
+    process->created = tracker->epoch;
+
+    long known = find(tracker, process->dtb);
+    if (known >= 0 && tracker->processes[known].eprocess == process->eprocess)
+    {
+      process->created = tracker->processes[known].created;
+      matched[known] = 1;
+    }
+    else
+    {
+      notify(tracker, PROC_CHANGE_CREATED, process);
+    }
+  }
+
+  for (size_t i = 0; i < tracker->count; i++)
+  {
+    if (!matched[i])
+    {
+      notify(tracker, PROC_CHANGE_EXITED, &tracker->processes[i]);
+    }
+  }
+  free(matched);
+
+  TrackedProcess_t *old = tracker->processes;
+  size_t old_capacity = tracker->capacity;
+  tracker->processes = tracker->scratch;
+  tracker->count = tracker->scratch_count;
+  tracker->capacity = tracker->scratch_capacity;
+  tracker->scratch = old;
+  tracker->scratch_count = 0;
+  tracker->scratch_capacity = old_capacity;
+  return reindex(tracker);
+}
+
+demo_error_t proctrack_refresh(ProcessTracker_t *tracker)
+{
+  evtrace_event(EVTRACE_REFRESH, 0);
+  demo_error_t result = refresh(tracker);
+  evtrace_event_end();
+  return result;
+}
+
+static void handle_cr3(ProcessTracker_t *tracker, addr_t cr3)
+{
+  addr_t dtb = cr3 & DTB_MASK;
+
+  tracker->stats.cr3_events++;
+
+  long known = find(tracker, dtb);
+  if (known >= 0)
+  {
+    tracker->processes[known].last_seen = tracker->epoch;
+    return;
+  }
+
+  for (size_t i = 0; i < tracker->unknown_count; i++)
+  {
+    if (tracker->unknown[i] == dtb)
+    {
+      return;
+    }
+  }
+
+  if (DEMO_SUCCESS == refresh(tracker) && find(tracker, dtb) >= 0)
+  {
+    return;
+  }
+
+  // Not a listed process (or the walk failed): don't walk again for it this interval
+  if (tracker->unknown_count == tracker->unknown_capacity)
+  {
+    size_t capacity = tracker->unknown_capacity ? tracker->unknown_capacity * 2 : 16;
+    addr_t *unknown = (capacity <= UNKNOWN_MAX) ? realloc(tracker->unknown, capacity * sizeof(*unknown)) : NULL;
+    if (!unknown)
+    {
+      return;
+    }
+    tracker->unknown = unknown;
+    tracker->unknown_capacity = capacity;
+  }
+  tracker->unknown[tracker->unknown_count++] = dtb;
+}
+
+void proctrack_cr3(ProcessTracker_t *tracker, addr_t cr3)
+{
+  evtrace_event(EVTRACE_CR3, cr3);
+  handle_cr3(tracker, cr3);
+  evtrace_event_end();
+}
+
+/**
+ * @brief Drop every process whose list links no longer hold, when a walk failed
+ */
+static void check_alive(ProcessTracker_t *tracker)
+{
+  size_t kept = 0;
+
+  for (size_t i = 0; i < tracker->count; i++)
+  {
+    TrackedProcess_t *process = &tracker->processes[i];
+
+    tracker->stats.checked++;
+    if (!tracker->source.alive(tracker->source.ctx, process))
+    {
+      notify(tracker, PROC_CHANGE_EXITED, process);
+      continue;
+    }
+    tracker->processes[kept++] = *process;
+  }
+
+  if (kept != tracker->count)
+  {
+    tracker->count = kept;
+    reindex(tracker);
+  }
+}
+
+void proctrack_sweep(ProcessTracker_t *tracker)
+{
+  evtrace_event(EVTRACE_SWEEP, 0);
+  // Having run during the interval says nothing about having exited since,
+  // so every exit is settled against the list while the interval is current
+  if (DEMO_SUCCESS != refresh(tracker))
+  {
+    check_alive(tracker);
+  }
+  tracker->unknown_count = 0;
+  tracker->epoch++;
+  evtrace_event_end();
+}
+
+/* ---------------------------------------------------------------------------
+ * Live guest source
+ * ------------------------------------------------------------------------- */
+
+typedef struct LiveSource_t
+{
+  vmi_instance_t vmi;
+  const KernelOffsets_t *offsets;
+  addr_t list_head;
+} LiveSource_t;
+
+static LiveSource_t g_live;
+
+static demo_error_t live_walk(void *ctx, TrackedProcess_t **list, size_t *capacity, size_t *count)
+{
+  LiveSource_t *live = ctx;
+  const KernelOffsets_t *offsets = live->offsets;
+  addr_t current = 0;
+  size_t n = 0;
+  int partial = 0;
+
+  if (VMI_FAILURE == readstats_read_addr(live->vmi, READ_SITE_LINK, live->list_head, &current))
+  {
+    return DEMO_ERROR_PROCESS;
+  }
+
+  while (current != live->list_head && n < WALK_MAX)
+  {
+    addr_t eprocess = current - offsets->eprocess_tasks;
+    uint32_t pid = 0;
+    addr_t dtb = 0;
+
+    if (n == *capacity)
+    {
+      size_t grown_capacity = *capacity ? *capacity * 2 : 256;
+      TrackedProcess_t *grown = realloc(*list, grown_capacity * sizeof(**list));
+      if (!grown)
+      {
+        return DEMO_ERROR_MEMORY;
+      }
+      *list = grown;
+      *capacity = grown_capacity;
+    }
+
+    if (VMI_SUCCESS == readstats_read_32(live->vmi, READ_SITE_PID, eprocess + offsets->eprocess_pid, &pid) &&
+        VMI_SUCCESS == readstats_read_addr(live->vmi, READ_SITE_DTB, eprocess + offsets->kprocess_pdbase, &dtb))
+    {
+      TrackedProcess_t *process = &(*list)[n++];
+      memset(process, 0, sizeof(*process));
+      process->pid = (vmi_pid_t)pid;
+      process->dtb = dtb;
+      process->eprocess = eprocess;
+      if (offsets->kprocess_user_pdbase)
+      {
+        readstats_read_addr(live->vmi, READ_SITE_DTB, eprocess + offsets->kprocess_user_pdbase,
+                            &process->user_dtb);
+      }
+
+      char *name = readstats_read_str(live->vmi, READ_SITE_NAME, eprocess + offsets->eprocess_pname);
+      snprintf(process->name, sizeof(process->name), "%s", name ? name : "?");
+      free(name);
+    }
+    else
+    {
+      partial = 1;
+      break;
+    }
+
+    if (VMI_FAILURE == readstats_read_addr(live->vmi, READ_SITE_LINK, current, &current))
+    {
+      partial = 1;
+      break;
+    }
+  }
+
+  // Only a walk back to the head with every entry read is the whole list
+  *count = n;
+  return (partial || current != live->list_head) ? DEMO_ERROR_PROCESS : DEMO_SUCCESS;
+}
+
+/**
+ * @brief Still linked: the next entry's Blink points back at this one
+ */
+static int live_alive(void *ctx, const TrackedProcess_t *process)
+{
+  LiveSource_t *live = ctx;
+  addr_t links = process->eprocess + live->offsets->eprocess_tasks;
+  addr_t next = 0, back = 0;
+
+  return VMI_SUCCESS == readstats_read_addr(live->vmi, READ_SITE_LINK, links, &next) &&
+         VMI_SUCCESS == readstats_read_addr(live->vmi, READ_SITE_LINK, next + sizeof(addr_t), &back) &&
+         back == links;
+}
+
+void proctrack_live_source(ProcTrackSource_t *source, vmi_instance_t vmi,
+                           const KernelOffsets_t *offsets, addr_t list_head)
+{
+  g_live.vmi = vmi;
+  g_live.offsets = offsets;
+  g_live.list_head = list_head;
+
+  memset(source, 0, sizeof(*source));
+  source->ctx = &g_live;
+  source->walk = live_walk;
+  source->alive = live_alive;
+}
+
+static vmi_event_t g_cr3_event;
+
+static event_response_t cr3_callback(vmi_instance_t vmi, vmi_event_t *event)
+{
+  (void)vmi;
+  proctrack_cr3(event->data, event->reg_event.value);
+  return VMI_EVENT_RESPONSE_NONE;
+}
+
+demo_error_t proctrack_events_start(vmi_instance_t vmi, ProcessTracker_t *tracker)
+{
+  memset(&g_cr3_event, 0, sizeof(g_cr3_event));
+  SETUP_REG_EVENT(&g_cr3_event, CR3, VMI_REGACCESS_W, 0, cr3_callback);
+  g_cr3_event.data = tracker;
+
+  if (VMI_FAILURE == vmi_register_event(vmi, &g_cr3_event))
+  {
+    return DEMO_ERROR_INIT;
+  }
+  return DEMO_SUCCESS;
+}
+
+void proctrack_events_stop(vmi_instance_t vmi)
+{
+  if (g_cr3_event.callback)
+  {
+    vmi_clear_event(vmi, &g_cr3_event, NULL);
+    g_cr3_event.callback = NULL;
+  }
+}
+
+/* ---------------------------------------------------------------------------
+ * Trace replay source
+ * ------------------------------------------------------------------------- */
+
+typedef struct ReplaySource_t
+{
+  TrackedProcess_t *guest; // what the guest's process list holds right now
+  size_t count;
+  size_t capacity;
+} ReplaySource_t;
+
+static demo_error_t replay_walk(void *ctx, TrackedProcess_t **list, size_t *capacity, size_t *count)
+{
+  ReplaySource_t *replay = ctx;
+
+  if (replay->count > *capacity)
+  {
+    TrackedProcess_t *grown = realloc(*list, replay->count * sizeof(**list));
+    if (!grown)
+    {
+      return DEMO_ERROR_MEMORY;
+    }
+    *list = grown;
+    *capacity = replay->count;
+  }
+  if (replay->count)
+  {
+    memcpy(*list, replay->guest, replay->count * sizeof(**list));
+  }
+  *count = replay->count;
+  return DEMO_SUCCESS;
+}
+
+static int replay_alive(void *ctx, const TrackedProcess_t *process)
+{
+  ReplaySource_t *replay = ctx;
+
+  for (size_t i = 0; i < replay->count; i++)
+  {
+    if (replay->guest[i].eprocess == process->eprocess)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void proctrack_print_change(void *ctx, proc_change_t change, const TrackedProcess_t *process)
+{
+  (void)ctx;
+  printf("  %s [%d] %s (DTB 0x%" PRIx64 ")\n", change == PROC_CHANGE_CREATED ? "+" : "-",
+         process->pid, process->name, (uint64_t)process->dtb);
+}
+
+demo_error_t proctrack_replay(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if (!file)
+  {
+    printf("ERROR: Cannot open trace '%s'\n", path);
+    return DEMO_ERROR_INIT;
+  }
+
+  ReplaySource_t replay = {0};
+  ProcTrackSource_t source = {&replay, replay_walk, replay_alive, proctrack_print_change};
+  ProcessTracker_t tracker;
+  demo_error_t result = DEMO_SUCCESS;
+  char line[256];
+  unsigned line_no = 0;
+
+  proctrack_init(&tracker, &source);
+  printf("Replaying %s\n", path);
+
+  while (result == DEMO_SUCCESS && fgets(line, sizeof(line), file))
+  {
+    char name[MAX_PROC_NAME];
+    uint64_t dtb, user_dtb = 0, eprocess;
+    int pid;
+
+    line_no++;
+    line[strcspn(line, "#\r\n")] = '\0';
+
+    if (5 == sscanf(line, " proc %d %" SCNx64 ":%" SCNx64 " %" SCNx64 " %63s", &pid, &dtb, &user_dtb,
+                    &eprocess, name) ||
+        4 == sscanf(line, " proc %d %" SCNx64 " %" SCNx64 " %63s", &pid, &dtb, &eprocess, name))
+    {
+      if (replay.count == replay.capacity)
+      {
+        replay.capacity = replay.capacity ? replay.capacity * 2 : 64;
+        TrackedProcess_t *grown = realloc(replay.guest, replay.capacity * sizeof(*grown));
+        if (!grown)
+        {
+          result = DEMO_ERROR_MEMORY;
+          break;
+        }
+        replay.guest = grown;
+      }
+      TrackedProcess_t *process = &replay.guest[replay.count++];
+      memset(process, 0, sizeof(*process));
+      process->pid = pid;
+      process->dtb = dtb;
+      process->user_dtb = user_dtb;
+      process->eprocess = eprocess;
+      snprintf(process->name, sizeof(process->name), "%s", name);
+    }
+    else if (1 == sscanf(line, " exit %d", &pid))
+    {
+      for (size_t i = 0; i < replay.count; i++)
+      {
+        if (replay.guest[i].pid == pid)
+        {
+          replay.guest[i] = replay.guest[--replay.count];
+          break;
+        }
+      }
+    }
+    else if (1 == sscanf(line, " cr3 %" SCNx64, &dtb))
+    {
+      proctrack_cr3(&tracker, dtb);
+    }
+    else if (0 == strncmp(line + strspn(line, " \t"), "sweep", 5))
+    {
+      proctrack_sweep(&tracker);
+      printf("Sweep %lu: %zu processes tracked\n", (unsigned long)tracker.epoch, tracker.count);
+    }
+    else if (line[strspn(line, " \t")])
+    {
+      printf("ERROR: %s:%u: cannot parse '%s'\n", path, line_no, line);
+      result = DEMO_ERROR_INIT;
+    }
+  }
+
+  if (result == DEMO_SUCCESS)
+  {
+    const ProcTrackStats_t *stats = &tracker.stats;
+    printf("\nCR3 events:      %lu\n", (unsigned long)stats->cr3_events);
+    printf("List walks:      %lu\n", (unsigned long)stats->walks);
+    printf("Link checks:     %lu\n", (unsigned long)stats->checked);
+    printf("Created/exited:  %lu/%lu (%lu within one interval)\n", (unsigned long)stats->created,
+           (unsigned long)stats->exited, (unsigned long)stats->short_lived);
+  }
+
+  proctrack_free(&tracker);
+  free(replay.guest);
+  fclose(file);
+  return result;
+}
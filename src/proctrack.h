@@ -0,0 +1,138 @@
+/**
+ * @file proctrack.h
+ * @brief Event-driven process tracking from guest CR3 writes
+ *
+ * Every context switch writes CR3, so a CR3-write event names the address
+ * space about to run. The tracker keeps the process table keyed by DTB: a
+ * known DTB costs one hash probe, and only an address space never seen
+ * before triggers a walk of the process list. The guest vCPU is paused
+ * while the event is handled, so even a process that exits within
+ * milliseconds is recorded.
+ *
+ * Under KVA shadowing (Windows 10 1803 and later) a process has a second,
+ * user-mode DTB that CR3 switches to on every return to user mode. Both
+ * are indexed, so either one is a hit.
+ *
+ * Exits are settled at sweep time with one walk of the process list, so
+ * a process that ran and exited within the same interval is reported in
+ * that interval. If the walk fails (or cannot read every entry back to
+ * the head), each process is checked with two
+ * reads of its list links instead.
+ *
+ * The guest side sits behind ProcTrackSource_t. The live source reads
+ * guest memory. The replay source drives the same tracker from a text
+ * trace, so the tracker can be exercised without a guest.
+ */
+
+#ifndef PROCTRACK_H
+#define PROCTRACK_H
+
+#include "vmi_demo.h"
+#include "symbols.h"
+
+typedef struct TrackedProcess_t
+{
+  addr_t dtb;
+  addr_t user_dtb; // KPROCESS.UserDirectoryTableBase, 0 when not shadowed
+  addr_t eprocess;
+  vmi_pid_t pid;
+  char name[MAX_PROC_NAME];
+  uint64_t last_seen; // sweep epoch of the last CR3 write to dtb
+  uint64_t created;   // sweep epoch it was first seen in
+} TrackedProcess_t;
+
+typedef enum
+{
+  PROC_CHANGE_CREATED,
+  PROC_CHANGE_EXITED
+} proc_change_t;
+
+typedef struct ProcTrackSource_t
+{
+  void *ctx;
+  /** Fill @p list (grown with realloc, *capacity entries) with the guest's whole process list; fails on a partial one */
+  demo_error_t (*walk)(void *ctx, TrackedProcess_t **list, size_t *capacity, size_t *count);
+  /** Nonzero while @p process is still linked into the active process list */
+  int (*alive)(void *ctx, const TrackedProcess_t *process);
+  /** Optional: told about every creation and exit */
+  void (*changed)(void *ctx, proc_change_t change, const TrackedProcess_t *process);
+} ProcTrackSource_t;
+
+typedef struct ProcTrackStats_t
+{
+  uint64_t cr3_events;
+  uint64_t walks;   // process list walks (first sighting of an address space, sweeps)
+  uint64_t checked; // processes verified by their links after a failed sweep walk
+  uint64_t created;
+  uint64_t exited;
+  uint64_t short_lived; // created and exited within one sweep interval
+} ProcTrackStats_t;
+
+typedef struct ProcessTracker_t
+{
+  ProcTrackSource_t source;
+  TrackedProcess_t *processes;
+  size_t count;
+  size_t capacity;
+  uint32_t *slots; // open-addressing index into processes, keyed by DTB
+  size_t slot_count;
+  addr_t *unknown; // DTBs a walk could not attribute; not walked for again
+  size_t unknown_count;
+  size_t unknown_capacity;
+  TrackedProcess_t *scratch; // walk buffer
+  size_t scratch_count;
+  size_t scratch_capacity;
+  uint64_t epoch;
+  ProcTrackStats_t stats;
+} ProcessTracker_t;
+
+void proctrack_init(ProcessTracker_t *tracker, const ProcTrackSource_t *source);
+void proctrack_free(ProcessTracker_t *tracker);
+
+/**
+ * @brief Reconcile the table with a fresh walk of the process list
+ */
+demo_error_t proctrack_refresh(ProcessTracker_t *tracker);
+
+/**
+ * @brief Handle a CR3 write; walks the list only for an unseen address space
+ */
+void proctrack_cr3(ProcessTracker_t *tracker, addr_t cr3);
+
+/**
+ * @brief End a sweep interval: walk the list and drop processes no longer in it
+ */
+void proctrack_sweep(ProcessTracker_t *tracker);
+
+/**
+ * @brief Source that walks the guest's process list through the read wrappers
+ * @param offsets Must outlive the source
+ * @param list_head PsActiveProcessHead VA
+ */
+void proctrack_live_source(ProcTrackSource_t *source, vmi_instance_t vmi,
+                           const KernelOffsets_t *offsets, addr_t list_head);
+
+/**
+ * @brief Deliver CR3-write events for @p tracker; needs VMI_INIT_EVENTS
+ */
+demo_error_t proctrack_events_start(vmi_instance_t vmi, ProcessTracker_t *tracker);
+void proctrack_events_stop(vmi_instance_t vmi);
+
+/**
+ * @brief Run the tracker over a recorded trace and print what it saw
+ *
+ * One event per line, '#' starts a comment:
+ *   proc PID DTB[:USERDTB] EPROCESS NAME
+ *                                the guest links a process (no event)
+ *   exit PID                     the guest unlinks it (no event)
+ *   cr3 DTB                      CR3 write
+ *   sweep                        end of a sweep interval
+ */
+demo_error_t proctrack_replay(const char *path);
+
+/**
+ * @brief ProcTrackSource_t.changed for replays: prints "  +|- [PID] NAME (DTB 0x...)"
+ */
+void proctrack_print_change(void *ctx, proc_change_t change, const TrackedProcess_t *process);
+
+#endif // PROCTRACK_H
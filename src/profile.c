@@ -0,0 +1,252 @@
+/**
+ * @file profile.c
+ * @brief Binary profile cache keyed by kernel PDB GUID
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "profile.h"
+
+typedef struct ProfileHeader_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t age;
+  char guid[40]; // ISF_GUID_LEN rounded up to keep records aligned
+  uint32_t field_count;
+  uint32_t symbol_count;
+} ProfileHeader_t;
+
+// Fields are named "Type.member", or just "Type" for a struct size
+typedef struct ProfileRecord_t
+{
+  char name[PROFILE_NAME_LEN];
+  int64_t value;
+} ProfileRecord_t;
+
+static void field_name(const IsfField_t *field, char name[PROFILE_NAME_LEN])
+{
+  if (field->field)
+  {
+    snprintf(name, PROFILE_NAME_LEN, "%s.%s", field->type, field->field);
+  }
+  else
+  {
+    snprintf(name, PROFILE_NAME_LEN, "%s", field->type);
+  }
+}
+
+static const ProfileRecord_t *find_record(const ProfileRecord_t *records, uint32_t count,
+                                          const char *name)
+{
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (0 == strncmp(records[i].name, name, PROFILE_NAME_LEN))
+    {
+      return &records[i];
+    }
+  }
+  return NULL;
+}
+
+int profile_default_dir(char *dir, size_t len)
+{
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  int written;
+
+  if (xdg && xdg[0])
+  {
+    written = snprintf(dir, len, "%s/vmi-demo", xdg);
+  }
+  else if (home && home[0])
+  {
+    written = snprintf(dir, len, "%s/.cache/vmi-demo", home);
+  }
+  else
+  {
+    return -1;
+  }
+  return (written > 0 && (size_t)written < len) ? 0 : -1;
+}
+
+int profile_path(const char *dir, const char *guid, uint32_t age, char *path, size_t len)
+{
+  int written = snprintf(path, len, "%s/%s-%u.prof", dir, guid, age);
+  return (written > 0 && (size_t)written < len) ? 0 : -1;
+}
+
+demo_error_t profile_load(const char *path, IsfRequest_t *request)
+{
+  demo_error_t result = DEMO_ERROR_MODULE;
+  struct stat st;
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return DEMO_ERROR_MODULE;
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ProfileHeader_t))
+  {
+    close(fd);
+    return DEMO_ERROR_MODULE;
+  }
+
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  const ProfileHeader_t *header = map;
+  const ProfileRecord_t *records = (const ProfileRecord_t *)(header + 1);
+  uint64_t total = (uint64_t)header->field_count + header->symbol_count;
+
+  if (memcmp(header->magic, PROFILE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != PROFILE_VERSION ||
+      header->age != request->pdb_age ||
+      strncmp(header->guid, request->pdb_guid, ISF_GUID_LEN) != 0 ||
+      sizeof(*header) + total * sizeof(*records) != (uint64_t)st.st_size)
+  {
+    goto done;
+  }
+
+  char name[PROFILE_NAME_LEN];
+  for (size_t i = 0; i < request->field_count; i++)
+  {
+    IsfField_t *field = &request->fields[i];
+    field_name(field, name);
+
+    const ProfileRecord_t *record = find_record(records, header->field_count, name);
+    field->found = (record != NULL);
+    field->value = record ? record->value : 0;
+  }
+
+  const ProfileRecord_t *symbol_records = records + header->field_count;
+  for (size_t i = 0; i < request->symbol_count; i++)
+  {
+    IsfSymbol_t *symbol = &request->symbols[i];
+    const ProfileRecord_t *record = find_record(symbol_records, header->symbol_count,
+                                                symbol->name);
+    symbol->found = (record != NULL);
+    symbol->address = record ? (uint64_t)record->value : 0;
+  }
+
+  request->bytes_parsed = (size_t)st.st_size;
+  result = DEMO_SUCCESS;
+
+done:
+  munmap(map, (size_t)st.st_size);
+  return result;
+}
+
+/**
+ * @brief mkdir -p for the cache directory
+ */
+static int make_dirs(const char *dir)
+{
+  char partial[PATH_MAX];
+  size_t len = strlen(dir);
+
+  if (len == 0 || len >= sizeof(partial))
+  {
+    return -1;
+  }
+  memcpy(partial, dir, len + 1);
+
+  for (char *p = partial + 1; *p; p++)
+  {
+    if (*p == '/')
+    {
+      *p = '\0';
+      if (mkdir(partial, 0700) != 0 && errno != EEXIST)
+      {
+        return -1;
+      }
+      *p = '/';
+    }
+  }
+  return (mkdir(partial, 0700) == 0 || errno == EEXIST) ? 0 : -1;
+}
+
+demo_error_t profile_save(const char *dir, const char *path, const IsfRequest_t *request)
+{
+  ProfileHeader_t header = {0};
+  char tmp_path[PATH_MAX];
+
+  if (!request->pdb_guid[0] || make_dirs(dir) != 0 ||
+      snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmp_path))
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  memcpy(header.magic, PROFILE_MAGIC, sizeof(header.magic));
+  header.version = PROFILE_VERSION;
+  header.age = request->pdb_age;
+  memcpy(header.guid, request->pdb_guid, ISF_GUID_LEN);
+
+  for (size_t i = 0; i < request->field_count; i++)
+  {
+    header.field_count += request->fields[i].found;
+  }
+  for (size_t i = 0; i < request->symbol_count; i++)
+  {
+    header.symbol_count += request->symbols[i].found;
+  }
+
+  size_t count = (size_t)header.field_count + header.symbol_count;
+  ProfileRecord_t *records = calloc(count ? count : 1, sizeof(*records));
+  if (!records)
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < request->field_count; i++)
+  {
+    if (request->fields[i].found)
+    {
+      field_name(&request->fields[i], records[n].name);
+      records[n++].value = request->fields[i].value;
+    }
+  }
+  for (size_t i = 0; i < request->symbol_count; i++)
+  {
+    if (request->symbols[i].found)
+    {
+      strncpy(records[n].name, request->symbols[i].name, PROFILE_NAME_LEN - 1);
+      records[n++].value = (int64_t)request->symbols[i].address;
+    }
+  }
+
+  // Write to a temporary name and rename so readers never map a partial file
+  demo_error_t result = DEMO_ERROR_MODULE;
+  FILE *file = fopen(tmp_path, "wb");
+  if (file)
+  {
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(records, sizeof(*records), count, file) == count;
+    ok = (fclose(file) == 0) && ok;
+
+    if (ok && rename(tmp_path, path) == 0)
+    {
+      result = DEMO_SUCCESS;
+    }
+    else
+    {
+      unlink(tmp_path);
+    }
+  }
+
+  free(records);
+  return result;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file profile.h
+ * @brief Binary profile cache keyed by kernel PDB GUID
+ *
+ * A profile is the resolved result of an ISF request (struct offsets,
+ * struct sizes and symbol RVAs) written as a flat array of fixed-size
+ * records. Loading one is a single mmap and a few string compares, so
+ * repeated short runs against the same kernel skip the ISF parse.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+#include "isf.h"
+
+#define PROFILE_MAGIC "VMIPROF1"
+#define PROFILE_VERSION 2 // 1: no _KPROCESS.UserDirectoryTableBase; bump whenever the requested fields change
+#define PROFILE_NAME_LEN 64
+
+/**
+ * @brief Default cache directory: $XDG_CACHE_HOME/vmi-demo or ~/.cache/vmi-demo
+ * @return 0 on success, -1 if neither variable is set
+ */
+int profile_default_dir(char *dir, size_t len);
+
+/**
+ * @brief Path of the profile for @p guid / @p age inside @p dir
+ */
+int profile_path(const char *dir, const char *guid, uint32_t age, char *path, size_t len);
+
+/**
+ * @brief Fill @p request from the cached profile at @p path
+ *
+ * The profile must have been written for the same GUID and age as the
+ * request's pdb_guid / pdb_age. Requests absent from the profile are left
+ * unresolved.
+ *
+ * @return DEMO_SUCCESS on a valid match, DEMO_ERROR_MODULE otherwise
+ */
+demo_error_t profile_load(const char *path, IsfRequest_t *request);
+
+/**
+ * @brief Write every resolved entry of @p request to @p path, creating @p dir if needed
+ */
+demo_error_t profile_save(const char *dir, const char *path, const IsfRequest_t *request);
+
+#endif // PROFILE_H
@@ -0,0 +1,226 @@
+/**
+ * @file readstats.c
+ * @brief Per-call-site guest read counters and sweep phase timings
+ */
+
+#include <string.h>
+
+#include "readstats.h"
+#include "output.h"
+#include "evtrace.h"
+
+#define SUB_BITS 3
+#define SUB_BUCKETS (1u << SUB_BITS)
+#define HISTOGRAM_BUCKETS (SUB_BUCKETS * (64 - SUB_BITS + 1))
+
+typedef struct ReadSite_t
+{
+  uint64_t count;
+  uint64_t failures;
+  uint64_t bytes;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t histogram[HISTOGRAM_BUCKETS];
+} ReadSite_t;
+
+typedef struct Phase_t
+{
+  uint64_t runs;
+  uint64_t last_ns;
+  uint64_t total_ns;
+} Phase_t;
+
+// Single writer: a relaxed load and store is enough and avoids a locked add
+#define STAT_ADD(field, value) \
+  __atomic_store_n(&(field), __atomic_load_n(&(field), __ATOMIC_RELAXED) + (value), __ATOMIC_RELAXED)
+#define STAT_SET(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+#define STAT_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+static ReadSite_t g_sites[READ_SITE_COUNT];
+static Phase_t g_phases[SWEEP_PHASE_COUNT];
+
+static const char *g_site_names[READ_SITE_COUNT] = {
+    "pid", "name", "link", "peb", "thread-probe", "dtb", "vma",
+};
+
+static const char *g_phase_names[SWEEP_PHASE_COUNT] = {
+    "drivers", "processes", "modules", "threads",
+    "integrity", "service-tables", "cpu-state", "callbacks",
+};
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Histogram bucket: exact below 8 ns, then 8 linear steps per power of two
+ */
+static unsigned bucket_of(uint64_t ns)
+{
+  if (ns < SUB_BUCKETS)
+  {
+    return (unsigned)ns;
+  }
+  unsigned shift = (unsigned)(63 - __builtin_clzll(ns)) - SUB_BITS;
+  return (shift + 1) * SUB_BUCKETS + (unsigned)((ns >> shift) - SUB_BUCKETS);
+}
+
+static uint64_t bucket_low(unsigned bucket)
+{
+  if (bucket < SUB_BUCKETS)
+  {
+    return bucket;
+  }
+  unsigned shift = bucket / SUB_BUCKETS - 1;
+  return (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
+
+static void record(read_site_t site, uint64_t start_ns, int ok, size_t bytes)
+{
+  ReadSite_t *stats = &g_sites[site];
+  uint64_t ns = now_ns() - start_ns;
+
+  STAT_ADD(stats->count, 1);
+  STAT_ADD(stats->total_ns, ns);
+  stats->histogram[bucket_of(ns)]++;
+  if (ns > stats->max_ns)
+  {
+    stats->max_ns = ns;
+  }
+  if (ok)
+  {
+    STAT_ADD(stats->bytes, bytes);
+  }
+  else
+  {
+    STAT_ADD(stats->failures, 1);
+  }
+}
+
+status_t readstats_read_32(vmi_instance_t vmi, read_site_t site, addr_t va, uint32_t *value)
+{
+  uint64_t start = now_ns();
+  status_t status = evtrace_replaying() ? evtrace_read(va, value, sizeof(*value))
+                                        : vmi_read_32_va(vmi, va, 0, value);
+  record(site, start, status == VMI_SUCCESS, sizeof(*value));
+  evtrace_capture(vmi, va, sizeof(*value));
+  return status;
+}
+
+status_t readstats_read_addr(vmi_instance_t vmi, read_site_t site, addr_t va, addr_t *value)
+{
+  uint64_t start = now_ns();
+  status_t status = evtrace_replaying() ? evtrace_read(va, value, sizeof(*value))
+                                        : vmi_read_addr_va(vmi, va, 0, value);
+  record(site, start, status == VMI_SUCCESS, sizeof(*value));
+  evtrace_capture(vmi, va, sizeof(*value));
+  return status;
+}
+
+char *readstats_read_str(vmi_instance_t vmi, read_site_t site, addr_t va)
+{
+  uint64_t start = now_ns();
+  char *str = evtrace_replaying() ? evtrace_read_str(va) : vmi_read_str_va(vmi, va, 0);
+  record(site, start, str != NULL, str ? strlen(str) + 1 : 0);
+  evtrace_capture(vmi, va, str ? strlen(str) + 1 : 1);
+  return str;
+}
+
+void readstats_phase_start(struct timespec *start)
+{
+  clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+void readstats_phase_end(sweep_phase_t phase, const struct timespec *start)
+{
+  uint64_t start_ns = (uint64_t)start->tv_sec * 1000000000ull + (uint64_t)start->tv_nsec;
+  Phase_t *stats = &g_phases[phase];
+  uint64_t ns = now_ns() - start_ns;
+
+  STAT_SET(stats->last_ns, ns);
+  stats->total_ns += ns;
+  stats->runs++;
+}
+
+void readstats_totals(read_site_t site, ReadTotals_t *totals)
+{
+  ReadSite_t *stats = &g_sites[site];
+
+  totals->count = STAT_GET(stats->count);
+  totals->failures = STAT_GET(stats->failures);
+  totals->bytes = STAT_GET(stats->bytes);
+  totals->total_ns = STAT_GET(stats->total_ns);
+}
+
+uint64_t readstats_phase_last_ns(sweep_phase_t phase)
+{
+  return STAT_GET(g_phases[phase].last_ns);
+}
+
+const char *readstats_site_name(read_site_t site)
+{
+  return g_site_names[site];
+}
+
+const char *readstats_phase_name(sweep_phase_t phase)
+{
+  return g_phase_names[phase];
+}
+
+/**
+ * @brief Upper bound of the bucket holding the @p permille-th sample
+ */
+static uint64_t percentile_ns(const ReadSite_t *stats, unsigned permille)
+{
+  uint64_t target = (stats->count * permille + 999) / 1000;
+  uint64_t seen = 0;
+
+  for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    seen += stats->histogram[i];
+    if (seen >= target)
+    {
+      uint64_t high = (i + 1 < HISTOGRAM_BUCKETS) ? bucket_low(i + 1) - 1 : UINT64_MAX;
+      return (high < stats->max_ns) ? high : stats->max_ns;
+    }
+  }
+  return stats->max_ns;
+}
+
+void readstats_report(void)
+{
+  output_text("\n============================================================\n");
+  output_text("READ STATISTICS (cumulative, latency in µs)\n");
+  output_text("============================================================\n");
+  output_text("%-14s %10s %7s %11s %8s %8s %8s %8s %9s\n", "site", "reads", "failed", "bytes",
+              "mean", "p50", "p90", "p99", "max");
+
+  for (unsigned i = 0; i < READ_SITE_COUNT; i++)
+  {
+    const ReadSite_t *stats = &g_sites[i];
+    if (!stats->count)
+    {
+      continue;
+    }
+    output_text("%-14s %10lu %7lu %11lu %8.1f %8.1f %8.1f %8.1f %9.1f\n", g_site_names[i],
+                (unsigned long)stats->count, (unsigned long)stats->failures,
+                (unsigned long)stats->bytes, (double)stats->total_ns / (double)stats->count / 1e3,
+                percentile_ns(stats, 500) / 1e3, percentile_ns(stats, 900) / 1e3,
+                percentile_ns(stats, 990) / 1e3, stats->max_ns / 1e3);
+  }
+
+  output_text("\n%-14s %10s %10s %7s\n", "phase", "last ms", "mean ms", "runs");
+  for (unsigned i = 0; i < SWEEP_PHASE_COUNT; i++)
+  {
+    const Phase_t *stats = &g_phases[i];
+    if (!stats->runs)
+    {
+      continue;
+    }
+    output_text("%-14s %10.2f %10.2f %7lu\n", g_phase_names[i], stats->last_ns / 1e6,
+                (double)stats->total_ns / (double)stats->runs / 1e6, (unsigned long)stats->runs);
+  }
+}
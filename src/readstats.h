@@ -0,0 +1,88 @@
+/**
+ * @file readstats.h
+ * @brief Per-call-site guest read counters and sweep phase timings
+ *
+ * Each instrumented read records its count, failures, bytes and latency.
+ * Latency goes into a log-linear (HDR-style) histogram: 8 sub-buckets per
+ * power of two of nanoseconds, so percentiles are within 12.5% of the
+ * true value at any scale. Counters are cumulative since start and are
+ * only written from the sweep thread; the stores are atomic so other
+ * threads (the metrics endpoint) can read them without locking.
+ */
+
+#ifndef READSTATS_H
+#define READSTATS_H
+
+#include <time.h>
+#include "vmi_demo.h"
+
+typedef enum
+{
+  READ_SITE_PID,          // EPROCESS.UniqueProcessId, task_struct.pid
+  READ_SITE_NAME,         // EPROCESS.ImageFileName, task_struct.comm
+  READ_SITE_LINK,         // EPROCESS.ActiveProcessLinks.Flink, task_struct.tasks.next
+  READ_SITE_PEB,          // EPROCESS.Peb, task_struct.mm
+  READ_SITE_THREAD_PROBE, // EPROCESS pointer-field probe
+  READ_SITE_DTB,          // KPROCESS.DirectoryTableBase
+  READ_SITE_VMA,          // mm_struct / vm_area_struct members and mapped file names
+  READ_SITE_COUNT
+} read_site_t;
+
+typedef enum
+{
+  SWEEP_PHASE_DRIVERS,
+  SWEEP_PHASE_PROCESSES,
+  SWEEP_PHASE_MODULES,
+  SWEEP_PHASE_THREADS,
+  SWEEP_PHASE_INTEGRITY,
+  SWEEP_PHASE_SERVICE_TABLES,
+  SWEEP_PHASE_CPU_STATE,
+  SWEEP_PHASE_CALLBACKS,
+  SWEEP_PHASE_COUNT
+} sweep_phase_t;
+
+typedef struct ReadTotals_t
+{
+  uint64_t count;
+  uint64_t failures;
+  uint64_t bytes;
+  uint64_t total_ns;
+} ReadTotals_t;
+
+status_t readstats_read_32(vmi_instance_t vmi, read_site_t site, addr_t va, uint32_t *value);
+status_t readstats_read_addr(vmi_instance_t vmi, read_site_t site, addr_t va, addr_t *value);
+
+/**
+ * @brief vmi_read_str_va() with accounting; the caller frees the result
+ */
+char *readstats_read_str(vmi_instance_t vmi, read_site_t site, addr_t va);
+
+/**
+ * @brief Start a phase timer
+ */
+void readstats_phase_start(struct timespec *start);
+
+/**
+ * @brief Record the time since readstats_phase_start() for @p phase
+ */
+void readstats_phase_end(sweep_phase_t phase, const struct timespec *start);
+
+/**
+ * @brief Print the read table and phase timings through the output thread
+ */
+void readstats_report(void);
+
+/**
+ * @brief Snapshot one site's counters; safe from any thread
+ */
+void readstats_totals(read_site_t site, ReadTotals_t *totals);
+
+/**
+ * @brief Duration of the most recent run of @p phase; safe from any thread
+ */
+uint64_t readstats_phase_last_ns(sweep_phase_t phase);
+
+const char *readstats_site_name(read_site_t site);
+const char *readstats_phase_name(sweep_phase_t phase);
+
+#endif // READSTATS_H
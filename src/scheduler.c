@@ -0,0 +1,48 @@
+/**
+ * @file scheduler.c
+ * @brief Adaptive sweep interval from guest change rate and a CPU budget
+ */
+
+#include "scheduler.h"
+
+#define SPEEDUP 0.5 // interval factor after a sweep with changes
+#define BACKOFF 1.5 // interval factor after a quiet sweep
+#define EWMA 0.25   // weight of the newest sweep in the moving averages
+
+void scheduler_init(SweepSchedule_t *schedule, double interval, double min_interval,
+                    double max_interval, double cpu_budget)
+{
+  schedule->min_interval = min_interval;
+  schedule->max_interval = max_interval;
+  schedule->cpu_budget = cpu_budget;
+  schedule->interval = interval;
+  schedule->sweep_cpu = -1;
+  schedule->change_rate = 0;
+}
+
+double scheduler_next(SweepSchedule_t *schedule, unsigned changes, double cpu_seconds)
+{
+  schedule->sweep_cpu = (schedule->sweep_cpu < 0)
+                            ? cpu_seconds
+                            : EWMA * cpu_seconds + (1 - EWMA) * schedule->sweep_cpu;
+  schedule->change_rate = EWMA * changes + (1 - EWMA) * schedule->change_rate;
+
+  double interval = schedule->interval * (changes ? SPEEDUP : BACKOFF);
+  if (interval < schedule->min_interval)
+  {
+    interval = schedule->min_interval;
+  }
+  if (interval > schedule->max_interval)
+  {
+    interval = schedule->max_interval;
+  }
+
+  // The budget wins over the minimum: sweeping faster would exceed it
+  if (schedule->cpu_budget > 0 && interval < schedule->sweep_cpu / schedule->cpu_budget)
+  {
+    interval = schedule->sweep_cpu / schedule->cpu_budget;
+  }
+
+  schedule->interval = interval;
+  return interval;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file scheduler.h
+ * @brief Adaptive sweep interval from guest change rate and a CPU budget
+ *
+ * A sweep that found changes halves the interval, down to the minimum. A
+ * quiet sweep lengthens it by half, up to the maximum. Busy guests are
+ * swept often and idle ones back off. On top of that the interval never
+ * drops below the one at which sweeps would use more than the CPU budget,
+ * judged by a moving average of each sweep's CPU time.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+typedef struct SweepSchedule_t
+{
+  double min_interval; // seconds
+  double max_interval;
+  double cpu_budget;   // fraction of one CPU, 0 for no limit
+  double interval;     // current interval
+  double sweep_cpu;    // moving average of CPU seconds per sweep
+  double change_rate;  // moving average of changes per sweep
+} SweepSchedule_t;
+
+void scheduler_init(SweepSchedule_t *schedule, double interval, double min_interval,
+                    double max_interval, double cpu_budget);
+
+/**
+ * @brief Account one sweep and return the interval until the next one
+ * @param changes Processes created or exited, code pages modified, ... since the last sweep
+ * @param cpu_seconds CPU time the sweep took
+ */
+double scheduler_next(SweepSchedule_t *schedule, unsigned changes, double cpu_seconds);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,109 @@
+/**
+ * @file ssdt.c
+ * @brief SSDT and shadow-SSDT hook detection
+ */
+
+#include <strings.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "ssdt.h"
+#include "symbols.h"
+#include "output.h"
+
+// x64 KSERVICE_TABLE_DESCRIPTOR layout
+#define DESCRIPTOR_SIZE 0x20
+#define DESCRIPTOR_BASE 0x00
+#define DESCRIPTOR_LIMIT 0x10
+
+static const char *const g_descriptor_symbols[] = {
+    [SERVICE_TABLE_NT] = "KeServiceDescriptorTable",
+    [SERVICE_TABLE_WIN32K] = "KeServiceDescriptorTableShadow",
+};
+
+static const char *const g_table_labels[] = {
+    [SERVICE_TABLE_NT] = "SSDT",
+    [SERVICE_TABLE_WIN32K] = "Shadow SSDT",
+};
+
+/**
+ * @brief Whether @p owner is an image allowed to implement services of @p which
+ */
+static int is_expected_owner(service_table_t which, const KernelModuleList_t *modules,
+                             const KernelModule_t *owner)
+{
+  if (!owner)
+  {
+    return 0;
+  }
+  if (which == SERVICE_TABLE_NT)
+  {
+    // The kernel image is always first in PsLoadedModuleList
+    return owner == &modules->modules[0];
+  }
+  // Win10+ splits win32k into win32k.sys, win32kbase.sys and win32kfull.sys
+  return 0 == strncasecmp(owner->name, "win32k", 6);
+}
+
+demo_error_t ssdt_check(vmi_instance_t vmi, service_table_t which, vmi_pid_t pid,
+                        const KernelModuleList_t *modules, ServiceTableState_t *state,
+                        int *from_cache)
+{
+  addr_t descriptor = 0, table = 0;
+  uint32_t count = 0;
+  int32_t entries[SSDT_MAX_ENTRIES];
+
+  *from_cache = 0;
+
+  // The shadow descriptor's second slot describes the win32k table
+  if (VMI_FAILURE == symbols_ksym2v(vmi, g_descriptor_symbols[which], &descriptor))
+  {
+    return DEMO_ERROR_MODULE;
+  }
+  descriptor += (addr_t)which * DESCRIPTOR_SIZE;
+
+  if (VMI_FAILURE == vmi_read_addr_va(vmi, descriptor + DESCRIPTOR_BASE, 0, &table) ||
+      VMI_FAILURE == vmi_read_32_va(vmi, descriptor + DESCRIPTOR_LIMIT, 0, &count) ||
+      !table || !count || count > SSDT_MAX_ENTRIES)
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  if (VMI_FAILURE == vmi_read_va(vmi, table, pid, count * sizeof(entries[0]), entries, NULL))
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  uint64_t hash = XXH3_64bits(entries, count * sizeof(entries[0]));
+  // A driver loaded or unloaded since can change which entries are hooks
+  if (state->valid && state->table == table && state->count == count && state->hash == hash &&
+      state->modules_generation == modules->index.generation)
+  {
+    *from_cache = 1;
+    return DEMO_SUCCESS;
+  }
+
+  // x64 entries are (target - table) << 4 | stack argument count
+  size_t hooks = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    addr_t target = table + (addr_t)(int64_t)(entries[i] >> 4);
+    const KernelModule_t *owner = kmodules_find(modules, target);
+
+    if (!is_expected_owner(which, modules, owner))
+    {
+      hooks++;
+      output_text("  [!] %s[0x%03x] -> 0x%lx (%s)\n", g_table_labels[which], i, target,
+             owner ? owner->name : "unknown module");
+    }
+  }
+
+  state->table = table;
+  state->count = count;
+  state->hash = hash;
+  state->modules_generation = modules->index.generation;
+  state->hooks = hooks;
+  state->valid = 1;
+  return DEMO_SUCCESS;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file ssdt.h
+ * @brief SSDT and shadow-SSDT hook detection
+ *
+ * The table is fetched in one bulk read and hashed. When the hash matches
+ * the last decoded table and the driver set is unchanged, the previous
+ * verdict is reused, so an unchanged table costs one read plus a hash
+ * compare per sweep.
+ */
+
+#ifndef SSDT_H
+#define SSDT_H
+
+#include <stddef.h>
+#include "kmodules.h"
+
+// Largest table we accept; Win11 win32k has roughly 1700 services
+#define SSDT_MAX_ENTRIES 4096
+
+typedef enum
+{
+  SERVICE_TABLE_NT = 0,    // KiServiceTable, targets must lie in ntoskrnl
+  SERVICE_TABLE_WIN32K = 1 // W32pServiceTable, targets must lie in win32k*.sys
+} service_table_t;
+
+// Cached verdict for one service table
+typedef struct ServiceTableState_t
+{
+  addr_t table;  // service table base from the descriptor
+  uint32_t count;
+  uint64_t hash; // hash of the table that produced @ref hooks
+  uint64_t modules_generation; // module index the verdict was attributed against
+  size_t hooks;
+  uint8_t valid;
+} ServiceTableState_t;
+
+/**
+ * @brief Verify every entry of a service table points into its owning image
+ * @param pid Process whose address space maps the table (session space for win32k)
+ * @param from_cache Set to 1 when the verdict was reused from @p state
+ */
+demo_error_t ssdt_check(vmi_instance_t vmi, service_table_t which, vmi_pid_t pid,
+                        const KernelModuleList_t *modules, ServiceTableState_t *state,
+                        int *from_cache);
+
+#endif // SSDT_H
@@ -0,0 +1,357 @@
+/**
+ * @file symbols.c
+ * @brief Kernel symbol and structure offset resolution
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "symbols.h"
+#include "profile.h"
+#include "pe.h"
+
+// KLDR_DATA_TABLE_ENTRY.DllBase (x64)
+#define LDR_DLL_BASE 0x30
+
+// LibVMI config names mapped to the ISF members that define them
+typedef struct OffsetName_t
+{
+  const char *config_name;
+  size_t field;
+} OffsetName_t;
+
+// Cached profiles only hold what was requested: adding a field needs a PROFILE_VERSION bump
+static IsfField_t g_fields[] = {
+    {"_EPROCESS", "ActiveProcessLinks", 0, 0},
+    {"_EPROCESS", "UniqueProcessId", 0, 0},
+    {"_EPROCESS", "ImageFileName", 0, 0},
+    {"_EPROCESS", "Peb", 0, 0},
+    {"_EPROCESS", "ThreadListHead", 0, 0},
+    {"_KPROCESS", "DirectoryTableBase", 0, 0},
+    {"_KPROCESS", "UserDirectoryTableBase", 0, 0},
+};
+
+static const OffsetName_t g_offset_names[] = {
+    {"win_tasks", 0},
+    {"win_pid", 1},
+    {"win_pname", 2},
+    {"win_peb", 3},
+    {"win_threads", 4},
+    {"win_pdbase", 5},
+    {"win_user_pdbase", 6},
+};
+
+static IsfSymbol_t g_symbols[] = {
+    {"PsActiveProcessHead", 0, 0},
+    {"PsLoadedModuleList", 0, 0},
+    {"KeServiceDescriptorTable", 0, 0},
+    {"KeServiceDescriptorTableShadow", 0, 0},
+    {"PspCreateProcessNotifyRoutine", 0, 0},
+    {"PspCreateThreadNotifyRoutine", 0, 0},
+    {"PspLoadImageNotifyRoutine", 0, 0},
+    {"CallbackListHead", 0, 0},
+};
+
+static IsfRequest_t g_request = {
+    g_fields, sizeof(g_fields) / sizeof(g_fields[0]),
+    g_symbols, sizeof(g_symbols) / sizeof(g_symbols[0]),
+    {0}, 0, 0};
+
+// Offsets for kernel builds we have verified, used when nothing else resolves them
+typedef struct KnownBuild_t
+{
+  const char *guid;
+  uint32_t age;
+  KernelOffsets_t offsets;
+} KnownBuild_t;
+
+static const KnownBuild_t g_known_builds[] = {
+    {WIN7_SP1_X64_PDB_GUID, WIN7_SP1_X64_PDB_AGE, WIN7_SP1_X64_OFFSETS},
+};
+
+// EPROCESS layouts shared by every x64 kernel in a range of NT builds, for
+// kernels whose PDB is neither cached nor in g_known_builds
+typedef struct KnownLayout_t
+{
+  uint32_t build_min;
+  uint32_t build_max;
+  const char *name;
+  KernelOffsets_t offsets;
+} KnownLayout_t;
+
+static const KnownLayout_t g_known_layouts[] = {
+    {17763, 17763, "Windows 10 1809 / Server 2019", {0x2e8, 0x2e0, 0x450, 0x3f8, 0x488, 0x28, 0x278}},
+    {19041, 19045, "Windows 10 2004-22H2", {0x448, 0x440, 0x5a8, 0x550, 0x5e0, 0x28, 0x388}},
+    {20348, 20348, "Server 2022", {0x448, 0x440, 0x5a8, 0x550, 0x5e0, 0x28, 0x388}},
+    {22000, 22631, "Windows 11 21H2-23H2", {0x448, 0x440, 0x5a8, 0x550, 0x5e0, 0x28, 0x388}},
+};
+
+static int g_loaded = 0;
+static uint32_t g_kernel_build = 0;
+static addr_t g_kernel_base = 0;
+static char g_kernel_guid[ISF_GUID_LEN];
+static uint32_t g_kernel_age = 0;
+
+/**
+ * @brief Find the kernel image base without relying on the ISF itself
+ */
+static addr_t find_kernel_base(vmi_instance_t vmi)
+{
+  addr_t base = 0;
+
+  if (VMI_SUCCESS == vmi_get_offset(vmi, "win_ntoskrnl_va", &base) && base)
+  {
+    return base;
+  }
+
+  // Any symbol LibVMI resolves on its own pins the image base
+  for (size_t i = 0; i < g_request.symbol_count; i++)
+  {
+    addr_t va = 0;
+    if (g_symbols[i].found &&
+        VMI_SUCCESS == vmi_translate_ksym2v(vmi, g_symbols[i].name, &va) && va)
+    {
+      return va - g_symbols[i].address;
+    }
+  }
+  return 0;
+}
+
+demo_error_t symbols_kernel_pdb(vmi_instance_t vmi, char guid[ISF_GUID_LEN], uint32_t *age)
+{
+  addr_t base = 0, head = 0, first = 0;
+  uint8_t header[GUEST_PAGE_SIZE];
+  uint8_t directory[PE_DEBUG_DIRECTORY_MAX];
+  uint8_t record[PE_CODEVIEW_MAX];
+  uint32_t rva = 0, size = 0;
+
+  // The kernel image is the first entry of PsLoadedModuleList
+  if ((VMI_FAILURE == vmi_get_offset(vmi, "win_ntoskrnl_va", &base) || !base) &&
+      (VMI_FAILURE == vmi_translate_ksym2v(vmi, "PsLoadedModuleList", &head) ||
+       VMI_FAILURE == vmi_read_addr_va(vmi, head, 0, &first) ||
+       VMI_FAILURE == vmi_read_addr_va(vmi, first + LDR_DLL_BASE, 0, &base) || !base))
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  if (VMI_FAILURE == vmi_read_va(vmi, base, 0, sizeof(header), header, NULL) ||
+      pe_debug_directory(header, sizeof(header), &rva, &size) != 0)
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  size = (size < sizeof(directory)) ? size : sizeof(directory);
+  if (VMI_FAILURE == vmi_read_va(vmi, base + rva, 0, size, directory, NULL) ||
+      pe_find_codeview(directory, size, &rva, &size) != 0)
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  size = (size < sizeof(record)) ? size : sizeof(record);
+  if (VMI_FAILURE == vmi_read_va(vmi, base + rva, 0, size, record, NULL) ||
+      pe_parse_rsds(record, size, guid, age) != 0)
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  g_kernel_base = base;
+  memcpy(g_kernel_guid, guid, ISF_GUID_LEN);
+  g_kernel_age = *age;
+  return DEMO_SUCCESS;
+}
+
+void symbols_set_kernel_build(uint32_t build)
+{
+  g_kernel_build = build;
+}
+
+uint32_t symbols_kernel_build(void)
+{
+  return g_kernel_build;
+}
+
+const char *symbols_layout_name(void)
+{
+  for (size_t i = 0; i < sizeof(g_known_layouts) / sizeof(g_known_layouts[0]); i++)
+  {
+    if (g_kernel_build >= g_known_layouts[i].build_min && g_kernel_build <= g_known_layouts[i].build_max)
+    {
+      return g_known_layouts[i].name;
+    }
+  }
+  return NULL;
+}
+
+int symbols_kernel_matches(const char *guid, uint32_t age)
+{
+  return g_kernel_guid[0] && g_kernel_age == age && 0 == strcmp(g_kernel_guid, guid);
+}
+
+demo_error_t symbols_load_profile(const char *dir, const char *guid, uint32_t age)
+{
+  char path[PATH_MAX];
+
+  memcpy(g_kernel_guid, guid, ISF_GUID_LEN);
+  g_kernel_age = age;
+
+  if (g_loaded && g_request.pdb_age == age && 0 == strcmp(g_request.pdb_guid, guid))
+  {
+    return DEMO_SUCCESS;
+  }
+  if (!dir || profile_path(dir, guid, age, path, sizeof(path)) != 0)
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  memcpy(g_request.pdb_guid, guid, ISF_GUID_LEN);
+  g_request.pdb_age = age;
+  if (DEMO_SUCCESS != profile_load(path, &g_request))
+  {
+    return DEMO_ERROR_MODULE;
+  }
+
+  g_loaded = 1;
+  return DEMO_SUCCESS;
+}
+
+demo_error_t symbols_save_profile(const char *dir)
+{
+  char path[PATH_MAX];
+
+  if (!g_loaded ||
+      profile_path(dir, g_request.pdb_guid, g_request.pdb_age, path, sizeof(path)) != 0)
+  {
+    return DEMO_ERROR_MODULE;
+  }
+  return profile_save(dir, path, &g_request);
+}
+
+demo_error_t symbols_load_isf(vmi_instance_t vmi, const char *path)
+{
+  demo_error_t result = isf_load(path, &g_request);
+  if (result != DEMO_SUCCESS)
+  {
+    return result;
+  }
+
+  g_loaded = 1;
+  if (!g_kernel_base)
+  {
+    g_kernel_base = find_kernel_base(vmi);
+  }
+  return DEMO_SUCCESS;
+}
+
+const IsfRequest_t *symbols_isf(void)
+{
+  return g_loaded ? &g_request : NULL;
+}
+
+status_t symbols_ksym2v(vmi_instance_t vmi, const char *symbol, addr_t *vaddr)
+{
+  if (g_kernel_base)
+  {
+    for (size_t i = 0; i < g_request.symbol_count; i++)
+    {
+      if (g_symbols[i].found && 0 == strcmp(g_symbols[i].name, symbol))
+      {
+        *vaddr = g_kernel_base + g_symbols[i].address;
+        return VMI_SUCCESS;
+      }
+    }
+  }
+  return vmi_translate_ksym2v(vmi, symbol, vaddr);
+}
+
+status_t symbols_read_addr_ksym(vmi_instance_t vmi, const char *symbol, addr_t *value)
+{
+  addr_t vaddr = 0;
+
+  if (VMI_FAILURE == symbols_ksym2v(vmi, symbol, &vaddr))
+  {
+    return VMI_FAILURE;
+  }
+  return vmi_read_addr_va(vmi, vaddr, 0, value);
+}
+
+size_t symbols_offset(vmi_instance_t vmi, const char *offset_name)
+{
+  addr_t offset = 0;
+
+  if (g_loaded)
+  {
+    for (size_t i = 0; i < sizeof(g_offset_names) / sizeof(g_offset_names[0]); i++)
+    {
+      const IsfField_t *field = &g_fields[g_offset_names[i].field];
+      if (field->found && 0 == strcmp(g_offset_names[i].config_name, offset_name))
+      {
+        return (size_t)field->value;
+      }
+    }
+  }
+
+  if (VMI_FAILURE == vmi_get_offset(vmi, offset_name, &offset))
+  {
+    // Return 0 for unknown offsets - we'll handle this gracefully
+    return 0;
+  }
+  return offset;
+}
+
+static size_t offset_or(vmi_instance_t vmi, const char *config_name, size_t fallback)
+{
+  size_t offset = symbols_offset(vmi, config_name);
+  return offset ? offset : fallback;
+}
+
+demo_error_t symbols_resolve_offsets(vmi_instance_t vmi, KernelOffsets_t *offsets)
+{
+  static const KernelOffsets_t unknown = {0};
+  const KernelOffsets_t *known = &unknown;
+
+  for (size_t i = 0; i < sizeof(g_known_layouts) / sizeof(g_known_layouts[0]); i++)
+  {
+    if (g_kernel_build >= g_known_layouts[i].build_min && g_kernel_build <= g_known_layouts[i].build_max)
+    {
+      known = &g_known_layouts[i].offsets;
+    }
+  }
+  for (size_t i = 0; i < sizeof(g_known_builds) / sizeof(g_known_builds[0]); i++)
+  {
+    if (symbols_kernel_matches(g_known_builds[i].guid, g_known_builds[i].age))
+    {
+      known = &g_known_builds[i].offsets;
+    }
+  }
+
+  offsets->eprocess_tasks = offset_or(vmi, "win_tasks", known->eprocess_tasks);
+  offsets->eprocess_pid = offset_or(vmi, "win_pid", known->eprocess_pid);
+  offsets->eprocess_pname = offset_or(vmi, "win_pname", known->eprocess_pname);
+  offsets->eprocess_peb = offset_or(vmi, "win_peb", known->eprocess_peb);
+  offsets->eprocess_threads = offset_or(vmi, "win_threads", known->eprocess_threads);
+  offsets->kprocess_pdbase = offset_or(vmi, "win_pdbase", known->kprocess_pdbase);
+  offsets->kprocess_user_pdbase = offset_or(vmi, "win_user_pdbase", known->kprocess_user_pdbase);
+
+  if (!offsets->eprocess_tasks || !offsets->eprocess_pid || !offsets->eprocess_pname)
+  {
+    return DEMO_ERROR_PROCESS;
+  }
+  return DEMO_SUCCESS;
+}
+
+int symbols_libvmi_config(const KernelOffsets_t *offsets, addr_t kernel_pa, char *config, size_t len)
+{
+  if (!offsets->eprocess_tasks || !offsets->eprocess_pid || !offsets->eprocess_pname ||
+      !offsets->kprocess_pdbase)
+  {
+    return -1;
+  }
+
+  int written = snprintf(config, len,
+                         "{ostype = \"Windows\"; win_ntoskrnl = 0x%lx; win_tasks = 0x%zx; "
+                         "win_pdbase = 0x%zx; win_pid = 0x%zx; win_pname = 0x%zx;}",
+                         kernel_pa, offsets->eprocess_tasks, offsets->kprocess_pdbase,
+                         offsets->eprocess_pid, offsets->eprocess_pname);
+  return (written > 0 && (size_t)written < len) ? 0 : -1;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file symbols.h
+ * @brief Kernel symbol and structure offset resolution
+ *
+ * Values loaded from an ISF file take precedence; anything the ISF does
+ * not provide falls back to LibVMI's own configuration and profile.
+ */
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include "vmi_demo.h"
+#include "isf.h"
+
+// Structure offsets used by the enumerators, resolved once per run
+typedef struct KernelOffsets_t
+{
+  size_t eprocess_tasks;   // _EPROCESS.ActiveProcessLinks
+  size_t eprocess_pid;     // _EPROCESS.UniqueProcessId
+  size_t eprocess_pname;   // _EPROCESS.ImageFileName
+  size_t eprocess_peb;     // _EPROCESS.Peb
+  size_t eprocess_threads; // _EPROCESS.ThreadListHead
+  size_t kprocess_pdbase;  // _KPROCESS.DirectoryTableBase
+  size_t kprocess_user_pdbase; // _KPROCESS.UserDirectoryTableBase (KVA shadow), 0 before 1803
+} KernelOffsets_t;
+
+// ntkrnlmp.pdb 3844DBB920174967BE7AA4A2C20430FA-2 (Windows 7 SP1 x64)
+#define WIN7_SP1_X64_PDB_GUID "3844DBB920174967BE7AA4A2C20430FA"
+#define WIN7_SP1_X64_PDB_AGE 2
+#define WIN7_SP1_X64_OFFSETS {0x188, 0x180, 0x2e0, 0x338, 0x308, 0x28, 0}
+
+/**
+ * @brief Read the running kernel's PDB GUID and age from its CodeView record
+ *
+ * Also records the kernel image base used to rebase symbol RVAs.
+ */
+demo_error_t symbols_kernel_pdb(vmi_instance_t vmi, char guid[ISF_GUID_LEN], uint32_t *age);
+
+/**
+ * @brief Record the running kernel's NT build number (e.g. 17763)
+ *
+ * Selects the built-in EPROCESS layout for that build when neither an ISF,
+ * a cached profile nor LibVMI provides an offset.
+ */
+void symbols_set_kernel_build(uint32_t build);
+
+/**
+ * @brief NT build number recorded by symbols_set_kernel_build(), 0 if unknown
+ */
+uint32_t symbols_kernel_build(void);
+
+/**
+ * @brief Name of the built-in layout for the recorded build, NULL if there is none
+ */
+const char *symbols_layout_name(void);
+
+/**
+ * @brief Load offsets and symbols from the cached profile for @p guid / @p age
+ *
+ * Also records @p guid / @p age as the running kernel's identity, so this
+ * may be called before LibVMI's OS initialization.
+ *
+ * @return DEMO_SUCCESS on a cache hit (or if that profile is already loaded)
+ */
+demo_error_t symbols_load_profile(const char *dir, const char *guid, uint32_t age);
+
+/**
+ * @brief Build a LibVMI config string (VMI_CONFIG_STRING) for a detected kernel
+ * @param kernel_pa Physical address of ntoskrnl, LibVMI's win_ntoskrnl
+ * @return 0 on success, -1 if an offset LibVMI needs is missing
+ */
+int symbols_libvmi_config(const KernelOffsets_t *offsets, addr_t kernel_pa, char *config, size_t len);
+
+/**
+ * @brief Cache the currently loaded ISF results as a profile under @p dir
+ */
+demo_error_t symbols_save_profile(const char *dir);
+
+/**
+ * @brief Load the tool's symbol and offset set from an ISF file
+ *
+ * Symbol RVAs are rebased on the running kernel's image base, which is
+ * taken from LibVMI (win_ntoskrnl_va) or derived from a symbol LibVMI
+ * can already resolve.
+ */
+demo_error_t symbols_load_isf(vmi_instance_t vmi, const char *path);
+
+/**
+ * @brief Requests and results of the last ISF load, or NULL if none was loaded
+ */
+const IsfRequest_t *symbols_isf(void);
+
+/**
+ * @brief Resolve a kernel symbol to its virtual address
+ */
+status_t symbols_ksym2v(vmi_instance_t vmi, const char *symbol, addr_t *vaddr);
+
+/**
+ * @brief Read the pointer stored at a kernel symbol
+ */
+status_t symbols_read_addr_ksym(vmi_instance_t vmi, const char *symbol, addr_t *value);
+
+/**
+ * @brief True if symbols_kernel_pdb() identified the running kernel as @p guid / @p age
+ */
+int symbols_kernel_matches(const char *guid, uint32_t age);
+
+/**
+ * @brief Resolve every offset in @p offsets
+ *
+ * Sources in order: ISF or cached profile, LibVMI configuration, then the
+ * built-in table for known kernel PDBs, then the one for known NT builds.
+ *
+ * @return DEMO_ERROR_PROCESS if the process list offsets are still unknown
+ */
+demo_error_t symbols_resolve_offsets(vmi_instance_t vmi, KernelOffsets_t *offsets);
+
+/**
+ * @brief Structure offset by LibVMI config name (e.g. "win_tasks"), 0 if unknown
+ */
+size_t symbols_offset(vmi_instance_t vmi, const char *offset_name);
+
+#endif // SYMBOLS_H
@@ -0,0 +1,204 @@
+/**
+ * @file test_dumpfile.c
+ * @brief Dump round trips: a sparse base, a delta against it, and a compressed dump
+ *
+ * The guest is an in-memory buffer served through stand-ins for the two
+ * LibVMI calls the dump writer uses, so no hypervisor is needed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dump.h"
+#include "dumpfile.h"
+
+#define GUEST_SIZE (16 * 1024 * 1024)
+#define GUEST_PAGES (GUEST_SIZE / GUEST_PAGE_SIZE)
+#define HOLE_START 0x800000 // 1 MiB MMIO hole
+#define HOLE_END 0x900000
+
+static uint8_t *g_guest;
+static const uint8_t g_zero[GUEST_PAGE_SIZE];
+static unsigned g_failures = 0;
+
+#define CHECK(cond, ...)                      \
+  do                                          \
+  {                                           \
+    if (!(cond))                              \
+    {                                         \
+      printf("FAIL: " __VA_ARGS__);           \
+      printf(" (%s:%d)\n", __FILE__, __LINE__); \
+      g_failures++;                           \
+    }                                         \
+  } while (0)
+
+static int in_hole(addr_t pa)
+{
+  return pa >= HOLE_START && pa < HOLE_END;
+}
+
+addr_t vmi_get_max_physical_address(vmi_instance_t vmi)
+{
+  (void)vmi;
+  return GUEST_SIZE;
+}
+
+status_t vmi_read_pa(vmi_instance_t vmi, addr_t paddr, size_t count, void *buf, size_t *bytes_read)
+{
+  size_t got = 0;
+
+  (void)vmi;
+  while (got < count && paddr + got < GUEST_SIZE && !in_hole(paddr + got))
+  {
+    got += GUEST_PAGE_SIZE - ((paddr + got) & ~GUEST_PAGE_MASK);
+  }
+  got = (got > count) ? count : got;
+  memcpy(buf, g_guest + paddr, got);
+  if (bytes_read)
+  {
+    *bytes_read = got;
+  }
+  return (got == count) ? VMI_SUCCESS : VMI_FAILURE;
+}
+
+static void fill_page(uint64_t pfn, uint32_t seed)
+{
+  uint32_t *words = (uint32_t *)(g_guest + pfn * GUEST_PAGE_SIZE);
+  for (size_t i = 0; i < GUEST_PAGE_SIZE / sizeof(*words); i++)
+  {
+    words[i] = seed * 2654435761u + (uint32_t)i;
+  }
+}
+
+/**
+ * @brief Every page of @p dump must match @p expected, holes excepted
+ * @return Pages compared
+ */
+static uint64_t compare_dump(const char *label, const char *path, const uint8_t *expected)
+{
+  DumpFile_t dump;
+  uint64_t compared = 0;
+
+  CHECK(DEMO_SUCCESS == dumpfile_open(path, &dump), "%s: open %s", label, path);
+  if (g_failures)
+  {
+    return 0;
+  }
+  CHECK(dump.page_count == GUEST_PAGES, "%s: %lu pages", label, (unsigned long)dump.page_count);
+
+  for (uint64_t pfn = 0; pfn < GUEST_PAGES; pfn++)
+  {
+    const uint8_t *page = dumpfile_page(&dump, pfn);
+    if (in_hole(pfn * GUEST_PAGE_SIZE))
+    {
+      // Compressed dumps store holes as zeros
+      CHECK(dump.kind == DUMPFILE_COMPRESSED ? page && 0 == memcmp(page, g_zero, GUEST_PAGE_SIZE) : !page,
+            "%s: hole page %lu has contents", label, (unsigned long)pfn);
+      continue;
+    }
+    CHECK(page && 0 == memcmp(page, expected + pfn * GUEST_PAGE_SIZE, GUEST_PAGE_SIZE),
+          "%s: page %lu differs", label, (unsigned long)pfn);
+    compared++;
+  }
+  dumpfile_close(&dump);
+  return compared;
+}
+
+int main(void)
+{
+  char dir[] = "/tmp/test_dumpfile.XXXXXX";
+  char base_path[64], delta_path[64], raw_path[64], zstd_path[64];
+  DumpStats_t stats;
+
+  g_guest = calloc(1, GUEST_SIZE);
+  uint8_t *before = malloc(GUEST_SIZE);
+  if (!g_guest || !before || !mkdtemp(dir))
+  {
+    printf("FAIL: setup\n");
+    return EXIT_FAILURE;
+  }
+  snprintf(base_path, sizeof(base_path), "%s/base.sparse", dir);
+  snprintf(delta_path, sizeof(delta_path), "%s/delta.sparse", dir);
+  snprintf(raw_path, sizeof(raw_path), "%s/delta.raw", dir);
+  snprintf(zstd_path, sizeof(zstd_path), "%s/guest.zst", dir);
+
+  // Distinct pages, a run of duplicates and zero pages between them
+  for (uint64_t pfn = 0; pfn < GUEST_PAGES; pfn++)
+  {
+    if (pfn % 7 == 3)
+    {
+      continue;
+    }
+    fill_page(pfn, (pfn % 11 == 5) ? 5 : (uint32_t)pfn);
+  }
+  memcpy(before, g_guest, GUEST_SIZE);
+
+  CHECK(DEMO_SUCCESS == dump_memory(NULL, base_path, DUMP_FORMAT_SPARSE, NULL, &stats), "base dump");
+  CHECK(stats.pages_zero > 0 && stats.pages_duplicate > 0, "base: %lu zero, %lu duplicate pages",
+        (unsigned long)stats.pages_zero, (unsigned long)stats.pages_duplicate);
+  CHECK(stats.pages_unreadable == (HOLE_END - HOLE_START) / GUEST_PAGE_SIZE, "base: %lu unreadable pages",
+        (unsigned long)stats.pages_unreadable);
+
+  // Change a data page, zero one, fill a zero page, duplicate an existing page
+  const uint64_t changed[] = {10, 20, 3, 40};
+  fill_page(changed[0], 0xabcdef);
+  memset(g_guest + changed[1] * GUEST_PAGE_SIZE, 0, GUEST_PAGE_SIZE);
+  fill_page(changed[2], 0x123456);
+  memcpy(g_guest + changed[3] * GUEST_PAGE_SIZE, g_guest + 41 * GUEST_PAGE_SIZE, GUEST_PAGE_SIZE);
+
+  CHECK(DEMO_SUCCESS == dump_memory(NULL, delta_path, DUMP_FORMAT_SPARSE, base_path, &stats),
+        "delta dump");
+  uint64_t readable = GUEST_PAGES - (HOLE_END - HOLE_START) / GUEST_PAGE_SIZE;
+  uint64_t stored = readable - stats.pages_unchanged - stats.pages_zero - stats.pages_duplicate;
+  CHECK(stored == 3, "delta: %lu pages stored, expected the 3 changed non-zero ones",
+        (unsigned long)stored);
+
+  // The delta reads back as the current guest, the base as the guest before
+  uint64_t compared = compare_dump("delta", delta_path, g_guest);
+  CHECK(compared == readable, "delta: %lu of %lu pages compared", (unsigned long)compared,
+        (unsigned long)readable);
+  compare_dump("base", base_path, before);
+  for (size_t i = 0; i < sizeof(changed) / sizeof(changed[0]); i++)
+  {
+    CHECK(0 != memcmp(before + changed[i] * GUEST_PAGE_SIZE, g_guest + changed[i] * GUEST_PAGE_SIZE,
+                      GUEST_PAGE_SIZE),
+          "page %lu was not changed", (unsigned long)changed[i]);
+  }
+
+  // The offline consumers go through the same chain
+  CHECK(DEMO_SUCCESS == dumpfile_info(delta_path), "info on the delta");
+  CHECK(DEMO_SUCCESS == dumpfile_export(delta_path, raw_path), "export of the delta");
+  FILE *raw = fopen(raw_path, "rb");
+  uint8_t *exported = calloc(1, GUEST_SIZE);
+  CHECK(raw && exported && fread(exported, 1, GUEST_SIZE, raw) == GUEST_SIZE, "read the raw image");
+  memset(g_guest + HOLE_START, 0, HOLE_END - HOLE_START);
+  CHECK(exported && 0 == memcmp(exported, g_guest, GUEST_SIZE), "raw image differs from the guest");
+  if (raw)
+  {
+    fclose(raw);
+  }
+
+  CHECK(DEMO_SUCCESS == dump_memory(NULL, zstd_path, DUMP_FORMAT_ZSTD, NULL, &stats), "compressed dump");
+  CHECK(stats.pages_unreadable == (HOLE_END - HOLE_START) / GUEST_PAGE_SIZE, "compressed: %lu unreadable pages",
+        (unsigned long)stats.pages_unreadable);
+  compare_dump("compressed", zstd_path, g_guest);
+
+  unlink(zstd_path);
+  unlink(raw_path);
+  unlink(delta_path);
+  unlink(base_path);
+  rmdir(dir);
+  free(exported);
+  free(before);
+  free(g_guest);
+
+  if (g_failures)
+  {
+    printf("test_dumpfile: %u check(s) failed\n", g_failures);
+    return EXIT_FAILURE;
+  }
+  printf("✓ test_dumpfile: base, delta and compressed dumps read back (%lu pages)\n", (unsigned long)compared);
+  return EXIT_SUCCESS;
+}
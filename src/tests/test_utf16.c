@@ -0,0 +1,182 @@
+/**
+ * @file test_utf16.c
+ * @brief The SSE2 and AVX2 transcoding paths against the scalar one
+ *
+ * Usage:
+ *   test_utf16         check every path this CPU supports (make check)
+ *   test_utf16 bench   also time each path on ASCII, BMP and surrogate input
+ *
+ * Inputs are ASCII, BMP text mixing ASCII with 2- and 3-byte characters,
+ * surrogate pairs and unpaired surrogates, at every length up to a few
+ * vector widths, at odd alignments and with output buffers too small to
+ * hold the result.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "utf16.h"
+
+#define MAX_UNITS 80
+#define BENCH_UNITS 4096
+#define BENCH_ROUNDS 20000
+
+typedef enum
+{
+  INPUT_ASCII,
+  INPUT_BMP,
+  INPUT_SURROGATES,
+  INPUT_COUNT
+} input_t;
+
+static const char *g_input_names[INPUT_COUNT] = {"ascii", "bmp", "surrogates"};
+static const char *g_path_names[] = {"scalar", "sse2", "avx2"};
+static unsigned g_failures = 0;
+static volatile size_t g_sink; // keeps benchmark results live
+
+static uint32_t next_random(uint32_t *state)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+/**
+ * @brief Fill @p units code units of @p kind; mostly ASCII so the fast paths get runs
+ */
+static void fill(input_t kind, uint16_t *in, size_t units, uint32_t seed)
+{
+  static const uint16_t bmp[] = {0x00e9, 0x00fc, 0x03b1, 0x0416, 0x20ac, 0x4e2d, 0x65e5, 0xfffd};
+
+  for (size_t i = 0; i < units; i++)
+  {
+    uint32_t r = next_random(&seed);
+    in[i] = (uint16_t)(0x20 + r % 0x5f);
+
+    if (kind == INPUT_BMP && r % 5 == 0)
+    {
+      in[i] = bmp[(r >> 3) % (sizeof(bmp) / sizeof(bmp[0]))];
+    }
+    else if (kind == INPUT_SURROGATES && r % 5 == 0)
+    {
+      // A pair, or now and then a lone high or low surrogate
+      if (i + 1 < units && r % 3)
+      {
+        in[i++] = (uint16_t)(0xd800 + (r >> 4) % 0x400);
+        in[i] = (uint16_t)(0xdc00 + (r >> 14) % 0x400);
+      }
+      else
+      {
+        in[i] = (uint16_t)((r & 0x100 ? 0xd800 : 0xdc00) + (r >> 4) % 0x400);
+      }
+    }
+  }
+}
+
+static void check(utf16_path_t path, input_t kind, const uint16_t *in, size_t units, size_t out_len)
+{
+  char expected[UTF16_MAX_UTF8(MAX_UNITS) + 1], got[UTF16_MAX_UTF8(MAX_UNITS) + 1];
+  size_t expected_len = utf16_to_utf8_path(UTF16_SCALAR, in, units, expected, out_len);
+  size_t got_len = utf16_to_utf8_path(path, in, units, got, out_len);
+
+  if (got_len != expected_len || 0 != memcmp(got, expected, expected_len + 1))
+  {
+    printf("FAIL: %s on %s input, %zu units into %zu bytes: %zu bytes, expected %zu\n",
+           g_path_names[path], g_input_names[kind], units, out_len, got_len, expected_len);
+    g_failures++;
+  }
+}
+
+static double bench(utf16_path_t path, const uint16_t *in, char *out)
+{
+  struct timespec start, end;
+  size_t bytes = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned round = 0; round < BENCH_ROUNDS; round++)
+  {
+    bytes += utf16_to_utf8_path(path, in, BENCH_UNITS, out, UTF16_MAX_UTF8(BENCH_UNITS) + 1);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  g_sink = bytes;
+
+  double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  return (double)BENCH_UNITS * BENCH_ROUNDS * sizeof(uint16_t) / seconds / (1024.0 * 1024.0);
+}
+
+int main(int argc, char **argv)
+{
+  utf16_path_t best = utf16_best_path();
+  unsigned cases = 0;
+
+  // Every path this build and CPU have, at every offset, length and output size
+  for (unsigned path = UTF16_SSE2; path <= (unsigned)best; path++)
+  {
+    for (unsigned kind = 0; kind < INPUT_COUNT; kind++)
+    {
+      for (size_t offset = 0; offset < 2; offset++)
+      {
+        for (size_t units = 0; units + offset <= MAX_UNITS; units++)
+        {
+          // Sized exactly, so a sanitizer build catches reads past the input
+          size_t bytes = (units + offset) * sizeof(uint16_t);
+          uint16_t *storage = malloc(bytes ? bytes : 1);
+          if (!storage)
+          {
+            printf("FAIL: setup\n");
+            return EXIT_FAILURE;
+          }
+          uint16_t *in = storage + offset;
+          fill((input_t)kind, in, units, (uint32_t)(units * 31 + kind));
+          check((utf16_path_t)path, (input_t)kind, in, units, UTF16_MAX_UTF8(units) + 1);
+          for (size_t out_len = 1; out_len <= units + 4; out_len += 3)
+          {
+            check((utf16_path_t)path, (input_t)kind, in, units, out_len);
+          }
+          free(storage);
+          cases++;
+        }
+      }
+    }
+  }
+
+  if (argc > 1 && 0 == strcmp(argv[1], "bench"))
+  {
+    uint16_t *in = malloc(BENCH_UNITS * sizeof(*in));
+    char *out = malloc(UTF16_MAX_UTF8(BENCH_UNITS) + 1);
+    if (!in || !out)
+    {
+      printf("FAIL: setup\n");
+      return EXIT_FAILURE;
+    }
+
+    printf("%-12s", "MiB/s");
+    for (unsigned path = UTF16_SCALAR; path <= (unsigned)best; path++)
+    {
+      printf(" %10s", g_path_names[path]);
+    }
+    printf("\n");
+    for (unsigned kind = 0; kind < INPUT_COUNT; kind++)
+    {
+      fill((input_t)kind, in, BENCH_UNITS, kind);
+      printf("%-12s", g_input_names[kind]);
+      for (unsigned path = UTF16_SCALAR; path <= (unsigned)best; path++)
+      {
+        printf(" %10.0f", bench((utf16_path_t)path, in, out));
+      }
+      printf("\n");
+    }
+    free(out);
+    free(in);
+  }
+
+  if (g_failures)
+  {
+    printf("test_utf16: %u check(s) failed\n", g_failures);
+    return EXIT_FAILURE;
+  }
+  printf("✓ test_utf16: %s paths match scalar on %u inputs\n",
+         best == UTF16_AVX2 ? "SSE2 and AVX2" : best == UTF16_SSE2 ? "SSE2" : "no vector", cases);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file uring.c
+ * @brief Minimal io_uring wrapper for queued file writes
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+static int sys_setup(unsigned entries, struct io_uring_params *params)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * @brief Whether the kernel implements IORING_OP_WRITE
+ *
+ * 5.1-5.5 create rings but fail every IORING_OP_WRITE with -EINVAL. The
+ * probe itself arrived in 5.6 together with the opcode, so a failed probe
+ * means no support.
+ */
+static int supports_write(int fd)
+{
+  const unsigned ops = IORING_OP_WRITE + 1;
+  struct io_uring_probe *probe = calloc(1, sizeof(*probe) + ops * sizeof(probe->ops[0]));
+  int supported = 0;
+
+  if (probe && 0 == sys_register(fd, IORING_REGISTER_PROBE, probe, ops))
+  {
+    supported = IORING_OP_WRITE <= probe->last_op && IORING_OP_WRITE < probe->ops_len &&
+                (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+  }
+  free(probe);
+  return supported;
+}
+
+int uring_init(Uring_t *ring, unsigned entries)
+{
+  struct io_uring_params params;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = -1;
+
+  int fd = sys_setup(entries, &params);
+  if (fd < 0)
+  {
+    return -errno;
+  }
+  ring->fd = fd;
+  ring->entries = params.sq_entries;
+
+  if (!supports_write(fd))
+  {
+    uring_free(ring);
+    return -EOPNOTSUPP;
+  }
+
+  ring->sq_map_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_map_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+  // Since 5.4 both rings share one mapping
+  int single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap && ring->cq_map_len > ring->sq_map_len)
+  {
+    ring->sq_map_len = ring->cq_map_len;
+  }
+
+  ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+  if (ring->sq_map == MAP_FAILED)
+  {
+    ring->sq_map = NULL;
+    goto fail;
+  }
+
+  if (single_mmap)
+  {
+    ring->cq_map = ring->sq_map;
+  }
+  else
+  {
+    ring->cq_map = mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_CQ_RING);
+    if (ring->cq_map == MAP_FAILED)
+    {
+      ring->cq_map = NULL;
+      goto fail;
+    }
+  }
+
+  ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED)
+  {
+    ring->sqes = NULL;
+    goto fail;
+  }
+
+  uint8_t *sq = ring->sq_map;
+  uint8_t *cq = ring->cq_map;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  return 0;
+
+fail:
+  {
+    int err = errno;
+    uring_free(ring);
+    return -err;
+  }
+}
+
+int uring_queue_write(Uring_t *ring, int fd, const void *buf, size_t len, off_t offset,
+                      uint64_t user_data)
+{
+  unsigned tail = *ring->sq_tail;
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+  if (tail - head == ring->entries)
+  {
+    return -1;
+  }
+
+  unsigned index = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf;
+  sqe->len = (uint32_t)len;
+  sqe->off = (uint64_t)offset;
+  sqe->user_data = user_data;
+
+  ring->sq_array[index] = index;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->pending++;
+  return 0;
+}
+
+int uring_submit(Uring_t *ring, unsigned min_complete)
+{
+  unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+
+  while (ring->pending || min_complete)
+  {
+    int submitted = sys_enter(ring->fd, ring->pending, min_complete, flags);
+    if (submitted < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -errno;
+    }
+    ring->pending -= (unsigned)submitted;
+    if (!ring->pending)
+    {
+      break;
+    }
+  }
+  return 0;
+}
+
+int uring_reap(Uring_t *ring, uint64_t *user_data, int32_t *result)
+{
+  unsigned head = *ring->cq_head;
+
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+  {
+    return 0;
+  }
+
+  const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+  *user_data = cqe->user_data;
+  *result = cqe->res;
+  __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+void uring_free(Uring_t *ring)
+{
+  if (ring->sqes)
+  {
+    munmap(ring->sqes, ring->sqes_len);
+  }
+  if (ring->cq_map && ring->cq_map != ring->sq_map)
+  {
+    munmap(ring->cq_map, ring->cq_map_len);
+  }
+  if (ring->sq_map)
+  {
+    munmap(ring->sq_map, ring->sq_map_len);
+  }
+  if (ring->fd >= 0)
+  {
+    close(ring->fd);
+  }
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file uring.h
+ * @brief Minimal io_uring wrapper for queued file writes
+ *
+ * Talks to the kernel through the raw io_uring_setup/io_uring_enter
+ * system calls so the tool does not depend on liburing. Only what the
+ * dump writer needs is covered: queue a write, submit, reap completions.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <linux/io_uring.h>
+
+typedef struct Uring_t
+{
+  int fd;
+  unsigned entries;
+
+  // Submission ring
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned pending; // queued but not yet passed to io_uring_enter
+
+  // Completion ring
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *sq_map;
+  size_t sq_map_len;
+  void *cq_map;
+  size_t cq_map_len;
+  size_t sqes_len;
+} Uring_t;
+
+/**
+ * @brief Create a ring with room for @p entries in-flight requests
+ * @return 0 on success, -errno if io_uring is unavailable, -EOPNOTSUPP if
+ *         the kernel predates IORING_OP_WRITE (before 5.6)
+ */
+int uring_init(Uring_t *ring, unsigned entries);
+
+/**
+ * @brief Queue a pwrite-style write; @p user_data comes back in the completion
+ * @return 0, or -1 if the submission queue is full
+ */
+int uring_queue_write(Uring_t *ring, int fd, const void *buf, size_t len, off_t offset,
+                      uint64_t user_data);
+
+/**
+ * @brief Submit queued requests and wait until at least @p min_complete finished
+ * @return 0 on success, -errno on failure
+ */
+int uring_submit(Uring_t *ring, unsigned min_complete);
+
+/**
+ * @brief Pop one completion if available
+ * @return 1 if @p user_data / @p result were filled, 0 if the queue is empty
+ */
+int uring_reap(Uring_t *ring, uint64_t *user_data, int32_t *result);
+
+void uring_free(Uring_t *ring);
+
+#endif // URING_H
@@ -0,0 +1,182 @@
+/**
+ * @file utf16.c
+ * @brief UTF-16LE to UTF-8 transcoding for guest strings
+ */
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "utf16.h"
+
+#define REPLACEMENT 0xfffd
+
+#if defined(__x86_64__)
+/**
+ * @brief Narrow ASCII 16 code units at a time; returns the units narrowed
+ *
+ * A block that is not all ASCII still yields its ASCII prefix; the bytes
+ * stored past it are overwritten by whatever follows. Built for AVX2
+ * whatever the compiler flags, and only called once the CPU is known to
+ * support it.
+ */
+__attribute__((target("avx2"))) static size_t ascii_run_avx2(const uint16_t *in, size_t units, char *out,
+                                                             size_t room)
+{
+  const __m256i high = _mm256_set1_epi16((short)0xff80);
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = 0;
+
+  while (i + 16 <= units && i + 16 <= room)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+    __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128((__m128i *)(out + i), bytes);
+
+    uint32_t ascii = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(v, high), zero));
+    if (ascii != 0xffffffffu)
+    {
+      return i + (size_t)__builtin_ctz(~ascii) / 2;
+    }
+    i += 16;
+  }
+  return i;
+}
+#endif
+
+#if defined(__SSE2__)
+/**
+ * @brief Narrow ASCII 8 code units at a time; returns the units narrowed
+ *
+ * Like the AVX2 loop, a mixed block yields its ASCII prefix.
+ */
+static size_t ascii_run_sse2(const uint16_t *in, size_t units, char *out, size_t room)
+{
+  const __m128i high = _mm_set1_epi16((short)0xff80);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+
+  while (i + 8 <= units && i + 8 <= room)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+    _mm_storel_epi64((__m128i *)(out + i), _mm_packus_epi16(v, v));
+
+    unsigned ascii = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high), zero));
+    if (ascii != 0xffff)
+    {
+      return i + (size_t)__builtin_ctz(~ascii) / 2;
+    }
+    i += 8;
+  }
+  return i;
+}
+#endif
+
+utf16_path_t utf16_best_path(void)
+{
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return UTF16_AVX2;
+  }
+#endif
+#if defined(__SSE2__)
+  return UTF16_SSE2;
+#else
+  return UTF16_SCALAR;
+#endif
+}
+
+size_t utf16_to_utf8_path(utf16_path_t path, const uint16_t *in, size_t units, char *out, size_t out_len)
+{
+  size_t i = 0, n = 0;
+
+  if (!out_len)
+  {
+    return 0;
+  }
+  out_len--; // room for the terminator
+
+  while (i < units)
+  {
+    // ASCII fast paths, tried only where an ASCII unit starts; the SSE2
+    // loop also takes the AVX2 loop's tail
+#if defined(__x86_64__)
+    if (path == UTF16_AVX2 && in[i] < 0x80)
+    {
+      size_t run = ascii_run_avx2(in + i, units - i, out + n, out_len - n);
+      i += run;
+      n += run;
+      if (i == units)
+      {
+        break;
+      }
+    }
+#endif
+#if defined(__SSE2__)
+    if (path != UTF16_SCALAR && in[i] < 0x80)
+    {
+      size_t run = ascii_run_sse2(in + i, units - i, out + n, out_len - n);
+      i += run;
+      n += run;
+      if (i == units)
+      {
+        break;
+      }
+    }
+#else
+    (void)path;
+#endif
+
+    uint32_t cp = in[i++];
+    if (cp >= 0xd800 && cp <= 0xdbff && i < units && in[i] >= 0xdc00 && in[i] <= 0xdfff)
+    {
+      cp = 0x10000 + ((cp - 0xd800) << 10) + (in[i++] - 0xdc00);
+    }
+    else if (cp >= 0xd800 && cp <= 0xdfff)
+    {
+      cp = REPLACEMENT;
+    }
+
+    size_t bytes = (cp < 0x80) ? 1 : (cp < 0x800) ? 2 : (cp < 0x10000) ? 3 : 4;
+    if (n + bytes > out_len)
+    {
+      break;
+    }
+    switch (bytes)
+    {
+    case 1:
+      out[n++] = (char)cp;
+      break;
+    case 2:
+      out[n++] = (char)(0xc0 | (cp >> 6));
+      out[n++] = (char)(0x80 | (cp & 0x3f));
+      break;
+    case 3:
+      out[n++] = (char)(0xe0 | (cp >> 12));
+      out[n++] = (char)(0x80 | ((cp >> 6) & 0x3f));
+      out[n++] = (char)(0x80 | (cp & 0x3f));
+      break;
+    default:
+      out[n++] = (char)(0xf0 | (cp >> 18));
+      out[n++] = (char)(0x80 | ((cp >> 12) & 0x3f));
+      out[n++] = (char)(0x80 | ((cp >> 6) & 0x3f));
+      out[n++] = (char)(0x80 | (cp & 0x3f));
+      break;
+    }
+  }
+
+  out[n] = '\0';
+  return n;
+}
+
+size_t utf16_to_utf8(const uint16_t *in, size_t units, char *out, size_t out_len)
+{
+  static int path = -1; // CPU check done once
+
+  if (path < 0)
+  {
+    path = (int)utf16_best_path();
+  }
+  return utf16_to_utf8_path((utf16_path_t)path, in, units, out, out_len);
+}
@@ -0,0 +1,53 @@
+/**
+ * @file utf16.h
+ * @brief UTF-16LE to UTF-8 transcoding for guest strings
+ *
+ * Windows keeps strings as UTF-16 and nearly all of them are ASCII, so
+ * runs of ASCII code units are narrowed 16 at a time with AVX2 or 8 at a
+ * time with SSE2; anything else takes the scalar path. The AVX2 loop is
+ * always built on x86-64 and picked at run time when the CPU has it.
+ * Unpaired surrogates become U+FFFD.
+ */
+
+#ifndef UTF16_H
+#define UTF16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Worst-case UTF-8 size of @p units code units, without the terminator
+ */
+#define UTF16_MAX_UTF8(units) ((units) * 3)
+
+typedef enum
+{
+  UTF16_SCALAR,
+  UTF16_SSE2, // x86-64 baseline
+  UTF16_AVX2,
+} utf16_path_t;
+
+/**
+ * @brief Transcode @p units code units into @p out and NUL-terminate it
+ *
+ * Output that does not fit is cut at a character boundary. Embedded NUL
+ * code units are copied, so a NUL-separated block stays one.
+ *
+ * @return Bytes written, not counting the terminator
+ */
+size_t utf16_to_utf8(const uint16_t *in, size_t units, char *out, size_t out_len);
+
+/**
+ * @brief Fastest path this build and CPU support; utf16_to_utf8() uses it
+ */
+utf16_path_t utf16_best_path(void);
+
+/**
+ * @brief utf16_to_utf8() through a given path, for tests and benchmarks
+ *
+ * @p path must not be faster than utf16_best_path(). Every path produces
+ * the same output.
+ */
+size_t utf16_to_utf8_path(utf16_path_t path, const uint16_t *in, size_t units, char *out, size_t out_len);
+
+#endif // UTF16_H
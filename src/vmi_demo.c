@@ -6,8 +6,13 @@
  *
  * Demonstrates Virtual Machine Introspection capabilities:
  * - Process enumeration
- * - Module enumeration
+ * - Module enumeration and process parameters (command line, environment)
  * - Thread enumeration
+ * - Kernel driver code integrity
+ * - SSDT / shadow SSDT hook detection
+ * - Per-vCPU IDT / GDT / LSTAR checks
+ * - Kernel notification callback enumeration
+ * - Linux guests: task list and per-task memory maps
  */
 
 #include <stdlib.h>
@@ -16,18 +21,31 @@
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pwd.h>
 #include <libvmi/libvmi.h>
 
-// Constants
-#define MAX_PROC_NAME 64
-
-// Error codes
-typedef enum
-{
-  DEMO_SUCCESS = 0,
-  DEMO_ERROR_INIT = -1,
-  DEMO_ERROR_PROCESS = -4
-} demo_error_t;
+#include "vmi_demo.h"
+#include "kmodules.h"
+#include "integrity.h"
+#include "ssdt.h"
+#include "cpustate.h"
+#include "callbacks.h"
+#include "symbols.h"
+#include "profile.h"
+#include "kdetect.h"
+#include "output.h"
+#include "dump.h"
+#include "dumpfile.h"
+#include "readstats.h"
+#include "metrics.h"
+#include "proctrack.h"
+#include "evtrace.h"
+#include "scheduler.h"
+#include "linuxos.h"
+#include "procparams.h"
 
 // Process information structure
 typedef struct ProcessInfo_t
@@ -37,377 +55,2183 @@ typedef struct ProcessInfo_t
   addr_t eprocess_addr;
 } ProcessInfo_t;
 
+// Command line options
+typedef struct Options_t
+{
+  const char *domain_name;
+  double interval;         // seconds between sweeps, 0 for a single run
+  size_t hash_page_budget; // round-robin page rechecks per sweep
+  const char *isf_path;    // Volatility3 ISF (.json/.json.xz) for offsets and symbols
+  const char *profile_dir; // binary profile cache, NULL for the default location
+  int jsonl;               // emit process/module/thread records as JSON Lines
+  const char *dump_path;   // acquire guest physical memory instead of sweeping
+  dump_format_t dump_format;
+  const char *dump_base;      // incremental sparse dump against this one
+  const char *dump_info_path; // summarize a sparse dump and exit
+  const char *dump_export;    // with dump_info_path: also expand it into this raw image
+  int read_stats;             // print read counters and phase timings after every sweep
+  const char *metrics_address; // serve Prometheus metrics here in continuous mode
+  int track_processes;         // follow process creation/exit through CR3-write events
+  const char *replay_trace;    // run the process tracker over a recorded trace and exit
+  const char *record_events;   // record tracker events and the pages they read
+  const char *replay_events;   // replay a recorded event trace and exit
+  int adaptive;                // adapt the interval to the guest's change rate
+  double interval_min;         // adaptive bounds, seconds
+  double interval_max;
+  double cpu_budget;           // fraction of one CPU sweeps may use, 0 for no limit
+  unsigned change_probe;       // skip list walks while a probe sees no change, up to this many sweeps
+  int environment;             // also extract each process's environment block
+  os_t os;                     // guest OS; VMI_OS_UNKNOWN scans for a Windows kernel first
+} Options_t;
+
+// Links sampled per change probe, besides the list head's
+#define PROBE_SAMPLES 8
+
+// EPROCESS.Peb for Windows 7 SP1 x64 when no other source provides it
+#define WIN7_X64_EPROCESS_PEB 0x338
+
 // Global VMI instance
 static vmi_instance_t g_vmi = NULL;
 
-/**
- * @brief Initialize VMI instance
- */
-static demo_error_t initialize_vmi(const char *domain_name)
+// Structure offsets; a single-build binary gets them as compile-time constants
+#ifdef KERNEL_BUILD_WIN7_SP1_X64
+static const KernelOffsets_t g_offsets = WIN7_SP1_X64_OFFSETS;
+#else
+static KernelOffsets_t g_offsets;
+#endif
+
+// State carried across sweeps in continuous mode
+static IntegrityCache_t g_integrity;
+static KernelModuleList_t g_kernel_modules;
+static KernelModuleList_t g_process_modules = {.unindexed = 1}; // listed, never looked up
+static ProcessParams_t g_params;
+static int g_read_environment = 0;
+static ServiceTableState_t g_service_tables[2];
+static ProcessTracker_t g_tracker;
+static int g_tracking = 0;
+
+// Linux guests take their own sweep; the Windows-only phases do not apply
+static int g_linux = 0;
+static LinuxOffsets_t g_linux_offsets;
+static LinuxTaskList_t g_linux_tasks;
+
+// Adaptive scheduling: changes seen by the current sweep and the process set of the last one
+typedef struct ProcessSet_t
 {
-  if (VMI_FAILURE == vmi_init_complete(&g_vmi, domain_name, VMI_INIT_DOMAINNAME,
-                                       NULL, VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL))
-  {
-    printf("ERROR: Failed to initialize VMI for domain '%s'\n", domain_name);
-    return DEMO_ERROR_INIT;
-  }
-
-  printf("✓ Successfully initialized VMI for domain: %s\n", domain_name);
-  return DEMO_SUCCESS;
-}
+  addr_t *eprocess;
+  size_t count;
+  size_t capacity;
+} ProcessSet_t;
+
+static SweepSchedule_t g_schedule;
+static unsigned g_sweep_changes = 0;
+static ProcessSet_t g_process_set[2]; // [0] this sweep, [1] the previous one
+static int g_process_sweeps = 0;
+static uint64_t g_tracked_changes = 0;
+static addr_t g_list_head = 0;      // probed between or before sweeps, 0 when not probing
+static addr_t g_head_links[2];      // Flink/Blink after the last sweep
+static double g_probe_period = 0;   // adaptive mode: probe the head this often between sweeps
+
+// Change probe: the process list as of the last full walk
+typedef struct ListProbe_t
+{
+  addr_t *nodes;      // every ActiveProcessLinks in list order, the head included
+  size_t count;
+  size_t capacity;
+  size_t head_index;
+  size_t cursor;      // next node to sample
+  int valid;          // the last walk went all the way around
+  unsigned full_every; // walk at least every this many sweeps, 0 when probing is off
+  unsigned skipped;
+  ProcessInfo_t *processes; // what the last walk printed
+  size_t process_count;
+  size_t process_capacity;
+} ListProbe_t;
+
+static ListProbe_t g_probe;
+static int g_list_unchanged = 0; // this sweep reuses the last walk
+
+// A session process (csrss.exe) whose address space maps win32k, re-resolved by every walk
+static vmi_pid_t g_session_pid = 0;
+static volatile sig_atomic_t g_running = 1;
+static volatile sig_atomic_t g_report_reads = 0; // SIGUSR1 asks for read statistics
 
 /**
- * @brief Cleanup VMI resources
+ * @brief Profile cache directory from the options, or the default location
  */
-static void cleanup_vmi(void)
+static const char *profile_cache_dir(const Options_t *options, char *dir, size_t len)
 {
-  if (g_vmi)
+  if (options->profile_dir)
   {
-    vmi_destroy(g_vmi);
-    g_vmi = NULL;
+    return options->profile_dir;
   }
+  return (0 == profile_default_dir(dir, len)) ? dir : NULL;
 }
 
-/**
- * @brief Get offset value from LibVMI with error handling
- */
-static size_t get_offset_safe(const char *offset_name)
+static double elapsed_us(const struct timespec *start, const struct timespec *end)
 {
-  size_t offset = 0;
-  if (VMI_FAILURE == vmi_get_offset(g_vmi, offset_name, &offset))
-  {
-    // Return 0 for unknown offsets - we'll handle this gracefully
-    return 0;
-  }
-  return offset;
+  return (double)(end->tv_sec - start->tv_sec) * 1e6 +
+         (double)(end->tv_nsec - start->tv_nsec) / 1e3;
 }
 
 /**
- * @brief Enumerate and display running processes
+ * @brief Record the NT build number, which selects a built-in EPROCESS layout
  */
-static demo_error_t enumerate_processes(void)
+static void detect_kernel_build(void)
 {
-  printf("\n============================================================\n");
-  printf("PROCESS ENUMERATION\n");
-  printf("============================================================\n");
-
-  addr_t list_head = 0, current_process = 0;
-  vmi_pid_t pid = 0;
-  char *proc_name = NULL;
-  uint32_t process_count = 0;
+  uint32_t build = 0;
 
-  // Use the known working offsets
-  size_t tasks_offset = get_offset_safe("win_tasks");
-  size_t pid_offset = get_offset_safe("win_pid");
-  size_t pname_offset = get_offset_safe("win_pname");
-
-  if (!tasks_offset || !pid_offset || !pname_offset)
+  if (symbols_kernel_build() || DEMO_SUCCESS != kdetect_kernel_build(g_vmi, &build))
   {
-    printf("ERROR: Required process offsets not available\n");
-    return DEMO_ERROR_PROCESS;
+    return;
   }
+  symbols_set_kernel_build(build);
 
-  // Get the process list head
-  if (VMI_FAILURE == vmi_read_addr_ksym(g_vmi, "PsActiveProcessHead", &list_head))
-  {
-    printf("ERROR: Failed to find PsActiveProcessHead\n");
-    return DEMO_ERROR_PROCESS;
-  }
+  const char *layout = symbols_layout_name();
+  output_text("✓ NT build %u (%s)\n", build, layout ? layout : "no built-in layout");
+}
 
-  current_process = list_head;
+/**
+ * @brief Find ntoskrnl in physical memory and build a LibVMI config for it
+ *
+ * Offsets come from the cached profile for the kernel's PDB GUID, or from
+ * the built-in tables for known PDBs and NT builds.
+ */
+static int detect_kernel_config(const char *cache_dir, os_t os, char *config, size_t len)
+{
+  KernelImage_t image;
+  KernelOffsets_t offsets = {0};
+  struct timespec start, end;
 
-  do
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (DEMO_SUCCESS != kdetect_find_kernel(g_vmi, &image))
   {
-    current_process = current_process - tasks_offset;
-
-    // Get process PID
-    if (VMI_FAILURE == vmi_read_32_va(g_vmi, current_process + pid_offset,
-                                      0, (uint32_t *)&pid))
+    // A guest of unknown OS ends up here too, so only a Windows guest warrants a warning
+    if (os == VMI_OS_WINDOWS)
     {
-      goto next_process;
+      output_text("WARNING: No kernel image found in physical memory\n");
     }
-
-    // Get process name
-    proc_name = vmi_read_str_va(g_vmi, current_process + pname_offset, 0);
-    if (!proc_name)
+    else
     {
-      goto next_process;
+      output_text("No Windows kernel found in physical memory; using the LibVMI configuration\n");
     }
+    return -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
 
-    // Print process info
-    printf("[%5d] %-20s (EPROCESS: 0x%lx)\n",
-           pid, proc_name, current_process);
-    process_count++;
-
-    if (proc_name)
-    {
-      free(proc_name);
-      proc_name = NULL;
-    }
+  output_text("✓ Found %s at PA 0x%lx (PDB %s-%u), %zu pages scanned in %.1f ms\n",
+         image.pdb_name, image.pa, image.guid, image.age, image.pages_scanned,
+         elapsed_us(&start, &end) / 1e3);
 
-  next_process:
-    // Move to next process
-    if (VMI_FAILURE == vmi_read_addr_va(g_vmi, current_process + tasks_offset,
-                                        0, &current_process))
-    {
-      break;
-    }
+  detect_kernel_build();
+  symbols_load_profile(cache_dir, image.guid, image.age);
+  if (DEMO_SUCCESS != symbols_resolve_offsets(g_vmi, &offsets) ||
+      0 != symbols_libvmi_config(&offsets, image.pa, config, len))
+  {
+    output_text("WARNING: No profile for PDB %s-%u, falling back to LibVMI configuration\n",
+           image.guid, image.age);
+    return -1;
+  }
+  return 0;
+}
 
-  } while (current_process != list_head);
+/**
+ * @brief Initialize VMI for physical memory access only (no OS profile)
+ */
+static demo_error_t attach_vmi(const char *domain_name, uint64_t flags)
+{
+  vmi_mode_t mode;
 
-  printf("\nTotal processes found: %d\n", process_count);
+  if (VMI_FAILURE == vmi_get_access_mode(NULL, domain_name, VMI_INIT_DOMAINNAME, NULL, &mode) ||
+      VMI_FAILURE == vmi_init(&g_vmi, mode, domain_name, VMI_INIT_DOMAINNAME | flags, NULL, NULL))
+  {
+    g_vmi = NULL;
+    return DEMO_ERROR_INIT;
+  }
   return DEMO_SUCCESS;
 }
 
 /**
- * @brief Basic module enumeration using memory scanning
+ * @brief Acquire guest physical memory to options->dump_path
  */
-static demo_error_t enumerate_modules(void)
+static demo_error_t acquire_memory(const Options_t *options)
 {
-  printf("\n============================================================\n");
-  printf("MODULE ENUMERATION (Basic Memory Analysis)\n");
-  printf("============================================================\n");
-
-  // Since detailed module offsets aren't available, we'll demonstrate
-  // basic memory analysis capabilities instead
-
-  addr_t list_head = 0, current_process = 0;
-  vmi_pid_t pid = 0;
-  char *proc_name = NULL;
-  uint32_t total_analyzed = 0;
+  DumpStats_t stats;
 
-  size_t tasks_offset = get_offset_safe("win_tasks");
-  size_t pid_offset = get_offset_safe("win_pid");
-  size_t pname_offset = get_offset_safe("win_pname");
-
-  if (VMI_FAILURE == vmi_read_addr_ksym(g_vmi, "PsActiveProcessHead", &list_head))
+  if (DEMO_SUCCESS != attach_vmi(options->domain_name, 0))
   {
-    printf("ERROR: Failed to find PsActiveProcessHead\n");
-    return DEMO_ERROR_PROCESS;
+    output_text("ERROR: Failed to attach to domain '%s'\n", options->domain_name);
+    return DEMO_ERROR_INIT;
   }
 
-  current_process = list_head;
+  static const char *format_names[] = {"raw", "LiME", "sparse", "zstd"};
+  output_text("Acquiring guest memory to %s (%s)...\n", options->dump_path,
+              format_names[options->dump_format]);
 
-  do
+  if (options->dump_base)
   {
-    current_process = current_process - tasks_offset;
-
-    if (VMI_FAILURE == vmi_read_32_va(g_vmi, current_process + pid_offset,
-                                      0, (uint32_t *)&pid))
-    {
-      goto next_process_mod;
-    }
-
-    proc_name = vmi_read_str_va(g_vmi, current_process + pname_offset, 0);
-    if (!proc_name)
-    {
-      goto next_process_mod;
-    }
-
-    // Skip system processes and focus on user processes
-    if (pid > 100 && (strstr(proc_name, ".exe") || strstr(proc_name, "explorer")))
-    {
-      printf("Process [%d] %s: Memory space accessible for analysis\n", pid, proc_name);
-
-      // Demonstrate that we can access process memory structures
-      addr_t test_addr = current_process + 0x100; // Test read
-      uint32_t test_value = 0;
-      if (VMI_SUCCESS == vmi_read_32_va(g_vmi, test_addr, 0, &test_value))
-      {
-        printf("    Memory analysis: Process structure accessible\n");
-        printf("    EPROCESS+0x100: 0x%08x\n", test_value);
-      }
-      total_analyzed++;
-    }
+    output_text("  Incremental against %s\n", options->dump_base);
+  }
 
-  next_process_mod:
-    if (proc_name)
-    {
-      free(proc_name);
-      proc_name = NULL;
-    }
+  demo_error_t result = dump_memory(g_vmi, options->dump_path, options->dump_format,
+                                    options->dump_base, &stats);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Memory acquisition to '%s' failed\n", options->dump_path);
+    return result;
+  }
 
-    if (VMI_FAILURE == vmi_read_addr_va(g_vmi, current_process + tasks_offset,
-                                        0, &current_process))
+  double mib = (double)stats.bytes_read / (1024.0 * 1024.0);
+  output_text("✓ Acquired %.1f MiB in %.2f s (%.0f MiB/s), %lu unreadable pages skipped\n",
+              mib, stats.seconds, stats.seconds > 0 ? mib / stats.seconds : 0.0,
+              (unsigned long)stats.pages_unreadable);
+  if (options->dump_format == DUMP_FORMAT_SPARSE)
+  {
+    output_text("  Elided %lu zero and %lu duplicate pages, wrote %.1f MiB\n",
+                (unsigned long)stats.pages_zero, (unsigned long)stats.pages_duplicate,
+                (double)stats.bytes_written / (1024.0 * 1024.0));
+    if (options->dump_base)
     {
-      break;
+      output_text("  %lu pages unchanged since the base dump\n",
+                  (unsigned long)stats.pages_unchanged);
     }
-
-  } while (current_process != list_head && total_analyzed < 10);
-
-  printf("\nProcesses analyzed for memory access: %d\n", total_analyzed);
-  printf("Note: Full module enumeration requires additional kernel symbol resolution\n");
+  }
+  if (options->dump_format == DUMP_FORMAT_ZSTD)
+  {
+    output_text("  Compressed to %.1f MiB with %u compressor threads\n",
+                (double)stats.bytes_written / (1024.0 * 1024.0), stats.compress_threads);
+    return DEMO_SUCCESS;
+  }
+  output_text("  Writer: %s%s\n", stats.used_uring ? "io_uring" : "pwrite",
+              stats.direct_io ? ", O_DIRECT" : "");
   return DEMO_SUCCESS;
 }
 
 /**
- * @brief Basic thread enumeration
+ * @brief ostype of @p domain_name's entry in the LibVMI configuration file
+ *
+ * Looks where LibVMI does: ~SUDO_USER/etc, ~/etc, then /etc. Only the
+ * entry's opening line and its ostype line are matched.
+ *
+ * @return VMI_OS_UNKNOWN without a file, an entry or an ostype
  */
-static demo_error_t enumerate_threads(void)
+static os_t configured_os(const char *domain_name)
 {
-  printf("\n============================================================\n");
-  printf("THREAD ENUMERATION (Process-based Analysis)\n");
-  printf("============================================================\n");
-
-  addr_t list_head = 0, current_process = 0;
-  vmi_pid_t pid = 0;
-  char *proc_name = NULL;
-  uint32_t total_processes_analyzed = 0;
-
-  size_t tasks_offset = get_offset_safe("win_tasks");
-  size_t pid_offset = get_offset_safe("win_pid");
-  size_t pname_offset = get_offset_safe("win_pname");
-
-  if (VMI_FAILURE == vmi_read_addr_ksym(g_vmi, "PsActiveProcessHead", &list_head))
-  {
-    printf("ERROR: Failed to find PsActiveProcessHead\n");
-    return DEMO_ERROR_PROCESS;
-  }
-
-  current_process = list_head;
-
-  do
+  const char *sudo_user = getenv("SUDO_USER");
+  const char *home = getenv("HOME");
+  struct passwd *sudo_pw = sudo_user ? getpwnam(sudo_user) : NULL;
+  const char *dirs[] = {sudo_pw ? sudo_pw->pw_dir : NULL, home, ""};
+  size_t name_len = strlen(domain_name);
+  os_t os = VMI_OS_UNKNOWN;
+
+  for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
   {
-    current_process = current_process - tasks_offset;
+    char path[PATH_MAX];
+    char line[512];
+    int in_entry = 0;
 
-    if (VMI_FAILURE == vmi_read_32_va(g_vmi, current_process + pid_offset,
-                                      0, (uint32_t *)&pid))
+    if (!dirs[i] || snprintf(path, sizeof(path), "%s/etc/libvmi.conf", dirs[i]) >= (int)sizeof(path))
     {
-      goto next_process_thread;
+      continue;
     }
-
-    proc_name = vmi_read_str_va(g_vmi, current_process + pname_offset, 0);
-    if (!proc_name)
+    FILE *file = fopen(path, "r");
+    if (!file)
     {
-      goto next_process_thread;
+      continue;
     }
 
-    // Demonstrate thread analysis capability for key processes
-    if (pid > 4 && total_processes_analyzed < 10)
+    while (fgets(line, sizeof(line), file))
     {
-      printf("Process [%d] %s:\n", pid, proc_name);
-
-      // Check if we can read thread-related data from EPROCESS
-      uint32_t thread_count = 0;
-
-      // Try to read some thread-related fields from EPROCESS structure
-      for (int offset = 0x150; offset < 0x200; offset += 8)
+      const char *p = line + strspn(line, " \t\"");
+      if (!in_entry)
       {
-        addr_t potential_thread_ptr = 0;
-        if (VMI_SUCCESS == vmi_read_addr_va(g_vmi, current_process + offset, 0, &potential_thread_ptr))
-        {
-          if (potential_thread_ptr > 0xfffff80000000000ULL && potential_thread_ptr < 0xffffffffffffffffULL)
-          {
-            thread_count++;
-            if (thread_count <= 3)
-            { // Show only first few
-              printf("    Thread-related pointer at +0x%x: 0x%lx\n", offset, potential_thread_ptr);
-            }
-          }
-        }
+        in_entry = 0 == strncmp(p, domain_name, name_len) && strchr(p + name_len, '{') &&
+                   strspn(p + name_len, " \t\"{") > 0;
       }
-
-      if (thread_count > 0)
+      else if (0 == strncmp(p, "ostype", 6))
       {
-        printf("    Estimated thread-related structures: %d\n", thread_count);
+        os = strstr(p, "Linux") ? VMI_OS_LINUX : strstr(p, "Windows") ? VMI_OS_WINDOWS : VMI_OS_UNKNOWN;
+        break;
       }
-      else
+      else if (*p == '}')
       {
-        printf("    Process structure accessible (thread details require kernel symbols)\n");
+        break;
       }
-
-      total_processes_analyzed++;
-    }
-
-  next_process_thread:
-    if (proc_name)
-    {
-      free(proc_name);
-      proc_name = NULL;
     }
+    fclose(file);
+    return os; // LibVMI reads only the first file it finds
+  }
+  return os;
+}
 
-    if (VMI_FAILURE == vmi_read_addr_va(g_vmi, current_process + tasks_offset,
-                                        0, &current_process))
+/**
+ * @brief Initialize VMI instance
+ *
+ * Memory access is set up first; the OS layer is then initialized from
+ * the detected kernel's profile. If detection fails, or the guest was
+ * given (with --os or in its LibVMI configuration entry) as Linux, the
+ * domain's entry in the LibVMI configuration file is used as before.
+ */
+static demo_error_t initialize_vmi(const Options_t *options)
+{
+  const char *domain_name = options->domain_name;
+  char cache_dir[PATH_MAX];
+  char config[512];
+  uint64_t flags = options->track_processes ? VMI_INIT_EVENTS : 0;
+  os_t expected = (options->os != VMI_OS_UNKNOWN) ? options->os : configured_os(domain_name);
+
+  // Kernel detection scans all of memory for a Windows kernel image; a Linux guest has none
+  if (expected != VMI_OS_LINUX && DEMO_SUCCESS == attach_vmi(domain_name, flags))
+  {
+    const char *dir = profile_cache_dir(options, cache_dir, sizeof(cache_dir));
+    if (0 == detect_kernel_config(dir, expected, config, sizeof(config)) &&
+        VMI_OS_WINDOWS == vmi_init_os(g_vmi, VMI_CONFIG_STRING, config, NULL))
     {
-      break;
+      output_text("✓ Successfully initialized VMI for domain: %s (kernel auto-detected)\n", domain_name);
+      return DEMO_SUCCESS;
     }
+    vmi_destroy(g_vmi);
+    g_vmi = NULL;
+  }
 
-  } while (current_process != list_head);
+  if (VMI_FAILURE == vmi_init_complete(&g_vmi, domain_name, VMI_INIT_DOMAINNAME | flags,
+                                       NULL, VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL))
+  {
+    output_text("ERROR: Failed to initialize VMI for domain '%s'\n", domain_name);
+    return DEMO_ERROR_INIT;
+  }
 
-  printf("\nProcesses analyzed for thread structures: %d\n", total_processes_analyzed);
-  printf("Note: Detailed thread enumeration requires additional offset configuration\n");
+  output_text("✓ Successfully initialized VMI for domain: %s\n", domain_name);
+  os_t os = vmi_get_ostype(g_vmi);
+  if (options->os != VMI_OS_UNKNOWN && os != options->os)
+  {
+    output_text("WARNING: --os %s, but the LibVMI configuration describes a different guest OS\n",
+                options->os == VMI_OS_LINUX ? "linux" : "windows");
+  }
+  if (VMI_OS_WINDOWS == os)
+  {
+    detect_kernel_build();
+  }
   return DEMO_SUCCESS;
 }
 
 /**
- * @brief Print banner and system information
+ * @brief Cleanup VMI resources
  */
-static void print_banner(const char *domain_name)
+static void cleanup_vmi(void)
 {
-  time_t current_time = time(NULL);
-  printf("================================================================================\n");
-  printf("         VMI DEMONSTRATION\n");
-  printf("    Virtual Machine Introspection Demo - Compatible Version\n");
-  printf("================================================================================\n");
-  printf("Target VM: %s\n", domain_name);
-  printf("Timestamp: %s", ctime(&current_time));
-  printf("VMI Capabilities: Process enumeration, Memory analysis, Structure inspection\n");
-  printf("================================================================================\n");
+  if (g_vmi)
+  {
+    vmi_destroy(g_vmi);
+    g_vmi = NULL;
+  }
 }
 
 /**
- * @brief Main program entry point
+ * @brief Load symbols and offsets from an ISF file, reporting what was found
  */
-int main(int argc, char **argv)
+static demo_error_t load_isf_symbols(const char *path)
 {
-  const char *domain_name = "win7-vmi";
-  demo_error_t result = DEMO_SUCCESS;
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
 
-  if (argc > 1)
+  if (DEMO_SUCCESS != symbols_load_isf(g_vmi, path))
   {
-    domain_name = argv[1];
+    output_text("ERROR: Failed to parse ISF symbols from '%s'\n", path);
+    return DEMO_ERROR_INIT;
   }
 
-  print_banner(domain_name);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed_ms = elapsed_us(&start, &end) / 1e3;
 
-  // Initialize VMI
-  result = initialize_vmi(domain_name);
-  if (result != DEMO_SUCCESS)
+  const IsfRequest_t *isf = symbols_isf();
+  size_t fields_found = 0, symbols_found = 0;
+  for (size_t i = 0; i < isf->field_count; i++)
   {
-    printf("Failed to initialize VMI. Ensure:\n");
-    printf("1. VM '%s' is running\n", domain_name);
-    printf("2. LibVMI configuration is correct\n");
-    printf("3. You have sufficient privileges\n");
-    goto cleanup;
+    fields_found += isf->fields[i].found;
+  }
+  for (size_t i = 0; i < isf->symbol_count; i++)
+  {
+    symbols_found += isf->symbols[i].found;
   }
 
-  printf("\nStarting VMI introspection...\n");
+  output_text("✓ Loaded ISF %s (PDB %s-%u): %zu/%zu offsets, %zu/%zu symbols in %.1f ms\n",
+         path, isf->pdb_guid[0] ? isf->pdb_guid : "unknown", isf->pdb_age,
+         fields_found, isf->field_count, symbols_found, isf->symbol_count, elapsed_ms);
+  return DEMO_SUCCESS;
+}
 
-  // 1. Process enumeration (fully working)
-  result = enumerate_processes();
-  if (result != DEMO_SUCCESS)
+/**
+ * @brief Resolve offsets and symbols: cached profile first, then the ISF
+ *
+ * A successful ISF parse whose PDB matches the running kernel is written
+ * back to the cache so the next run can skip it.
+ */
+static demo_error_t load_symbols(const Options_t *options)
+{
+  char guid[ISF_GUID_LEN] = {0};
+  char cache_dir[PATH_MAX];
+  uint32_t age = 0;
+  struct timespec start, end;
+
+  const char *dir = profile_cache_dir(options, cache_dir, sizeof(cache_dir));
+
+  if (DEMO_SUCCESS != symbols_kernel_pdb(g_vmi, guid, &age))
   {
-    printf("ERROR: Process enumeration failed\n");
-    goto cleanup;
+    output_text("WARNING: Kernel PDB GUID not readable, profile cache disabled\n");
+    return options->isf_path ? load_isf_symbols(options->isf_path) : DEMO_SUCCESS;
   }
 
-  // 2. Module analysis (basic version)
-  result = enumerate_modules();
-  if (result != DEMO_SUCCESS)
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (dir && DEMO_SUCCESS == symbols_load_profile(dir, guid, age))
   {
-    printf("ERROR: Module analysis failed\n");
-    goto cleanup;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    output_text("✓ Loaded cached profile for PDB %s-%u in %.0f µs\n", guid, age,
+           elapsed_us(&start, &end));
+    return DEMO_SUCCESS;
   }
 
-  // 3. Thread analysis (basic version)
-  result = enumerate_threads();
+  if (!options->isf_path)
+  {
+    return DEMO_SUCCESS;
+  }
+
+  demo_error_t result = load_isf_symbols(options->isf_path);
   if (result != DEMO_SUCCESS)
   {
-    printf("ERROR: Thread analysis failed\n");
-    goto cleanup;
+    return result;
   }
 
-cleanup:
-  cleanup_vmi();
+  const IsfRequest_t *isf = symbols_isf();
+  if (strcmp(isf->pdb_guid, guid) != 0 || isf->pdb_age != age)
+  {
+    output_text("WARNING: ISF is for PDB %s-%u but the kernel is %s-%u; not caching\n",
+           isf->pdb_guid[0] ? isf->pdb_guid : "unknown", isf->pdb_age, guid, age);
+  }
+  else if (dir && DEMO_SUCCESS == symbols_save_profile(dir))
+  {
+    output_text("✓ Cached profile in %s\n", dir);
+  }
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Resolve task_struct offsets for a Linux guest
+ */
+static demo_error_t setup_linux(const Options_t *options)
+{
+  if (options->track_processes)
+  {
+    output_text("ERROR: --track-processes supports Windows guests only\n");
+    return DEMO_ERROR_INIT;
+  }
+
+  if (DEMO_SUCCESS != linux_resolve_offsets(g_vmi, options->isf_path, &g_linux_offsets))
+  {
+    output_text("ERROR: linux_tasks, linux_pid and linux_name offsets not available\n");
+    output_text("       (add them to the domain's libvmi.conf entry or pass --isf)\n");
+    return DEMO_ERROR_PROCESS;
+  }
+
+  output_text("✓ Linux guest: tasks=0x%zx pid=0x%zx comm=0x%zx mm=0x%zx\n",
+              g_linux_offsets.tasks, g_linux_offsets.pid, g_linux_offsets.comm, g_linux_offsets.mm);
+  output_text("  Driver, service table, vCPU state and callback checks are Windows-only\n");
+  if (!g_linux_offsets.has_vmas)
+  {
+    output_text("WARNING: Memory-map offsets not available; VMAs are skipped\n");
+    output_text("         (needs a Volatility3 Linux ISF with mm_struct.mmap, i.e. a kernel before 6.1)\n");
+  }
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Fix the structure offsets for this run before any enumeration
+ */
+static demo_error_t resolve_offsets(void)
+{
+#ifdef KERNEL_BUILD_WIN7_SP1_X64
+  if (!symbols_kernel_matches(WIN7_SP1_X64_PDB_GUID, WIN7_SP1_X64_PDB_AGE))
+  {
+    output_text("ERROR: This binary is built for ntkrnlmp.pdb %s-%d only\n",
+           WIN7_SP1_X64_PDB_GUID, WIN7_SP1_X64_PDB_AGE);
+    return DEMO_ERROR_PROCESS;
+  }
+#else
+  if (DEMO_SUCCESS != symbols_resolve_offsets(g_vmi, &g_offsets))
+  {
+    output_text("ERROR: Required process offsets not available\n");
+    return DEMO_ERROR_PROCESS;
+  }
+  if (!g_offsets.eprocess_peb)
+  {
+    // Kernel build not identified; LibVMI has no win_peb entry either
+    g_offsets.eprocess_peb = WIN7_X64_EPROCESS_PEB;
+  }
+#endif
+
+  output_text("✓ Offsets: tasks=0x%zx pid=0x%zx name=0x%zx peb=0x%zx\n",
+         g_offsets.eprocess_tasks, g_offsets.eprocess_pid, g_offsets.eprocess_pname,
+         g_offsets.eprocess_peb);
+  if (g_offsets.kprocess_user_pdbase)
+  {
+    output_text("✓ KVA shadow: user DTB at KPROCESS+0x%zx\n", g_offsets.kprocess_user_pdbase);
+  }
+  return DEMO_SUCCESS;
+}
+
+static void probe_add_node(addr_t node)
+{
+  if (g_probe.count == g_probe.capacity)
+  {
+    size_t capacity = g_probe.capacity ? g_probe.capacity * 2 : 256;
+    addr_t *grown = realloc(g_probe.nodes, capacity * sizeof(*grown));
+    if (!grown)
+    {
+      g_probe.valid = 0;
+      return;
+    }
+    g_probe.nodes = grown;
+    g_probe.capacity = capacity;
+  }
+  if (node == g_list_head)
+  {
+    g_probe.head_index = g_probe.count;
+  }
+  g_probe.nodes[g_probe.count++] = node;
+}
+
+static void probe_add_process(vmi_pid_t pid, const char *name, addr_t eprocess)
+{
+  if (g_probe.process_count == g_probe.process_capacity)
+  {
+    size_t capacity = g_probe.process_capacity ? g_probe.process_capacity * 2 : 256;
+    ProcessInfo_t *grown = realloc(g_probe.processes, capacity * sizeof(*grown));
+    if (!grown)
+    {
+      g_probe.valid = 0;
+      return;
+    }
+    g_probe.processes = grown;
+    g_probe.process_capacity = capacity;
+  }
+  ProcessInfo_t *info = &g_probe.processes[g_probe.process_count++];
+  info->pid = pid;
+  snprintf(info->name, sizeof(info->name), "%s", name);
+  info->eprocess_addr = eprocess;
+}
+
+/**
+ * @brief Read PsActiveProcessHead's links; 0 on failure
+ */
+static int read_head_links(addr_t links[2])
+{
+  return VMI_SUCCESS == readstats_read_addr(g_vmi, READ_SITE_LINK, g_list_head, &links[0]) &&
+         VMI_SUCCESS == readstats_read_addr(g_vmi, READ_SITE_LINK, g_list_head + sizeof(addr_t), &links[1]);
+}
+
+/**
+ * @brief Whether the process list head changed since the end of the last sweep
+ *
+ * Wakes an adaptive sweep early. A new process is always appended,
+ * rewriting the head's Blink; exits at either end rewrite a link too.
+ * Exits in the middle wait for the next scheduled sweep.
+ *
+ * @return 1 if changed, 0 if not, -1 if the head is not probed or unreadable
+ */
+static int head_changed(void)
+{
+  addr_t links[2];
+
+  if (!g_list_head || !read_head_links(links))
+  {
+    return -1;
+  }
+  return links[0] != g_head_links[0] || links[1] != g_head_links[1];
+}
+
+/**
+ * @brief True if node @p i still links to the same neighbours as in the last walk
+ */
+static int probe_links_match(size_t i)
+{
+  addr_t flink = 0, blink = 0;
+  addr_t next = g_probe.nodes[(i + 1) % g_probe.count];
+  addr_t prev = g_probe.nodes[(i + g_probe.count - 1) % g_probe.count];
+
+  return VMI_SUCCESS == readstats_read_addr(g_vmi, READ_SITE_LINK, g_probe.nodes[i], &flink) &&
+         VMI_SUCCESS == readstats_read_addr(g_vmi, READ_SITE_LINK, g_probe.nodes[i] + sizeof(addr_t), &blink) &&
+         flink == next && blink == prev;
+}
+
+/**
+ * @brief Cheap check that the process list is as the last walk left it
+ *
+ * Any insert rewrites the head's Blink, which is checked against the
+ * neighbours the walk itself saw: links read after the walk could
+ * already include a later insert. Any removal rewrites its neighbours'
+ * links, which the rotating sample reaches within a few sweeps. A full
+ * walk is forced every g_probe.full_every sweeps anyway.
+ */
+static int list_unchanged(void)
+{
+  if (!g_probe.full_every || !g_probe.valid || g_probe.count < 2 ||
+      g_probe.skipped >= g_probe.full_every || !probe_links_match(g_probe.head_index))
+  {
+    return 0;
+  }
+
+  size_t samples = (g_probe.count - 1 < PROBE_SAMPLES) ? g_probe.count - 1 : PROBE_SAMPLES;
+  for (size_t n = 0; n < samples; n++)
+  {
+    size_t i = g_probe.cursor++ % g_probe.count;
+    if (i != g_probe.head_index && !probe_links_match(i))
+    {
+      return 0;
+    }
+  }
+  g_probe.skipped++;
+  return 1;
+}
+
+static void process_set_add(addr_t eprocess)
+{
+  ProcessSet_t *set = &g_process_set[0];
+
+  if (set->count == set->capacity)
+  {
+    size_t capacity = set->capacity ? set->capacity * 2 : 256;
+    addr_t *grown = realloc(set->eprocess, capacity * sizeof(*grown));
+    if (!grown)
+    {
+      return;
+    }
+    set->eprocess = grown;
+    set->capacity = capacity;
+  }
+  set->eprocess[set->count++] = eprocess;
+}
+
+static int compare_addr(const void *a, const void *b)
+{
+  addr_t x = *(const addr_t *)a, y = *(const addr_t *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Processes that appeared or disappeared since the previous sweep
+ */
+static unsigned process_churn(void)
+{
+  ProcessSet_t *now = &g_process_set[0], *prev = &g_process_set[1];
+  unsigned churn = 0;
+  size_t i = 0, j = 0;
+
+  qsort(now->eprocess, now->count, sizeof(*now->eprocess), compare_addr);
+  while (i < now->count || j < prev->count)
+  {
+    if (j == prev->count || (i < now->count && now->eprocess[i] < prev->eprocess[j]))
+    {
+      churn++;
+      i++;
+    }
+    else if (i == now->count || prev->eprocess[j] < now->eprocess[i])
+    {
+      churn++;
+      j++;
+    }
+    else
+    {
+      i++;
+      j++;
+    }
+  }
+
+  ProcessSet_t swap = *prev;
+  *prev = *now;
+  *now = swap;
+  now->count = 0;
+  return g_process_sweeps++ ? churn : 0;
+}
+
+/**
+ * @brief Report a process creation or exit seen between sweeps
+ */
+static void report_process_change(void *ctx, proc_change_t change, const TrackedProcess_t *process)
+{
+  (void)ctx;
+  output_text("[%c] Process %s: [%d] %s\n", change == PROC_CHANGE_CREATED ? '+' : '-',
+              change == PROC_CHANGE_CREATED ? "created" : "exited", process->pid, process->name);
+}
+
+/**
+ * @brief Take a first snapshot of the process list and follow it through CR3 writes
+ * @param record_path Also record the events to this trace, or NULL
+ */
+static demo_error_t start_tracking(const char *record_path)
+{
+  ProcTrackSource_t source;
+  addr_t list_head = 0;
+
+  if (VMI_FAILURE == symbols_ksym2v(g_vmi, "PsActiveProcessHead", &list_head))
+  {
+    output_text("ERROR: Failed to find PsActiveProcessHead\n");
+    return DEMO_ERROR_PROCESS;
+  }
+
+  if (record_path && DEMO_SUCCESS != evtrace_record_start(record_path, &g_offsets, list_head))
+  {
+    output_text("ERROR: Cannot write event trace '%s'\n", record_path);
+    return DEMO_ERROR_INIT;
+  }
+  if (record_path)
+  {
+    output_text("✓ Recording events to %s\n", record_path);
+  }
+
+  proctrack_live_source(&source, g_vmi, &g_offsets, list_head);
+  proctrack_init(&g_tracker, &source);
+  if (DEMO_SUCCESS != proctrack_refresh(&g_tracker) ||
+      DEMO_SUCCESS != proctrack_events_start(g_vmi, &g_tracker))
+  {
+    output_text("ERROR: Failed to start CR3-write event tracking\n");
+    return DEMO_ERROR_INIT;
+  }
+
+  // Report changes from here on, not the initial snapshot
+  g_tracker.source.changed = report_process_change;
+  g_tracking = 1;
+  output_text("✓ Tracking %zu processes through CR3-write events\n", g_tracker.count);
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Print the process table kept current by CR3-write events
+ */
+static demo_error_t list_tracked_processes(void)
+{
+  const ProcTrackStats_t *stats = &g_tracker.stats;
+  vmi_pid_t session_pid = 0;
+
+  proctrack_sweep(&g_tracker);
+
+  for (size_t i = 0; i < g_tracker.count; i++)
+  {
+    const TrackedProcess_t *process = &g_tracker.processes[i];
+    output_process(process->pid, process->name, process->eprocess);
+
+    // Keep the current session process while it lives, else take the first csrss.exe
+    if ((!session_pid || process->pid == g_session_pid) && 0 == strcmp(process->name, "csrss.exe"))
+    {
+      session_pid = process->pid;
+    }
+  }
+  g_session_pid = session_pid;
+
+  g_sweep_changes += (unsigned)(stats->created + stats->exited - g_tracked_changes);
+  g_tracked_changes = stats->created + stats->exited;
+
+  output_text("\nTotal processes tracked: %zu\n", g_tracker.count);
+  output_text("Since start: %lu CR3 events, %lu list walks, %lu link checks, "
+              "%lu created, %lu exited (%lu within one interval)\n",
+              (unsigned long)stats->cr3_events, (unsigned long)stats->walks,
+              (unsigned long)stats->checked, (unsigned long)stats->created,
+              (unsigned long)stats->exited, (unsigned long)stats->short_lived);
+  metrics_set(METRIC_PROCESSES, g_tracker.count);
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Enumerate and display running processes
+ */
+static demo_error_t enumerate_processes(void)
+{
+  output_text("\n============================================================\n");
+  output_text("PROCESS ENUMERATION\n");
+  output_text("============================================================\n");
+
+  if (g_tracking)
+  {
+    return list_tracked_processes();
+  }
+
+  if (g_list_unchanged)
+  {
+    for (size_t i = 0; i < g_probe.process_count; i++)
+    {
+      const ProcessInfo_t *info = &g_probe.processes[i];
+      output_process(info->pid, info->name, info->eprocess_addr);
+    }
+    output_text("\nTotal processes found: %zu (list unchanged since the last walk, %u sweep(s) ago)\n",
+                g_probe.process_count, g_probe.skipped);
+    metrics_set(METRIC_PROCESSES, g_probe.process_count);
+    return DEMO_SUCCESS;
+  }
+
+  addr_t list_head = 0, current_process = 0;
+  vmi_pid_t pid = 0, session_pid = 0;
+  char *proc_name = NULL;
+  uint32_t process_count = 0;
+
+  // Get the process list head
+  if (VMI_FAILURE == symbols_read_addr_ksym(g_vmi, "PsActiveProcessHead", &list_head))
+  {
+    output_text("ERROR: Failed to find PsActiveProcessHead\n");
+    return DEMO_ERROR_PROCESS;
+  }
+
+  current_process = list_head;
+  g_probe.count = 0;
+  g_probe.process_count = 0;
+  g_probe.head_index = SIZE_MAX;
+  g_probe.skipped = 0;
+  g_probe.valid = 1;
+
+  do
+  {
+    probe_add_node(current_process);
+    current_process = current_process - g_offsets.eprocess_tasks;
+
+    // Get process PID
+    if (VMI_FAILURE == readstats_read_32(g_vmi, READ_SITE_PID,
+                                         current_process + g_offsets.eprocess_pid, (uint32_t *)&pid))
+    {
+      goto next_process;
+    }
+
+    // Get process name
+    proc_name = readstats_read_str(g_vmi, READ_SITE_NAME,
+                                   current_process + g_offsets.eprocess_pname);
+    if (!proc_name)
+    {
+      goto next_process;
+    }
+
+    // Print process info
+    output_process(pid, proc_name, current_process);
+    process_set_add(current_process);
+    probe_add_process(pid, proc_name, current_process);
+    process_count++;
+
+    // Keep the current session process while it lives, else take the first csrss.exe
+    if ((!session_pid || pid == g_session_pid) && 0 == strcmp(proc_name, "csrss.exe"))
+    {
+      session_pid = pid;
+    }
+
+    if (proc_name)
+    {
+      free(proc_name);
+      proc_name = NULL;
+    }
+
+  next_process:
+    // Move to next process
+    if (VMI_FAILURE == readstats_read_addr(g_vmi, READ_SITE_LINK,
+                                           current_process + g_offsets.eprocess_tasks,
+                                           &current_process))
+    {
+      break;
+    }
+
+  } while (current_process != list_head);
+
+  // Only a walk that came back around describes the whole list
+  g_probe.valid = g_probe.valid && current_process == list_head && g_probe.head_index < g_probe.count;
+  if (session_pid || current_process == list_head)
+  {
+    g_session_pid = session_pid;
+  }
+
+  output_text("\nTotal processes found: %d\n", process_count);
+  metrics_set(METRIC_PROCESSES, process_count);
+  g_sweep_changes += process_churn();
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Print one process's PEB loader list and process parameters
+ * @return Modules found
+ */
+static size_t process_modules(vmi_pid_t pid, const char *proc_name, addr_t eprocess)
+{
+  addr_t peb = 0;
+  size_t found = 0;
+  int have_peb = VMI_SUCCESS == readstats_read_addr(g_vmi, READ_SITE_PEB, eprocess + g_offsets.eprocess_peb, &peb);
+
+  if (have_peb && DEMO_SUCCESS == kmodules_enumerate_process(g_vmi, pid, peb, &g_process_modules))
+  {
+    // Text mode shows the first few; JSON consumers get every module
+    size_t shown = output_jsonl() ? g_process_modules.count : 3;
+    if (!output_jsonl())
+    {
+      output_text("Process [%d] %s: %zu modules\n", pid, proc_name, g_process_modules.count);
+    }
+    for (size_t i = 0; i < g_process_modules.count && i < shown; i++)
+    {
+      const KernelModule_t *module = &g_process_modules.modules[i];
+      output_module(pid, proc_name, module->name, module->base, module->size);
+    }
+    found = g_process_modules.count;
+  }
+  else
+  {
+    output_text("Process [%d] %s: loader list not readable (PEB paged out)\n", pid, proc_name);
+  }
+
+  if (have_peb && DEMO_SUCCESS == procparams_read(g_vmi, pid, peb, g_read_environment, &g_params))
+  {
+    output_process_params(pid, proc_name, g_params.image_path, g_params.command_line,
+                          g_params.current_directory, g_params.environment, g_params.environment_len);
+  }
+  return found;
+}
+
+/**
+ * @brief Enumerate user-mode modules of every process from its PEB loader list
+ */
+static demo_error_t enumerate_modules(void)
+{
+  output_text("\n============================================================\n");
+  output_text("MODULE ENUMERATION (PEB Loader Lists)\n");
+  output_text("============================================================\n");
+
+  addr_t list_head = 0, current_process = 0;
+  vmi_pid_t pid = 0;
+  char *proc_name = NULL;
+  uint32_t total_analyzed = 0;
+  size_t total_modules = 0;
+
+  // The change probe vouched for the last walk; take the processes from it
+  if (g_list_unchanged)
+  {
+    for (size_t i = 0; i < g_probe.process_count; i++)
+    {
+      const ProcessInfo_t *info = &g_probe.processes[i];
+      if (info->pid > 4)
+      {
+        total_modules += process_modules(info->pid, info->name, info->eprocess_addr);
+        total_analyzed++;
+      }
+    }
+    goto done;
+  }
+
+  if (VMI_FAILURE == symbols_read_addr_ksym(g_vmi, "PsActiveProcessHead", &list_head))
+  {
+    output_text("ERROR: Failed to find PsActiveProcessHead\n");
+    return DEMO_ERROR_PROCESS;
+  }
+
+  current_process = list_head;
+
+  do
+  {
+    current_process = current_process - g_offsets.eprocess_tasks;
+
+    if (VMI_FAILURE == readstats_read_32(g_vmi, READ_SITE_PID,
+                                         current_process + g_offsets.eprocess_pid, (uint32_t *)&pid))
+    {
+      goto next_process_mod;
+    }
+
+    proc_name = readstats_read_str(g_vmi, READ_SITE_NAME,
+                                   current_process + g_offsets.eprocess_pname);
+    if (!proc_name)
+    {
+      goto next_process_mod;
+    }
+
+    // System and Idle have no PEB
+    if (pid > 4)
+    {
+      total_modules += process_modules(pid, proc_name, current_process);
+      total_analyzed++;
+    }
+
+  next_process_mod:
+    if (proc_name)
+    {
+      free(proc_name);
+      proc_name = NULL;
+    }
+
+    if (VMI_FAILURE == readstats_read_addr(g_vmi, READ_SITE_LINK,
+                                           current_process + g_offsets.eprocess_tasks,
+                                           &current_process))
+    {
+      break;
+    }
+
+  } while (current_process != list_head);
+
+done:
+  output_text("\nProcesses analyzed: %d, total modules found: %zu\n", total_analyzed, total_modules);
+  metrics_set(METRIC_MODULES, total_modules);
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Probe one EPROCESS for pointers into kernel space
+ */
+static void process_threads(vmi_pid_t pid, const char *proc_name, addr_t eprocess)
+{
+  if (!output_jsonl())
+  {
+    output_text("Process [%d] %s:\n", pid, proc_name);
+  }
+
+  // Check if we can read thread-related data from EPROCESS
+  uint32_t thread_count = 0;
+
+  // Try to read some thread-related fields from EPROCESS structure
+  for (int offset = 0x150; offset < 0x200; offset += 8)
+  {
+    addr_t potential_thread_ptr = 0;
+    if (VMI_SUCCESS == readstats_read_addr(g_vmi, READ_SITE_THREAD_PROBE, eprocess + offset, &potential_thread_ptr))
+    {
+      if (potential_thread_ptr > 0xfffff80000000000ULL && potential_thread_ptr < 0xffffffffffffffffULL)
+      {
+        thread_count++;
+        if (output_jsonl() || thread_count <= 3)
+        { // Text mode shows only the first few
+          const KernelModule_t *owner = kmodules_find(&g_kernel_modules, potential_thread_ptr);
+          output_thread_pointer(pid, proc_name, (uint32_t)offset, potential_thread_ptr,
+                                owner ? owner->name : NULL);
+        }
+      }
+    }
+  }
+
+  if (!output_jsonl() && thread_count > 0)
+  {
+    output_text("    Estimated thread-related structures: %d\n", thread_count);
+  }
+  else if (!output_jsonl())
+  {
+    output_text("    Process structure accessible (thread details require kernel symbols)\n");
+  }
+}
+
+/**
+ * @brief Basic thread enumeration
+ */
+static demo_error_t enumerate_threads(void)
+{
+  output_text("\n============================================================\n");
+  output_text("THREAD ENUMERATION (Process-based Analysis)\n");
+  output_text("============================================================\n");
+
+  addr_t list_head = 0, current_process = 0;
+  vmi_pid_t pid = 0;
+  char *proc_name = NULL;
+  uint32_t total_processes_analyzed = 0;
+
+  // The change probe vouched for the last walk; take the processes from it
+  if (g_list_unchanged)
+  {
+    for (size_t i = 0; i < g_probe.process_count && total_processes_analyzed < 10; i++)
+    {
+      const ProcessInfo_t *info = &g_probe.processes[i];
+      if (info->pid > 4)
+      {
+        process_threads(info->pid, info->name, info->eprocess_addr);
+        total_processes_analyzed++;
+      }
+    }
+    goto done;
+  }
+
+  if (VMI_FAILURE == symbols_read_addr_ksym(g_vmi, "PsActiveProcessHead", &list_head))
+  {
+    output_text("ERROR: Failed to find PsActiveProcessHead\n");
+    return DEMO_ERROR_PROCESS;
+  }
+
+  current_process = list_head;
+
+  do
+  {
+    current_process = current_process - g_offsets.eprocess_tasks;
+
+    if (VMI_FAILURE == readstats_read_32(g_vmi, READ_SITE_PID,
+                                         current_process + g_offsets.eprocess_pid, (uint32_t *)&pid))
+    {
+      goto next_process_thread;
+    }
+
+    proc_name = readstats_read_str(g_vmi, READ_SITE_NAME,
+                                   current_process + g_offsets.eprocess_pname);
+    if (!proc_name)
+    {
+      goto next_process_thread;
+    }
+
+    // Demonstrate thread analysis capability for key processes
+    if (pid > 4 && total_processes_analyzed < 10)
+    {
+      process_threads(pid, proc_name, current_process);
+      total_processes_analyzed++;
+    }
+
+  next_process_thread:
+    if (proc_name)
+    {
+      free(proc_name);
+      proc_name = NULL;
+    }
+
+    if (VMI_FAILURE == readstats_read_addr(g_vmi, READ_SITE_LINK,
+                                           current_process + g_offsets.eprocess_tasks,
+                                           &current_process))
+    {
+      break;
+    }
+
+  } while (current_process != list_head);
+
+done:
+  output_text("\nProcesses analyzed for thread structures: %d\n", total_processes_analyzed);
+  output_text("Note: Detailed thread enumeration requires additional offset configuration\n");
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Verify loaded drivers' code pages against their baselines
+ */
+static demo_error_t check_driver_integrity(const KernelModuleList_t *modules)
+{
+  output_text("\n============================================================\n");
+  output_text("DRIVER CODE INTEGRITY\n");
+  output_text("============================================================\n");
+
+  IntegrityStats_t stats;
+  if (DEMO_SUCCESS != integrity_sweep(g_vmi, &g_integrity, modules, &stats))
+  {
+    output_text("ERROR: Failed to update driver baselines\n");
+    return DEMO_ERROR_MEMORY;
+  }
+
+  output_text("Drivers tracked: %zu (+%zu new, -%zu unloaded)\n",
+         stats.drivers, stats.drivers_added, stats.drivers_removed);
+  output_text("Code pages: %zu total, %zu hashed this sweep, %zu frames moved, %zu not resident\n",
+         stats.pages, stats.pages_hashed, stats.frames_moved, stats.pages_not_resident);
+  metrics_add(METRIC_CODE_PAGES_CHECKED, stats.pages);
+  metrics_add(METRIC_CODE_PAGES_HASHED, stats.pages_hashed);
+
+  // The scheduler wants transitions, not a lasting patch seen again every sweep
+  g_sweep_changes += (unsigned)stats.pages_changed;
+  if (stats.pages_modified)
+  {
+    output_text("\nWARNING: %zu modified code page(s) detected\n", stats.pages_modified);
+  }
+  else if (g_integrity.sweep == 1)
+  {
+    output_text("\n✓ Baseline recorded\n");
+  }
+  else
+  {
+    output_text("\n✓ No code modifications detected\n");
+  }
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Check SSDT and shadow SSDT entries against ntoskrnl/win32k ranges
+ */
+static demo_error_t check_service_tables(const KernelModuleList_t *modules)
+{
+  static const char *const labels[] = {"SSDT (KiServiceTable)", "Shadow SSDT (W32pServiceTable)"};
+
+  output_text("\n============================================================\n");
+  output_text("SERVICE TABLE HOOK CHECK\n");
+  output_text("============================================================\n");
+
+  for (int which = SERVICE_TABLE_NT; which <= SERVICE_TABLE_WIN32K; which++)
+  {
+    ServiceTableState_t *state = &g_service_tables[which];
+    vmi_pid_t pid = (which == SERVICE_TABLE_WIN32K) ? g_session_pid : 0;
+    int from_cache = 0;
+
+    if (which == SERVICE_TABLE_WIN32K && !pid)
+    {
+      output_text("%s: skipped (no session process found)\n", labels[which]);
+      continue;
+    }
+
+    if (DEMO_SUCCESS != ssdt_check(g_vmi, (service_table_t)which, pid, modules, state, &from_cache))
+    {
+      output_text("%s: unavailable (descriptor symbol not resolved)\n", labels[which]);
+      continue;
+    }
+    metrics_add(METRIC_SSDT_CHECKS, 1);
+    metrics_add(METRIC_SSDT_CACHE_HITS, from_cache ? 1 : 0);
+
+    output_text("%s: %u entries at 0x%lx, %zu hooked%s\n", labels[which], state->count,
+           state->table, state->hooks, from_cache ? " (unchanged since last sweep)" : "");
+  }
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Verify IDT handlers, GDT/TSS bases and LSTAR for every vCPU
+ */
+static demo_error_t check_cpu_state(const KernelModuleList_t *modules)
+{
+  static const char *const finding_labels[] = {
+      [CPU_FINDING_IDT_HANDLER] = "IDT handler",
+      [CPU_FINDING_LSTAR] = "LSTAR outside ntoskrnl",
+      [CPU_FINDING_LSTAR_MISMATCH] = "LSTAR differs from vCPU 0",
+      [CPU_FINDING_GDT_BASE] = "GDT base not in kernel space",
+      [CPU_FINDING_TSS_BASE] = "TSS base not in kernel space",
+  };
+
+  output_text("\n============================================================\n");
+  output_text("vCPU STATE INTEGRITY (IDT / GDT / LSTAR)\n");
+  output_text("============================================================\n");
+
+  VcpuState_t *states = NULL;
+  unsigned count = 0;
+  if (DEMO_SUCCESS != cpustate_capture(g_vmi, &states, &count))
+  {
+    output_text("ERROR: Failed to capture vCPU state\n");
+    return DEMO_ERROR_INIT;
+  }
+
+  cpustate_validate(states, count, modules);
+
+  unsigned total_findings = 0;
+  for (unsigned i = 0; i < count; i++)
+  {
+    const VcpuState_t *state = &states[i];
+    if (!state->regs_valid)
+    {
+      output_text("vCPU %u: registers unavailable\n", state->vcpu);
+      continue;
+    }
+
+    output_text("vCPU %u: IDT 0x%lx (%u gates%s), GDT 0x%lx, LSTAR 0x%lx\n", state->vcpu,
+           state->idtr_base, state->idt_present, state->idt_valid ? "" : ", unreadable",
+           state->gdtr_base, state->lstar);
+
+    for (unsigned f = 0; f < state->findings_count; f++)
+    {
+      const CpuFinding_t *finding = &state->findings[f];
+      if (finding->kind == CPU_FINDING_IDT_HANDLER)
+      {
+        output_text("  [!] %s 0x%02x -> 0x%lx (%s)\n", finding_labels[finding->kind], finding->index,
+               finding->value, finding->owner ? finding->owner->name : "unknown module");
+      }
+      else
+      {
+        output_text("  [!] %s: 0x%lx\n", finding_labels[finding->kind], finding->value);
+      }
+    }
+    if (state->findings_dropped)
+    {
+      output_text("  [!] ... %u more finding(s)\n", state->findings_dropped);
+    }
+    total_findings += state->findings_count + state->findings_dropped;
+  }
+
+  if (total_findings)
+  {
+    output_text("\nWARNING: %u suspicious vCPU value(s) detected\n", total_findings);
+  }
+  else
+  {
+    output_text("\n✓ All handlers resolve into ntoskrnl/HAL on %u vCPU(s)\n", count);
+  }
+
+  free(states);
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief List registered kernel callbacks with their owning drivers
+ */
+static demo_error_t enumerate_callbacks(const KernelModuleList_t *modules)
+{
+  output_text("\n============================================================\n");
+  output_text("KERNEL CALLBACK ENUMERATION\n");
+  output_text("============================================================\n");
+
+  KernelCallbackSet_t *set = malloc(sizeof(*set));
+  if (!set)
+  {
+    return DEMO_ERROR_MEMORY;
+  }
+
+  if (DEMO_SUCCESS != callbacks_enumerate(g_vmi, modules, set))
+  {
+    output_text("Callback arrays unavailable (notify routine symbols not resolved)\n");
+    free(set);
+    return DEMO_SUCCESS;
+  }
+
+  size_t orphans = 0;
+  for (int type = 0; type < CALLBACK_TYPES; type++)
+  {
+    output_text("%s callbacks:%s\n", callbacks_type_name((callback_type_t)type),
+           set->resolved[type] ? "" : " (symbol not resolved)");
+
+    for (size_t i = 0; i < set->count; i++)
+    {
+      const KernelCallback_t *callback = &set->callbacks[i];
+      if (callback->type != (callback_type_t)type)
+      {
+        continue;
+      }
+
+      if (callback->owner)
+      {
+        output_text("    [%2u] 0x%lx %s+0x%lx\n", callback->slot, callback->function,
+               callback->owner->name, callback->function - callback->owner->base);
+      }
+      else
+      {
+        output_text("  [!] [%2u] 0x%lx (no owning driver)\n", callback->slot, callback->function);
+        orphans++;
+      }
+    }
+  }
+
+  output_text("\nTotal callbacks found: %zu\n", set->count);
+  if (orphans)
+  {
+    output_text("WARNING: %zu callback(s) outside every loaded driver\n", orphans);
+  }
+
+  free(set);
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Record a phase timing; while tracking, also answer queued CR3 events
+ *
+ * A vCPU that writes CR3 waits until its event is handled, so a long sweep
+ * must not leave events unanswered until the next wait.
+ */
+static void phase_end(sweep_phase_t phase, const struct timespec *start)
+{
+  readstats_phase_end(phase, start);
+  if (g_tracking)
+  {
+    vmi_events_listen(g_vmi, 0);
+  }
+}
+
+/**
+ * @brief Enumerate and display Linux tasks from init_task.tasks
+ */
+static demo_error_t enumerate_linux_tasks(void)
+{
+  output_text("\n============================================================\n");
+  output_text("PROCESS ENUMERATION (task_struct list)\n");
+  output_text("============================================================\n");
+
+  demo_error_t result = linux_enumerate_tasks(g_vmi, &g_linux_offsets, &g_linux_tasks);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Failed to walk init_task.tasks\n");
+    return result;
+  }
+
+  for (size_t i = 0; i < g_linux_tasks.count; i++)
+  {
+    const LinuxTask_t *task = &g_linux_tasks.tasks[i];
+    output_process(task->pid, task->name, task->task);
+    process_set_add(task->task);
+  }
+
+  output_text("\nTotal processes found: %zu\n", g_linux_tasks.count);
+  metrics_set(METRIC_PROCESSES, g_linux_tasks.count);
+  g_sweep_changes += process_churn();
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Enumerate the memory maps of every user task found by the last walk
+ */
+static demo_error_t enumerate_linux_vmas(void)
+{
+  output_text("\n============================================================\n");
+  output_text("MEMORY MAP ENUMERATION (mm_struct VMAs)\n");
+  output_text("============================================================\n");
+
+  if (!g_linux_offsets.has_vmas)
+  {
+    output_text("Skipped: memory-map offsets not available\n");
+    return DEMO_SUCCESS;
+  }
+
+  uint32_t total_analyzed = 0;
+  size_t total_vmas = 0;
+
+  for (size_t i = 0; i < g_linux_tasks.count; i++)
+  {
+    const LinuxTask_t *task = &g_linux_tasks.tasks[i];
+
+    // Kernel threads have no mm
+    if (!task->mm)
+    {
+      continue;
+    }
+
+    if (DEMO_SUCCESS == linux_enumerate_vmas(g_vmi, &g_linux_offsets, task, &g_process_modules))
+    {
+      // Text mode shows the first few; JSON consumers get every mapping
+      size_t shown = output_jsonl() ? g_process_modules.count : 3;
+      if (!output_jsonl())
+      {
+        output_text("Process [%d] %s: %zu mappings\n", task->pid, task->name, g_process_modules.count);
+      }
+      for (size_t j = 0; j < g_process_modules.count && j < shown; j++)
+      {
+        const KernelModule_t *vma = &g_process_modules.modules[j];
+        output_module(task->pid, task->name, vma->name, vma->base, vma->size);
+      }
+      total_vmas += g_process_modules.count;
+    }
+    else
+    {
+      output_text("Process [%d] %s: memory map not readable\n", task->pid, task->name);
+    }
+    total_analyzed++;
+  }
+
+  output_text("\nProcesses analyzed: %d, total mappings found: %zu\n", total_analyzed, total_vmas);
+  metrics_set(METRIC_MODULES, total_vmas);
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Run every enumeration and check once
+ */
+static demo_error_t run_sweep(void)
+{
+  demo_error_t result = DEMO_SUCCESS;
+  const KernelModuleList_t *modules = &g_kernel_modules;
+  struct timespec phase, start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  g_sweep_changes = 0;
+
+  if (g_linux)
+  {
+    readstats_phase_start(&phase);
+    result = enumerate_linux_tasks();
+    phase_end(SWEEP_PHASE_PROCESSES, &phase);
+    if (result != DEMO_SUCCESS)
+    {
+      goto done;
+    }
+
+    readstats_phase_start(&phase);
+    result = enumerate_linux_vmas();
+    phase_end(SWEEP_PHASE_MODULES, &phase);
+    goto done;
+  }
+
+  // Every step attributes addresses through the driver index; refresh it first
+  readstats_phase_start(&phase);
+  result = kmodules_enumerate(g_vmi, &g_kernel_modules);
+  phase_end(SWEEP_PHASE_DRIVERS, &phase);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Failed to walk PsLoadedModuleList\n");
+    goto done;
+  }
+
+  // 1. Process enumeration (fully working)
+  readstats_phase_start(&phase);
+  g_list_unchanged = !g_tracking && list_unchanged();
+  result = enumerate_processes();
+  phase_end(SWEEP_PHASE_PROCESSES, &phase);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Process enumeration failed\n");
+    goto done;
+  }
+
+  // 2. Module enumeration (PEB loader lists)
+  readstats_phase_start(&phase);
+  result = enumerate_modules();
+  phase_end(SWEEP_PHASE_MODULES, &phase);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Module analysis failed\n");
+    goto done;
+  }
+
+  // 3. Thread analysis (basic version)
+  readstats_phase_start(&phase);
+  result = enumerate_threads();
+  phase_end(SWEEP_PHASE_THREADS, &phase);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Thread analysis failed\n");
+    goto done;
+  }
+
+  // 4. Kernel driver checks
+  readstats_phase_start(&phase);
+  result = check_driver_integrity(modules);
+  phase_end(SWEEP_PHASE_INTEGRITY, &phase);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Driver integrity check failed\n");
+    goto done;
+  }
+
+  readstats_phase_start(&phase);
+  result = check_service_tables(modules);
+  phase_end(SWEEP_PHASE_SERVICE_TABLES, &phase);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Service table check failed\n");
+    goto done;
+  }
+
+  readstats_phase_start(&phase);
+  result = check_cpu_state(modules);
+  phase_end(SWEEP_PHASE_CPU_STATE, &phase);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: vCPU state check failed\n");
+    goto done;
+  }
+
+  readstats_phase_start(&phase);
+  result = enumerate_callbacks(modules);
+  phase_end(SWEEP_PHASE_CALLBACKS, &phase);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("ERROR: Callback enumeration failed\n");
+    goto done;
+  }
+
+done:
+  output_flush();
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  uint64_t ns = (uint64_t)(elapsed_us(&start, &end) * 1e3);
+  metrics_add(METRIC_SWEEPS, 1);
+  metrics_add(METRIC_SWEEP_FAILURES, result != DEMO_SUCCESS);
+  metrics_add(METRIC_SWEEP_NS_TOTAL, ns);
+  metrics_set(METRIC_SWEEP_NS_LAST, ns);
+  metrics_max(METRIC_SWEEP_NS_MAX, ns);
+  return result;
+}
+
+/**
+ * @brief Stop continuous mode after the current sweep
+ */
+static void handle_stop_signal(int signo)
+{
+  (void)signo;
+  g_running = 0;
+}
+
+/**
+ * @brief Request read statistics; printed at the next safe point
+ */
+static void handle_report_signal(int signo)
+{
+  (void)signo;
+  g_report_reads = 1;
+}
+
+/**
+ * @brief Print read statistics if @p always is set or SIGUSR1 asked for them
+ */
+static void report_reads(int always)
+{
+  if (always || g_report_reads)
+  {
+    g_report_reads = 0;
+    readstats_report();
+    output_flush();
+  }
+}
+
+/**
+ * @brief Interval until the next sweep; adapts it to the last sweep in adaptive mode
+ */
+static double next_interval(const Options_t *options, double sweep_cpu)
+{
+  double interval = options->interval;
+
+  if (options->adaptive)
+  {
+    interval = scheduler_next(&g_schedule, g_sweep_changes, sweep_cpu);
+    output_text("\nNext sweep in %.2f s (%u change(s) this sweep, %.2f on average, "
+                "sweep CPU %.1f ms)\n",
+                interval, g_sweep_changes, g_schedule.change_rate, sweep_cpu * 1e3);
+  }
+  if (g_probe_period > 0 && !read_head_links(g_head_links))
+  {
+    g_head_links[0] = g_head_links[1] = 0;
+  }
+  metrics_set(METRIC_SWEEP_INTERVAL_NS, (uint64_t)(interval * 1e9));
+  return interval;
+}
+
+/**
+ * @brief Sleep between sweeps, returning early when asked to stop
+ */
+static void wait_interval(double seconds)
+{
+  // CR3-write events are only delivered while listening, so listen instead of sleeping
+  if (g_tracking)
+  {
+    struct timespec start, now;
+    double remaining_ms = seconds * 1e3;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (g_running && remaining_ms > 0)
+    {
+      if (VMI_FAILURE == vmi_events_listen(g_vmi, remaining_ms < 100 ? (uint32_t)remaining_ms + 1 : 100))
+      {
+        output_text("WARNING: Event delivery failed; falling back to list walks\n");
+        proctrack_events_stop(g_vmi);
+        g_tracking = 0;
+        break;
+      }
+      report_reads(0);
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remaining_ms = seconds * 1e3 - elapsed_us(&start, &now) / 1e3;
+    }
+    if (g_tracking || !g_running || remaining_ms <= 0)
+    {
+      return;
+    }
+    seconds = remaining_ms / 1e3;
+  }
+
+  // While probing, wake every probe period and sweep early if the list head moved
+  while (g_running && seconds > 0)
+  {
+    double step = (g_probe_period > 0 && g_probe_period < seconds) ? g_probe_period : seconds;
+    struct timespec ts;
+    ts.tv_sec = (time_t)step;
+    ts.tv_nsec = (long)((step - (double)ts.tv_sec) * 1e9);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR && g_running)
+    {
+      report_reads(0);
+    }
+    seconds -= step;
+
+    if (seconds > 0 && g_running && head_changed() > 0)
+    {
+      output_text("Process list changed; sweeping early\n");
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Print command line usage
+ */
+static void print_usage(const char *program)
+{
+  printf("Usage: %s [options] [domain]\n", program);
+  printf("  -i, --interval SEC     Repeat sweeps every SEC seconds until interrupted\n");
+  printf("      --hash-budget N    Code pages rechecked round-robin per sweep (default %d)\n",
+         INTEGRITY_DEFAULT_PAGE_BUDGET);
+  printf("      --os OS            Guest OS: windows or linux (default: the libvmi.conf ostype;\n");
+  printf("                         unless Linux, scan memory for a Windows kernel first)\n");
+  printf("      --isf PATH         Take offsets and symbols from a Volatility3 ISF (.json.xz);\n");
+  printf("                         for Linux guests, the offsets that memory maps need\n");
+  printf("      --profile-cache DIR  Cached binary profiles (default ~/.cache/vmi-demo)\n");
+  printf("      --format FMT       Record output: text (default) or jsonl on stdout\n");
+  printf("      --dump PATH        Acquire guest physical memory to PATH and exit\n");
+  printf("      --dump-format FMT  Dump layout: raw (default), lime, sparse or zstd\n");
+  printf("      --dump-base PATH   With --dump-format sparse: store only pages changed since PATH\n");
+  printf("      --dump-info PATH   Summarize and check a sparse or zstd dump, then exit\n");
+  printf("      --dump-export OUT  With --dump-info: also expand the dump into a raw image that\n");
+  printf("                         LibVMI's file mode can open (pass OUT as the domain)\n");
+  printf("      --read-stats       Print per-site read latency and phase timings after each sweep\n");
+  printf("                         (also on SIGUSR1)\n");
+  printf("      --track-processes  With --interval: follow process creation/exit through\n");
+  printf("                         CR3-write events instead of walking the list each sweep\n");
+  printf("      --replay-trace PATH  Run the process tracker over a text event trace, then exit\n");
+  printf("      --record-events PATH With --track-processes: record events and the guest pages\n");
+  printf("                         they read for --replay-events\n");
+  printf("      --replay-events PATH Replay a recorded event trace without a guest, then exit\n");
+  printf("      --adaptive MIN:MAX With --interval: sweep sooner while the guest changes and\n");
+  printf("                         back off toward MAX seconds while it is idle\n");
+  printf("      --cpu-budget PCT   With --adaptive: keep sweeps under PCT%% of one CPU\n");
+  printf("      --change-probe N   With --interval: reuse the last process walk while a few link\n");
+  printf("                         reads show no change (full walk every N sweeps)\n");
+  printf("      --environment      Also extract each process's environment block\n");
+  printf("      --metrics ADDR     With --interval: serve Prometheus metrics on [HOST:]PORT\n");
+  printf("                         (default host 127.0.0.1) or unix:PATH\n");
+  printf("  -h, --help             Show this help\n");
+}
+
+/**
+ * @brief Parse command line options; returns 0 to continue, 1 to exit cleanly, -1 on error
+ */
+static int parse_options(int argc, char **argv, Options_t *options)
+{
+  enum
+  {
+    OPT_HASH_BUDGET = 256,
+    OPT_ISF,
+    OPT_PROFILE_CACHE,
+    OPT_FORMAT,
+    OPT_DUMP,
+    OPT_DUMP_FORMAT,
+    OPT_DUMP_BASE,
+    OPT_DUMP_INFO,
+    OPT_DUMP_EXPORT,
+    OPT_READ_STATS,
+    OPT_METRICS,
+    OPT_TRACK_PROCESSES,
+    OPT_REPLAY_TRACE,
+    OPT_RECORD_EVENTS,
+    OPT_REPLAY_EVENTS,
+    OPT_ADAPTIVE,
+    OPT_CPU_BUDGET,
+    OPT_CHANGE_PROBE,
+    OPT_ENVIRONMENT,
+    OPT_OS
+  };
+  static const struct option long_options[] = {
+      {"interval", required_argument, NULL, 'i'},
+      {"hash-budget", required_argument, NULL, OPT_HASH_BUDGET},
+      {"isf", required_argument, NULL, OPT_ISF},
+      {"profile-cache", required_argument, NULL, OPT_PROFILE_CACHE},
+      {"format", required_argument, NULL, OPT_FORMAT},
+      {"dump", required_argument, NULL, OPT_DUMP},
+      {"dump-format", required_argument, NULL, OPT_DUMP_FORMAT},
+      {"dump-base", required_argument, NULL, OPT_DUMP_BASE},
+      {"dump-info", required_argument, NULL, OPT_DUMP_INFO},
+      {"dump-export", required_argument, NULL, OPT_DUMP_EXPORT},
+      {"read-stats", no_argument, NULL, OPT_READ_STATS},
+      {"metrics", required_argument, NULL, OPT_METRICS},
+      {"track-processes", no_argument, NULL, OPT_TRACK_PROCESSES},
+      {"replay-trace", required_argument, NULL, OPT_REPLAY_TRACE},
+      {"record-events", required_argument, NULL, OPT_RECORD_EVENTS},
+      {"replay-events", required_argument, NULL, OPT_REPLAY_EVENTS},
+      {"adaptive", required_argument, NULL, OPT_ADAPTIVE},
+      {"cpu-budget", required_argument, NULL, OPT_CPU_BUDGET},
+      {"change-probe", required_argument, NULL, OPT_CHANGE_PROBE},
+      {"environment", no_argument, NULL, OPT_ENVIRONMENT},
+      {"os", required_argument, NULL, OPT_OS},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+  int opt;
+
+  while ((opt = getopt_long(argc, argv, "i:h", long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+    case 'i':
+      options->interval = strtod(optarg, NULL);
+      if (options->interval <= 0)
+      {
+        printf("ERROR: Invalid interval '%s'\n", optarg);
+        return -1;
+      }
+      break;
+    case OPT_HASH_BUDGET:
+      options->hash_page_budget = strtoul(optarg, NULL, 0);
+      break;
+    case OPT_ISF:
+      options->isf_path = optarg;
+      break;
+    case OPT_PROFILE_CACHE:
+      options->profile_dir = optarg;
+      break;
+    case OPT_OS:
+      if (0 == strcmp(optarg, "windows"))
+      {
+        options->os = VMI_OS_WINDOWS;
+      }
+      else if (0 == strcmp(optarg, "linux"))
+      {
+        options->os = VMI_OS_LINUX;
+      }
+      else
+      {
+        printf("ERROR: Unknown guest OS '%s'\n", optarg);
+        return -1;
+      }
+      break;
+    case OPT_FORMAT:
+      if (0 == strcmp(optarg, "jsonl"))
+      {
+        options->jsonl = 1;
+      }
+      else if (0 != strcmp(optarg, "text"))
+      {
+        printf("ERROR: Unknown format '%s'\n", optarg);
+        return -1;
+      }
+      break;
+    case OPT_DUMP:
+      options->dump_path = optarg;
+      break;
+    case OPT_DUMP_FORMAT:
+      if (0 != dump_parse_format(optarg, &options->dump_format))
+      {
+        printf("ERROR: Unknown dump format '%s'\n", optarg);
+        return -1;
+      }
+      break;
+    case OPT_DUMP_BASE:
+      options->dump_base = optarg;
+      break;
+    case OPT_DUMP_INFO:
+      options->dump_info_path = optarg;
+      break;
+    case OPT_DUMP_EXPORT:
+      options->dump_export = optarg;
+      break;
+    case OPT_READ_STATS:
+      options->read_stats = 1;
+      break;
+    case OPT_ENVIRONMENT:
+      options->environment = 1;
+      break;
+    case OPT_METRICS:
+      options->metrics_address = optarg;
+      break;
+    case OPT_TRACK_PROCESSES:
+      options->track_processes = 1;
+      break;
+    case OPT_REPLAY_TRACE:
+      options->replay_trace = optarg;
+      break;
+    case OPT_RECORD_EVENTS:
+      options->record_events = optarg;
+      break;
+    case OPT_REPLAY_EVENTS:
+      options->replay_events = optarg;
+      break;
+    case OPT_ADAPTIVE:
+      if (2 != sscanf(optarg, "%lf:%lf", &options->interval_min, &options->interval_max) ||
+          options->interval_min <= 0 || options->interval_max < options->interval_min)
+      {
+        printf("ERROR: Invalid adaptive range '%s' (expected MIN:MAX seconds)\n", optarg);
+        return -1;
+      }
+      options->adaptive = 1;
+      break;
+    case OPT_CHANGE_PROBE:
+      options->change_probe = (unsigned)strtoul(optarg, NULL, 0);
+      if (!options->change_probe)
+      {
+        printf("ERROR: Invalid change probe period '%s'\n", optarg);
+        return -1;
+      }
+      break;
+    case OPT_CPU_BUDGET:
+      options->cpu_budget = strtod(optarg, NULL) / 100;
+      if (options->cpu_budget <= 0 || options->cpu_budget > 1)
+      {
+        printf("ERROR: Invalid CPU budget '%s' (expected 0-100)\n", optarg);
+        return -1;
+      }
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 1;
+    default:
+      print_usage(argv[0]);
+      return -1;
+    }
+  }
+
+  if (options->dump_base && options->dump_format != DUMP_FORMAT_SPARSE)
+  {
+    printf("ERROR: --dump-base needs --dump-format sparse\n");
+    return -1;
+  }
+
+  if (options->dump_export && !options->dump_info_path)
+  {
+    printf("ERROR: --dump-export needs --dump-info\n");
+    return -1;
+  }
+
+  if (options->metrics_address && options->interval <= 0)
+  {
+    printf("ERROR: --metrics needs --interval\n");
+    return -1;
+  }
+
+  if (options->track_processes && options->interval <= 0)
+  {
+    printf("ERROR: --track-processes needs --interval\n");
+    return -1;
+  }
+
+  if (options->adaptive && options->interval <= 0)
+  {
+    printf("ERROR: --adaptive needs --interval\n");
+    return -1;
+  }
+
+  if (options->change_probe && options->interval <= 0)
+  {
+    printf("ERROR: --change-probe needs --interval\n");
+    return -1;
+  }
+
+  if (options->cpu_budget > 0 && !options->adaptive)
+  {
+    printf("ERROR: --cpu-budget needs --adaptive\n");
+    return -1;
+  }
+
+  if (options->record_events && !options->track_processes)
+  {
+    printf("ERROR: --record-events needs --track-processes\n");
+    return -1;
+  }
+
+  if (optind < argc)
+  {
+    options->domain_name = argv[optind];
+  }
+  return 0;
+}
+
+/**
+ * @brief Start the output thread; in jsonl mode records keep stdout and
+ *        everything human-readable moves to stderr
+ */
+static demo_error_t start_output(int jsonl)
+{
+  int fd = -1;
+
+  if (jsonl)
+  {
+    fd = dup(STDOUT_FILENO);
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+    {
+      fprintf(stderr, "ERROR: Failed to set up JSON Lines output\n");
+      return DEMO_ERROR_INIT;
+    }
+  }
+
+  if (DEMO_SUCCESS != output_start(fd))
+  {
+    fprintf(stderr, "ERROR: Failed to start output thread\n");
+    return DEMO_ERROR_INIT;
+  }
+  return DEMO_SUCCESS;
+}
+
+/**
+ * @brief Print banner and system information
+ */
+static void print_banner(const char *domain_name)
+{
+  time_t current_time = time(NULL);
+  output_text("================================================================================\n");
+  output_text("         VMI DEMONSTRATION\n");
+  output_text("    Virtual Machine Introspection Demo - Compatible Version\n");
+  output_text("================================================================================\n");
+  output_text("Target VM: %s\n", domain_name);
+  output_text("Timestamp: %s", ctime(&current_time));
+  output_text("VMI Capabilities: Process enumeration, Memory analysis, Structure inspection\n");
+  output_text("================================================================================\n");
+}
+
+/**
+ * @brief Main program entry point
+ */
+int main(int argc, char **argv)
+{
+  Options_t options = {.domain_name = "win7-vmi"};
+  demo_error_t result = DEMO_SUCCESS;
+
+  int parsed = parse_options(argc, argv, &options);
+  if (parsed != 0)
+  {
+    return (parsed > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // Offline: no guest needed
+  if (options.dump_info_path)
+  {
+    if (DEMO_SUCCESS != dumpfile_info(options.dump_info_path))
+    {
+      return EXIT_FAILURE;
+    }
+    if (options.dump_export && DEMO_SUCCESS != dumpfile_export(options.dump_info_path, options.dump_export))
+    {
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+  if (options.replay_trace)
+  {
+    return (DEMO_SUCCESS == proctrack_replay(options.replay_trace)) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (options.replay_events)
+  {
+    return (DEMO_SUCCESS == evtrace_replay(options.replay_events)) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (DEMO_SUCCESS != start_output(options.jsonl))
+  {
+    return EXIT_FAILURE;
+  }
+
+  const char *domain_name = options.domain_name;
+  print_banner(domain_name);
+  integrity_init(&g_integrity, options.hash_page_budget);
+  g_read_environment = options.environment;
+
+  if (options.dump_path)
+  {
+    result = acquire_memory(&options);
+    goto cleanup;
+  }
+
+  // Initialize VMI
+  result = initialize_vmi(&options);
+  if (result != DEMO_SUCCESS)
+  {
+    output_text("Failed to initialize VMI. Ensure:\n");
+    output_text("1. VM '%s' is running\n", domain_name);
+    output_text("2. LibVMI configuration is correct\n");
+    output_text("3. You have sufficient privileges\n");
+    goto cleanup;
+  }
+
+  g_linux = (VMI_OS_LINUX == vmi_get_ostype(g_vmi));
+  if (g_linux)
+  {
+    result = setup_linux(&options);
+  }
+  else
+  {
+    result = load_symbols(&options);
+    if (result == DEMO_SUCCESS)
+    {
+      result = resolve_offsets();
+    }
+  }
+  if (result != DEMO_SUCCESS)
+  {
+    goto cleanup;
+  }
+
+  if (options.track_processes)
+  {
+    result = start_tracking(options.record_events);
+    if (result != DEMO_SUCCESS)
+    {
+      goto cleanup;
+    }
+  }
+
+  if (options.change_probe && g_linux)
+  {
+    output_text("WARNING: --change-probe supports Windows guests only; walking every sweep\n");
+  }
+  else if (options.change_probe)
+  {
+    if (VMI_SUCCESS == symbols_ksym2v(g_vmi, "PsActiveProcessHead", &g_list_head))
+    {
+      g_probe.full_every = options.change_probe;
+      output_text("✓ Change probe: the last process walk is reused while unchanged, full walk every %u sweeps\n",
+                  options.change_probe);
+    }
+    else
+    {
+      output_text("WARNING: PsActiveProcessHead not resolved; change probe disabled\n");
+    }
+  }
+
+  if (options.adaptive)
+  {
+    double start = options.interval;
+    start = (start < options.interval_min) ? options.interval_min : start;
+    start = (start > options.interval_max) ? options.interval_max : start;
+    scheduler_init(&g_schedule, start, options.interval_min, options.interval_max, options.cpu_budget);
+
+    // Event tracking already reports changes; otherwise probe the list head between sweeps
+    addr_t init_task = 0;
+    if (g_linux && VMI_SUCCESS == vmi_translate_ksym2v(g_vmi, "init_task", &init_task) && init_task)
+    {
+      g_list_head = init_task + g_linux_offsets.tasks;
+    }
+    else if (!g_linux && !options.track_processes)
+    {
+      symbols_ksym2v(g_vmi, "PsActiveProcessHead", &g_list_head);
+    }
+    if (g_list_head)
+    {
+      g_probe_period = options.interval_min;
+    }
+    output_text("✓ Adaptive interval %.2f-%.2f s%s\n", options.interval_min, options.interval_max,
+                g_list_head ? ", probing the process list head between sweeps" : "");
+  }
+
+  output_text("\nStarting VMI introspection...\n");
+
+  if (options.interval > 0)
+  {
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+
+    if (options.metrics_address)
+    {
+      if (DEMO_SUCCESS != metrics_start(options.metrics_address))
+      {
+        output_text("ERROR: Cannot serve metrics on '%s'\n", options.metrics_address);
+        result = DEMO_ERROR_INIT;
+        goto cleanup;
+      }
+      output_text("✓ Serving metrics on %s\n", options.metrics_address);
+    }
+  }
+  signal(SIGUSR1, handle_report_signal);
+
+  do
+  {
+    struct timespec cpu_start, cpu_end;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    result = run_sweep();
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+
+    report_reads(options.read_stats);
+    if (result != DEMO_SUCCESS || options.interval <= 0)
+    {
+      break;
+    }
+    wait_interval(next_interval(&options, elapsed_us(&cpu_start, &cpu_end) / 1e6));
+  } while (g_running);
+
+cleanup:
+  metrics_stop();
+  if (g_vmi)
+  {
+    proctrack_events_stop(g_vmi);
+  }
+  proctrack_free(&g_tracker);
+  evtrace_record_stop();
+  free(g_process_set[0].eprocess);
+  free(g_process_set[1].eprocess);
+  free(g_probe.nodes);
+  free(g_probe.processes);
+  integrity_free(&g_integrity);
+  kmodules_free(&g_kernel_modules);
+  kmodules_free(&g_process_modules);
+  procparams_free(&g_params);
+  linux_free_tasks(&g_linux_tasks);
+  cleanup_vmi();
+  if (output_stalls())
+  {
+    output_text("WARNING: Output fell behind %zu times; the sweep waited for the writer\n",
+                output_stalls());
+  }
+  output_stop();
   return (result == DEMO_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
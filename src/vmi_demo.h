@@ -0,0 +1,33 @@
+/**
+ * @file vmi_demo.h
+ * @brief Shared definitions for the VMI demonstration
+ * @author Mohamed Reda Ibrahiem
+ * @date May 2025
+ */
+
+#ifndef VMI_DEMO_H
+#define VMI_DEMO_H
+
+#include <stdint.h>
+#include <libvmi/libvmi.h>
+
+// Constants
+#define MAX_PROC_NAME 64
+#define MAX_MODULE_NAME 64
+#define GUEST_PAGE_SIZE 4096
+#define GUEST_PAGE_MASK (~(addr_t)(GUEST_PAGE_SIZE - 1))
+
+// Lowest canonical address of the x64 Windows kernel image/driver space
+#define KERNEL_SPACE_START 0xfffff80000000000ULL
+
+// Error codes
+typedef enum
+{
+  DEMO_SUCCESS = 0,
+  DEMO_ERROR_INIT = -1,
+  DEMO_ERROR_MEMORY = -2,
+  DEMO_ERROR_MODULE = -3,
+  DEMO_ERROR_PROCESS = -4
+} demo_error_t;
+
+#endif // VMI_DEMO_H
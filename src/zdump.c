@@ -0,0 +1,365 @@
+/**
+ * @file zdump.c
+ * @brief Compressed memory acquisition with a parallel zstd compressor
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <zstd.h>
+
+#include "zdump.h"
+#include "dumpfile.h"
+
+typedef enum
+{
+  SLOT_FREE,
+  SLOT_FILLED, // waiting for a compressor
+  SLOT_BUSY,
+} slot_state_t;
+
+typedef struct ZSlot_t
+{
+  uint8_t *in;
+  size_t len;
+  uint64_t chunk;
+  slot_state_t state;
+} ZSlot_t;
+
+typedef struct ZWorker_t
+{
+  struct ZDump_t *dump;
+  ZSTD_CCtx *cctx;
+  uint8_t *out;
+  size_t out_capacity;
+  pthread_t thread;
+  int running;
+} ZWorker_t;
+
+typedef struct ZDump_t
+{
+  int fd;
+  pthread_mutex_t lock;
+  pthread_cond_t filled; // a slot became SLOT_FILLED, or stop was set
+  pthread_cond_t freed;  // a slot became SLOT_FREE
+  ZSlot_t slots[2 * ZDUMP_MAX_THREADS];
+  unsigned slot_count;
+  ZWorker_t workers[ZDUMP_MAX_THREADS];
+  unsigned worker_count; // threads actually started
+  DumpFileZChunk_t *index;
+  uint64_t append_offset;
+  int stop;
+  int failed;
+  DumpStats_t *stats;
+} ZDump_t;
+
+static int worker_init(ZWorker_t *worker, ZDump_t *dump)
+{
+  worker->dump = dump;
+  worker->out_capacity = ZSTD_compressBound(DUMPFILE_ZCHUNK_SIZE);
+  worker->out = malloc(worker->out_capacity);
+  worker->cctx = ZSTD_createCCtx();
+  return (worker->out && worker->cctx) ? 0 : -1;
+}
+
+static void worker_free(ZWorker_t *worker)
+{
+  ZSTD_freeCCtx(worker->cctx);
+  free(worker->out);
+}
+
+/**
+ * @brief Compress one claimed slot, append the frame and release the slot
+ */
+static void compress_slot(ZWorker_t *worker, ZSlot_t *slot)
+{
+  ZDump_t *dump = worker->dump;
+  size_t size = ZSTD_compressCCtx(worker->cctx, worker->out, worker->out_capacity, slot->in,
+                                  slot->len, ZDUMP_LEVEL);
+  int failed = ZSTD_isError(size);
+  uint64_t offset = 0;
+
+  pthread_mutex_lock(&dump->lock);
+  if (!failed)
+  {
+    offset = dump->append_offset;
+    dump->append_offset += size;
+    dump->index[slot->chunk].offset = offset;
+    dump->index[slot->chunk].length = (uint32_t)size;
+  }
+  pthread_mutex_unlock(&dump->lock);
+
+  // Frames go to disjoint ranges, so writes need no lock
+  if (!failed)
+  {
+    failed = dumpfile_pwrite(dump->fd, worker->out, size, offset);
+  }
+
+  pthread_mutex_lock(&dump->lock);
+  if (failed)
+  {
+    dump->failed = 1;
+  }
+  else
+  {
+    dump->stats->bytes_written += size;
+  }
+  slot->state = SLOT_FREE;
+  pthread_cond_signal(&dump->freed);
+  pthread_mutex_unlock(&dump->lock);
+}
+
+static void *compress_worker(void *arg)
+{
+  ZWorker_t *worker = arg;
+  ZDump_t *dump = worker->dump;
+
+  pthread_mutex_lock(&dump->lock);
+  for (;;)
+  {
+    ZSlot_t *slot = NULL;
+    for (unsigned i = 0; i < dump->slot_count && !slot; i++)
+    {
+      if (dump->slots[i].state == SLOT_FILLED)
+      {
+        slot = &dump->slots[i];
+      }
+    }
+    if (!slot)
+    {
+      if (dump->stop)
+      {
+        break;
+      }
+      pthread_cond_wait(&dump->filled, &dump->lock);
+      continue;
+    }
+
+    slot->state = SLOT_BUSY;
+    pthread_mutex_unlock(&dump->lock);
+    compress_slot(worker, slot);
+    pthread_mutex_lock(&dump->lock);
+  }
+  pthread_mutex_unlock(&dump->lock);
+  return NULL;
+}
+
+static ZSlot_t *acquire_slot(ZDump_t *dump)
+{
+  ZSlot_t *slot = NULL;
+
+  pthread_mutex_lock(&dump->lock);
+  while (!slot && !dump->failed)
+  {
+    for (unsigned i = 0; i < dump->slot_count && !slot; i++)
+    {
+      if (dump->slots[i].state == SLOT_FREE)
+      {
+        slot = &dump->slots[i];
+      }
+    }
+    if (!slot)
+    {
+      pthread_cond_wait(&dump->freed, &dump->lock);
+    }
+  }
+  pthread_mutex_unlock(&dump->lock);
+  return slot;
+}
+
+/**
+ * @brief Read one chunk; unreadable pages become zeros
+ * @return Number of unreadable pages
+ */
+static uint64_t read_chunk(vmi_instance_t vmi, addr_t pa, uint8_t *buf, size_t len)
+{
+  uint8_t scratch[GUEST_PAGE_SIZE];
+  uint64_t absent = 0;
+  size_t done = 0;
+
+  while (done < len)
+  {
+    size_t got = 0;
+    vmi_read_pa(vmi, pa + done, len - done, buf + done, &got);
+    got &= (size_t)GUEST_PAGE_MASK;
+    done += got;
+    if (done < len)
+    {
+      // The same hole search as the other formats, then one memset for all of it
+      size_t hole = (size_t)(dump_next_readable(vmi, pa + done, pa + len, scratch) - (pa + done));
+      memset(buf + done, 0, hole);
+      done += hole;
+      absent += (hole + GUEST_PAGE_SIZE - 1) / GUEST_PAGE_SIZE;
+    }
+  }
+  return absent;
+}
+
+static void zdump_free(ZDump_t *dump)
+{
+  for (unsigned i = 0; i < ZDUMP_MAX_THREADS; i++)
+  {
+    worker_free(&dump->workers[i]);
+  }
+  for (unsigned i = 0; i < dump->slot_count; i++)
+  {
+    free(dump->slots[i].in);
+  }
+  free(dump->index);
+  if (dump->fd >= 0)
+  {
+    close(dump->fd);
+  }
+  pthread_cond_destroy(&dump->freed);
+  pthread_cond_destroy(&dump->filled);
+  pthread_mutex_destroy(&dump->lock);
+}
+
+/**
+ * @brief Write the chunk index and then the header page
+ */
+static int write_trailer(ZDump_t *dump, uint64_t chunk_count, addr_t max_pa)
+{
+  uint8_t page[GUEST_PAGE_SIZE];
+  DumpFileZHeader_t *header = (DumpFileZHeader_t *)page;
+  size_t index_bytes = chunk_count * sizeof(DumpFileZChunk_t);
+
+  memset(page, 0, sizeof(page));
+  memcpy(header->magic, DUMPFILE_ZMAGIC, sizeof(header->magic));
+  header->version = DUMPFILE_ZVERSION;
+  header->chunk_size = DUMPFILE_ZCHUNK_SIZE;
+  header->chunk_count = chunk_count;
+  header->max_pa = max_pa;
+  header->index_offset = dump->append_offset;
+  header->absent_pages = dump->stats->pages_unreadable;
+
+  if (dumpfile_pwrite(dump->fd, dump->index, index_bytes, header->index_offset) != 0)
+  {
+    return -1;
+  }
+  dump->stats->bytes_written += index_bytes;
+
+  // Header last, so a failed dump never carries a valid magic
+  if (dumpfile_pwrite(dump->fd, page, sizeof(page), 0) != 0)
+  {
+    return -1;
+  }
+  dump->stats->bytes_written += sizeof(page);
+  return 0;
+}
+
+demo_error_t zdump_memory(vmi_instance_t vmi, const char *path, DumpStats_t *stats)
+{
+  ZDump_t dump;
+  struct timespec start, end;
+
+  memset(stats, 0, sizeof(*stats));
+  memset(&dump, 0, sizeof(dump));
+  dump.fd = -1;
+  dump.stats = stats;
+  dump.append_offset = GUEST_PAGE_SIZE;
+  pthread_mutex_init(&dump.lock, NULL);
+  pthread_cond_init(&dump.filled, NULL);
+  pthread_cond_init(&dump.freed, NULL);
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned threads = (online > 1) ? (unsigned)online - 1 : 1; // one core keeps reading
+  if (threads > ZDUMP_MAX_THREADS)
+  {
+    threads = ZDUMP_MAX_THREADS;
+  }
+
+  addr_t max_pa = vmi_get_max_physical_address(vmi);
+  uint64_t chunk_count = (max_pa + DUMPFILE_ZCHUNK_SIZE - 1) / DUMPFILE_ZCHUNK_SIZE;
+
+  dump.index = calloc(chunk_count ? chunk_count : 1, sizeof(*dump.index));
+  dump.slot_count = 2 * threads;
+  int ok = (dump.index != NULL);
+  for (unsigned i = 0; ok && i < dump.slot_count; i++)
+  {
+    ok = (NULL != (dump.slots[i].in = malloc(DUMPFILE_ZCHUNK_SIZE)));
+  }
+  for (unsigned i = 0; ok && i < threads; i++)
+  {
+    ok = (0 == worker_init(&dump.workers[i], &dump));
+  }
+  if (!ok)
+  {
+    zdump_free(&dump);
+    return DEMO_ERROR_MEMORY;
+  }
+
+  dump.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (dump.fd < 0)
+  {
+    zdump_free(&dump);
+    return DEMO_ERROR_INIT;
+  }
+
+  for (unsigned i = 0; i < threads; i++)
+  {
+    dump.workers[i].running = (0 == pthread_create(&dump.workers[i].thread, NULL,
+                                                   compress_worker, &dump.workers[i]));
+    dump.worker_count += dump.workers[i].running;
+  }
+  stats->compress_threads = dump.worker_count;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (uint64_t chunk = 0; chunk < chunk_count; chunk++)
+  {
+    ZSlot_t *slot = acquire_slot(&dump);
+    if (!slot)
+    {
+      break;
+    }
+
+    addr_t pa = chunk * DUMPFILE_ZCHUNK_SIZE;
+    slot->chunk = chunk;
+    slot->len = (max_pa - pa < DUMPFILE_ZCHUNK_SIZE) ? (size_t)(max_pa - pa) : DUMPFILE_ZCHUNK_SIZE;
+    uint64_t absent = read_chunk(vmi, pa, slot->in, slot->len);
+    stats->pages_unreadable += absent;
+    stats->bytes_read += slot->len - absent * GUEST_PAGE_SIZE;
+
+    if (!dump.worker_count)
+    {
+      // No thread could be started: compress on this one
+      slot->state = SLOT_BUSY;
+      compress_slot(&dump.workers[0], slot);
+      continue;
+    }
+
+    pthread_mutex_lock(&dump.lock);
+    slot->state = SLOT_FILLED;
+    pthread_cond_signal(&dump.filled);
+    pthread_mutex_unlock(&dump.lock);
+  }
+
+  // Workers drain every filled slot before they see stop
+  pthread_mutex_lock(&dump.lock);
+  dump.stop = 1;
+  pthread_cond_broadcast(&dump.filled);
+  pthread_mutex_unlock(&dump.lock);
+  for (unsigned i = 0; i < threads; i++)
+  {
+    if (dump.workers[i].running)
+    {
+      pthread_join(dump.workers[i].thread, NULL);
+    }
+  }
+
+  int failed = dump.failed;
+  if (!failed && (write_trailer(&dump, chunk_count, max_pa) != 0 || fdatasync(dump.fd) != 0))
+  {
+    failed = 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  stats->seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+  zdump_free(&dump);
+  return failed ? DEMO_ERROR_MEMORY : DEMO_SUCCESS;
+}
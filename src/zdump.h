@@ -0,0 +1,25 @@
+/**
+ * @file zdump.h
+ * @brief Compressed memory acquisition with a parallel zstd compressor
+ *
+ * The calling thread reads guest memory chunk by chunk (LibVMI handles
+ * are not shared across threads) and hands each chunk to a pool of
+ * compressor threads. Each worker compresses a chunk, reserves the next
+ * file offset and writes the frame itself, so compression and disk
+ * writes both run in parallel. See dumpfile.h for the layout.
+ */
+
+#ifndef ZDUMP_H
+#define ZDUMP_H
+
+#include "dump.h"
+
+#define ZDUMP_MAX_THREADS 16
+#define ZDUMP_LEVEL 3 // zstd default level
+
+/**
+ * @brief Acquire all guest physical memory into a compressed dump at @p path
+ */
+demo_error_t zdump_memory(vmi_instance_t vmi, const char *path, DumpStats_t *stats);
+
+#endif // ZDUMP_H